@@ -1,9 +1,12 @@
 // SPDX-License-Identifier: Apache-2.0
 // Copyright (C) 2021 YADRO
 
+#include <config.h>
+
 #include <core/application.hpp>
 #include <core/connection.hpp>
 #include <core/route/handlers/graphql_handler.hpp>
+#include <core/route/handlers/graphql_persisted.hpp>
 
 #include <core/entity/entity.hpp>
 #include <core/entity/dbus_query.hpp>
@@ -18,6 +21,9 @@
 #include <version_provider.hpp>
 
 #include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
 
 namespace app
 {
@@ -27,7 +33,8 @@ namespace core
 void Application::configure()
 {
     LOG_DEBUG << "configure";
-    /* TODO set Threads/Features/APIs */
+    /* TODO set Features/APIs */
+    this->initServer();
     registerAllRoutes();
 
     // TODO include IProtocol abstraction which incapsulate own specific handlers.
@@ -37,6 +44,13 @@ void Application::configure()
     this->initEntityMap();
     this->initBrokers();
 
+#ifdef BMC_PERSISTED_QUERIES_PATH
+    // The plans are compiled against the entities schema, hence the queries
+    // are loaded once the entities are initialized.
+    route::handlers::GqlPersistedQueries::getInstance().load(
+        BMC_PERSISTED_QUERIES_PATH);
+#endif
+
     // register handlers
     std::signal(SIGINT, &Application::handleSignals);
 }
@@ -46,19 +60,102 @@ void Application::start()
     /* First we make a Fastcgipp::Manager object, with our request handling
      * class as a template parameter.
      */
-    Fastcgipp::Manager<Connection> app;
+    Fastcgipp::Manager<Connection> app(workerThreads);
     /* Now just call the object handler function. It will sleep quietly when
      * there are no requests and efficiently manage them when there are many.
      */
     app.setupSignals();
-    app.listen();
+    for (const auto& socket : listenSockets)
+    {
+        if (!listenSocket(app, socket))
+        {
+            throw exceptions::ObmcAppException("Can't listen the socket '" +
+                                               socket + "'");
+        }
+        LOG_INFO << "Listen the FastCGI socket: " << socket;
+    }
     app.start();
     app.join();
 }
 
+void Application::initServer()
+{
+    const char* threadsValue = std::getenv(envWorkerThreads);
+    long threads = BMC_FASTCGI_THREADS;
+    if (threadsValue != nullptr)
+    {
+        char* valueEnd = nullptr;
+        threads = std::strtol(threadsValue, &valueEnd, 10);
+        if (valueEnd == threadsValue || *valueEnd != '\0' || threads < 0)
+        {
+            throw exceptions::ObmcAppException(
+                std::string("Invalid count of the worker threads: ") +
+                threadsValue);
+        }
+    }
+    // The zero count is the count of the cores: the requests are served from
+    // the memory, hence more threads than cores don't serve more requests.
+    workerThreads = threads != 0 ? static_cast<unsigned>(threads)
+                                 : std::max(std::thread::hardware_concurrency(),
+                                            1U);
+
+    const char* socketsValue = std::getenv(envListenSockets);
+    std::string_view sockets =
+        socketsValue != nullptr ? socketsValue : BMC_FASTCGI_LISTEN;
+    listenSockets.clear();
+    while (!sockets.empty())
+    {
+        const auto socketEnd = sockets.find(',');
+        auto socket = sockets.substr(0, socketEnd);
+        sockets.remove_prefix(socketEnd == std::string_view::npos
+                                  ? sockets.size()
+                                  : socketEnd + 1);
+        if (!socket.empty())
+        {
+            listenSockets.emplace_back(socket);
+        }
+    }
+    if (listenSockets.empty())
+    {
+        listenSockets.emplace_back(inheritedSocket);
+    }
+
+    LOG_INFO << "FastCGI worker threads: " << workerThreads
+             << ", listen sockets: " << listenSockets.size();
+}
+
+bool Application::listenSocket(Fastcgipp::Manager<Connection>& manager,
+                               const std::string& socket)
+{
+    if (socket == inheritedSocket)
+    {
+        return manager.listen();
+    }
+    // The absolute path is the unix socket, otherwise it's 'host:port'
+    if (socket.front() == '/')
+    {
+        return manager.listen(socket.c_str());
+    }
+    const auto portBegin = socket.rfind(':');
+    if (portBegin == std::string::npos)
+    {
+        LOG_ERROR << "The FastCGI socket is neither the path nor the "
+                     "'host:port': "
+                  << socket;
+        return false;
+    }
+    const auto host = socket.substr(0, portBegin);
+    const auto port = socket.substr(portBegin + 1);
+    return manager.listen(host.empty() ? nullptr : host.c_str(), port.c_str());
+}
+
 void Application::terminate()
 {
     dbusBrokerManager.terminate();
+    if (entitySnapshot)
+    {
+        entitySnapshot->terminate();
+    }
 }
 
 void Application::initEntityMap()
@@ -99,7 +196,7 @@ void Application::initEntityMap()
 
     /* Define GLOBAL ASSOCIATIONS supplement provider */
     entityManager
-        .buildEntity(
+        .buildSupplementProvider(
             relations::providerRelations)
         ->addMembers({
             relations::fieldEndpoint,
@@ -121,14 +218,37 @@ void Application::initEntityMap()
             definitions::sensors::fieldHighWarning,
             definitions::sensors::fieldHightCritical,
             status::fieldStatus,
+            definitions::metaChassisPath,
         })
         .linkSupplementProvider(
             status::providerStatus,
-            std::bind(&Sensors::linkStatus, _1, _2))
+            std::bind(&Sensors::linkStatus, _1, _2),
+            {status::fieldStatus})
+        .linkSupplementProvider(
+            relations::providerRelations,
+            std::bind(&general_relations::linkChassis, _1, _2),
+            {definitions::metaChassisPath})
         .addQuery<dbus::DBusQueryBuilder>(dbusBrokerManager)
         ->addObject<Sensors>(observeDBusSignals, 5min)
         .complete();
 
+    /* Define CHASSIS entity */
+    entityManager.buildEntity(definitions::entityChassis)
+        ->addMembers({
+            definitions::fieldType,
+            definitions::fieldPartNumber,
+            definitions::fieldManufacturer,
+            status::fieldStatus,
+            definitions::metaChassisPath,
+        })
+        .linkSupplementProvider(
+            relations::providerRelations,
+            std::bind(&general_relations::linkChassis, _1, _2),
+            {definitions::metaChassisPath})
+        .addQuery<dbus::DBusQueryBuilder>(dbusBrokerManager)
+        ->addObject<Chassis>()
+        .complete();
+
     /* Define SERVER entity */
     entityManager.buildEntity(definitions::entityServer)
         ->addMembers({
@@ -144,23 +264,25 @@ void Application::initEntityMap()
         })
         .linkSupplementProvider(
             definitions::supplement_providers::version::providerVersion,
-            std::bind(&Server::linkVersions, _1, _2))
+            std::bind(&Server::linkVersions, _1, _2),
+            {
+                definitions::version::fieldVersionBios,
+                definitions::version::fieldVersionBmc,
+            })
+        // The sensors and the chassis are related to the server by the
+        // 'chassis' associations of them.
+        .addRelations(definitions::entitySensors,
+                      general_relations::relationFieldsEqual(
+                          definitions::metaObjectPath,
+                          definitions::metaChassisPath))
+        .addRelations(definitions::entityChassis,
+                      general_relations::relationFieldsEqual(
+                          definitions::metaObjectPath,
+                          definitions::metaChassisPath))
         .addQuery<dbus::DBusQueryBuilder>(dbusBrokerManager)
         ->addObject<Server>()
         .complete();
 
-    /* Define CHASSIS entity */
-    entityManager.buildEntity(definitions::entityChassis)
-        ->addMembers({
-            definitions::fieldType,
-            definitions::fieldPartNumber,
-            definitions::fieldManufacturer,
-            status::fieldStatus,
-        })
-        .addQuery<dbus::DBusQueryBuilder>(dbusBrokerManager)
-        ->addObject<Chassis>()
-        .complete();
-
     /* Define BASEBOARD entity */
     entityManager.buildEntity(definitions::entityBaseboard)
         ->addMembers({
@@ -186,8 +308,25 @@ void Application::initEntityMap()
 
 void Application::initBrokers()
 {
+#ifdef BMC_ENTITIES_SNAPSHOT_PATH
+    using namespace std::literals;
+
+    entitySnapshot = std::make_unique<entity::EntitySnapshot>(
+        entityManager, BMC_ENTITIES_SNAPSHOT_PATH,
+        std::chrono::seconds(BMC_ENTITIES_SNAPSHOT_INTERVAL_SEC));
+    // Restore the entities before the brokers are started to not override
+    // the actual data by the stale one.
+    entitySnapshot->load();
+#endif
+
     dbusBrokerManager.start();
     LOG_DEBUG << "Start DBus broker";
+
+    if (entitySnapshot)
+    {
+        entitySnapshot->start(
+            [this]() { return dbusBrokerManager.isReady(); });
+    }
 }
 
 void Application::handleSignals(int signal)
@@ -8,20 +8,32 @@
 #include <logger/logger.hpp>
 #include <core/broker/dbus_broker.hpp>
 #include <core/entity/entity.hpp>
+#include <core/entity/snapshot.hpp>
 
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace app
 {
 namespace core
 {
 
+class Connection;
+
 /**
  * @brief
  *
  */
 class Application final
 {
+    // The runtime options passed by the web server, e.g. by the lighttpd
+    // 'bin-environment', override the build options.
+    static constexpr const char* envWorkerThreads = "OBMC_WEBAPP_FCGI_THREADS";
+    static constexpr const char* envListenSockets = "OBMC_WEBAPP_FCGI_LISTEN";
+    // The socket passed by the web server which has spawned the application
+    static constexpr const char* inheritedSocket = "-";
+
   public:
     Application() : dbusBrokerManager(app::broker::DBusBrokerManager(5))
     {
@@ -59,15 +71,61 @@ class Application final
     {
         return this->entityManager;
     }
+
+    /**
+     * @brief Get the DBus Broker Manager object
+     *
+     * @return const app::broker::DBusBrokerManager&
+     */
+    const app::broker::DBusBrokerManager& getBrokerManager()
+    {
+        return this->dbusBrokerManager;
+    }
+
+    /**
+     * @brief Get the count of the FastCGI worker threads. Each thread serves
+     *        a single request at once.
+     */
+    unsigned getWorkerThreads() const
+    {
+        return workerThreads;
+    }
+
+    /**
+     * @brief Whether the entities have been restored from the snapshot and
+     *        can be served until the brokers repopulate them.
+     */
+    bool isWarmStarted() const
+    {
+        return entitySnapshot && entitySnapshot->isLoaded();
+    }
+
+    /**
+     * @brief Get the entities snapshot, nullptr if the snapshot is disabled
+     */
+    const entity::EntitySnapshot* getEntitySnapshot() const
+    {
+        return entitySnapshot.get();
+    }
   protected:
+    void initServer();
     void initEntityMap();
     void initBrokers();
     void registerAllRoutes();
 
     static void handleSignals(int signal);
+    /**
+     * @brief Listen the FastCGI socket: the socket inherited from the web
+     *        server, the unix socket path or the TCP 'host:port'.
+     */
+    static bool listenSocket(Fastcgipp::Manager<Connection>& manager,
+                             const std::string& socket);
   private:
     app::broker::DBusBrokerManager dbusBrokerManager;
     entity::EntityManager entityManager;
+    entity::EntitySnapshotUni entitySnapshot;
+    unsigned workerThreads = 1;
+    std::vector<std::string> listenSockets;
 };
 
 
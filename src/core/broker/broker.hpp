@@ -81,15 +81,18 @@ class Broker : public IBrokerManager::IBroker
 
     bool isTimeout() override
     {
-        bool isNeverRun = lastExecutionTime == system_clock::duration::zero();
         bool isSingleShot = getTimeout() == system_clock::duration::zero();
         bool isActualTimeout = system_clock::now().time_since_epoch() / 1s >
                                (lastExecutionTime + getTimeout()).count();
 
-        return isNeverRun || (!isSingleShot && isActualTimeout);
+        return isNeverRun() || (!isSingleShot && isActualTimeout);
     }
 
     protected:
+      bool isNeverRun() const
+      {
+          return lastExecutionTime == system_clock::duration::zero();
+      }
       void setExecutionTime()
       {
           lastExecutionTime =
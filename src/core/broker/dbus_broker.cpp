@@ -5,9 +5,11 @@
 
 #include <core/broker/dbus_broker.hpp>
 #include <core/entity/dbus_query.hpp>
+#include <core/broker/signal_throttle.hpp>
 #include <core/exceptions.hpp>
 #include <sdbusplus/bus/match.hpp>
 
+#include <algorithm>
 #include <thread>
 #include <vector>
 
@@ -27,6 +29,12 @@ bool DBusBroker::tryProcess(sdbusplus::bus::bus&, sdbusplus::bus::bus&)
     return true;
 }
 
+void DBusBroker::refreshThrottled(sdbusplus::bus::bus&)
+{}
+
+void DBusBroker::refreshDemand(sdbusplus::bus::bus&, sdbusplus::bus::bus&)
+{}
+
 bool EntityDbusBroker::tryProcess(sdbusplus::bus::bus& queryConnect,
                                   sdbusplus::bus::bus& watcherConnect)
 {
@@ -51,11 +59,24 @@ bool EntityDbusBroker::tryProcess(sdbusplus::bus::bus& queryConnect,
     }
     LOG_DEBUG << "Accept broker task of Entity '" << entity->getName() << "'";
 
-    auto instances = this->entityQuery->process(queryConnect);
+    const bool isColdStart = this->isNeverRun();
+    const auto startTime = steady_clock::now();
+    std::vector<IEntity::InstancePtr> instances;
+    try
+    {
+        instances = this->entityQuery->process(queryConnect);
+    }
+    catch (...)
+    {
+        refreshErrors.fetch_add(1, std::memory_order_relaxed);
+        throw;
+    }
+    const auto queryTime = steady_clock::now();
 
     // Register watchers if the broker is configured to watch of DBus signals.
     if (this->isWatch())
     {
+        watchedInstances.clear();
         for (auto& instance : instances)
         {
             auto dbusInstance =
@@ -67,11 +88,38 @@ bool EntityDbusBroker::tryProcess(sdbusplus::bus::bus& queryConnect,
                                        "not DBusInstance.");
             }
             dbusInstance->bindListeners(watcherConnect, this->entity);
+            watchedInstances.push_back(std::move(dbusInstance));
         }
     }
+    const auto listenersTime = steady_clock::now();
     this->entity->setInstances(instances);
     this->setExecutionTime();
 
+    const auto refreshTime = steady_clock::now();
+    const auto refreshMicroseconds = static_cast<uint64_t>(
+        duration_cast<microseconds>(refreshTime - startTime).count());
+    lastRefreshMicroseconds.store(refreshMicroseconds,
+                                  std::memory_order_relaxed);
+    totalRefreshMicroseconds.fetch_add(refreshMicroseconds,
+                                       std::memory_order_relaxed);
+    instancesCount.store(instances.size(), std::memory_order_relaxed);
+    lastRefreshTime.store(refreshTime.time_since_epoch().count(),
+                          std::memory_order_relaxed);
+    refreshes.fetch_add(1, std::memory_order_relaxed);
+
+    if (isColdStart)
+    {
+        const auto finishTime = steady_clock::now();
+        LOG_INFO << "Entity '" << entity->getName() << "' populated: "
+                 << instances.size() << " instances, query "
+                 << duration_cast<milliseconds>(queryTime - startTime).count()
+                 << "ms, listeners "
+                 << duration_cast<milliseconds>(listenersTime - queryTime)
+                        .count()
+                 << "ms, total "
+                 << duration_cast<milliseconds>(finishTime - startTime).count()
+                 << "ms";
+    }
     LOG_DEBUG << "Process query is sucess. Entity '" << entity->getName()
               << "'";
     return true;
@@ -92,6 +140,74 @@ void EntityDbusBroker::registerObjectsListener(sdbusplus::bus::bus& connect)
     dbusQuery->registerObjectRemovingObserver(connect);
 }
 
+void EntityDbusBroker::refreshThrottled(sdbusplus::bus::bus& queryConnect)
+{
+    std::unique_lock<std::mutex> lock(guardMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        return;
+    }
+
+    const auto now = steady_clock::now();
+    if (now - lastThrottledRefresh < SignalThrottle::throttledPollInterval)
+    {
+        return;
+    }
+    lastThrottledRefresh = now;
+
+    for (auto& instance : watchedInstances)
+    {
+        try
+        {
+            if (instance->refreshThrottled(queryConnect))
+            {
+                entity->bumpVersion(instance->getHash());
+            }
+        }
+        catch (std::exception& ex)
+        {
+            LOG_ERROR << "Fail to poll the throttled object of Entity '"
+                      << entity->getName() << "': " << ex.what();
+        }
+    }
+}
+
+void EntityDbusBroker::refreshDemand(sdbusplus::bus::bus& queryConnect,
+                                     sdbusplus::bus::bus& watcherConnect)
+{
+    std::unique_lock<std::mutex> lock(guardMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        return;
+    }
+
+    const auto now = steady_clock::now();
+    if (now - lastDemandRefresh < demandRefreshInterval)
+    {
+        return;
+    }
+    lastDemandRefresh = now;
+
+    bool isFetched = false;
+    for (auto& instance : watchedInstances)
+    {
+        try
+        {
+            isFetched |=
+                instance->refreshDemand(queryConnect, watcherConnect, entity);
+        }
+        catch (std::exception& ex)
+        {
+            LOG_ERROR << "Fail to fetch the demanded object of Entity '"
+                      << entity->getName() << "': " << ex.what();
+        }
+    }
+    if (isFetched)
+    {
+        entity->bumpVersion();
+    }
+}
+
 void DBusBrokerManager::start()
 {
     static const std::vector<std::pair<size_t, std::function<void()>>>
@@ -103,6 +219,11 @@ void DBusBrokerManager::start()
         };
 
     active = true;
+    coldStartTime = steady_clock::now();
+    populatedFlags.assign(brokers.size(), false);
+    LOG_INFO << "Populate " << brokers.size() << " DBus brokers across "
+             << threadsBrokersTaskCount << " threads";
+
     size_t totalTasks = 0;
     for (auto& [count, handler] : countTaskThreadsDict)
     {
@@ -137,27 +258,117 @@ void DBusBrokerManager::bind(DBusBrokerPtr broker)
     this->brokers.push_back(broker);
 }
 
+bool DBusBrokerManager::isReady() const
+{
+    return populatedBrokers >= brokers.size();
+}
+
+bool DBusBrokerManager::waitReady(milliseconds timeout) const
+{
+    if (isReady())
+    {
+        return true;
+    }
+
+    std::unique_lock<std::mutex> lock(readyMutex);
+    return readyCondition.wait_for(lock, timeout,
+                                   [this]() { return isReady(); });
+}
+
+bool DBusBrokerManager::populate(size_t index,
+                                 sdbusplus::bus::bus& queryConnect,
+                                 sdbusplus::bus::bus& watcherConnect)
+{
+    try
+    {
+        if (!brokers[index]->tryProcess(queryConnect, watcherConnect))
+        {
+            LOG_WARNING << "Cant process broker task: #" << index;
+            return false;
+        }
+    }
+    catch (std::exception& ex)
+    {
+        LOG_ERROR << "Failed to populate broker #" << index << ": "
+                  << ex.what();
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(readyMutex);
+    if (populatedFlags[index])
+    {
+        return true;
+    }
+    populatedFlags[index] = true;
+    if (++populatedBrokers == brokers.size())
+    {
+        LOG_INFO << "All DBus brokers populated in "
+                 << duration_cast<milliseconds>(steady_clock::now() -
+                                                coldStartTime)
+                        .count()
+                 << "ms";
+        readyCondition.notify_all();
+    }
+    return true;
+}
+
+void DBusBrokerManager::doColdStart(sdbusplus::bus::bus& queryConnect,
+                                    sdbusplus::bus::bus& watcherConnect)
+{
+    std::vector<size_t> failedBrokers;
+    for (size_t index = nextColdStartBroker++; index < brokers.size() && active;
+         index = nextColdStartBroker++)
+    {
+        if (!populate(index, queryConnect, watcherConnect))
+        {
+            failedBrokers.push_back(index);
+        }
+    }
+
+    const auto deadline = coldStartTime + coldStartRetryDeadline;
+    while (!failedBrokers.empty() && active &&
+           steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(coldStartRetryInterval);
+        failedBrokers.erase(
+            std::remove_if(failedBrokers.begin(), failedBrokers.end(),
+                           [this, &queryConnect, &watcherConnect](
+                               size_t index) {
+                               return populate(index, queryConnect,
+                                               watcherConnect);
+                           }),
+            failedBrokers.end());
+    }
+    for (const auto index : failedBrokers)
+    {
+        LOG_ERROR << "Broker #" << index << " isn't populated on cold start, "
+                  << "it is left to the regular polls";
+    }
+}
+
 void DBusBrokerManager::doCaptureDbus()
 {
     auto dbusConnect = createDbusConnection();
     auto dbusMatchConnect = createDbusConnection();
 
+    doColdStart(*dbusConnect->getConnect(), *dbusMatchConnect->getConnect());
+
     while (active)
     {
         auto& connection = dbusConnect->getConnect();
 
-        for (const auto& broker : brokers)
+        for (size_t index = 0; index < brokers.size(); index++)
         {
+            const auto& broker = brokers[index];
             if (broker->isTimeout())
             {
                 LOG_DEBUG << "Try process broker task: #"
                           << std::this_thread::get_id();
-                if (!broker->tryProcess(*connection,
-                                        *dbusMatchConnect->getConnect()))
-                {
-                    LOG_WARNING << "Cant process broker task";
-                }
+                populate(index, *connection, *dbusMatchConnect->getConnect());
             }
+            broker->refreshThrottled(*connection);
+            broker->refreshDemand(*connection,
+                                  *dbusMatchConnect->getConnect());
         }
 
         // Process watcher while haven't ready tasks
@@ -12,15 +12,25 @@
 
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstring>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <thread>
 #include <vector>
 
 namespace app
 {
 
+namespace query
+{
+namespace dbus
+{
+class DBusInstance;
+} // namespace dbus
+} // namespace query
+
 namespace broker
 {
 
@@ -47,6 +57,20 @@ class DBusBroker : public Broker
     virtual bool tryProcess(sdbusplus::bus::bus&, sdbusplus::bus::bus&);
 
     virtual void registerObjectsListener(sdbusplus::bus::bus&);
+
+    /**
+     * @brief Poll the watched objects whose DBus signals have been dropped by
+     *        the rate limits.
+     */
+    virtual void refreshThrottled(sdbusplus::bus::bus&);
+
+    /**
+     * @brief Follow the demand of the entity members by the GraphQL queries:
+     *        the DBus interfaces nobody reads are not watched, the ones
+     *        demanded again are fetched and watched again.
+     */
+    virtual void refreshDemand(sdbusplus::bus::bus& queryConnect,
+                               sdbusplus::bus::bus& watcherConnect);
 };
 
 class EntityDbusBroker : public DBusBroker
@@ -54,6 +78,20 @@ class EntityDbusBroker : public DBusBroker
     std::mutex guardMutex;
     entity::EntityPtr entity;
     QueryEntityPtr entityQuery;
+    std::vector<std::shared_ptr<query::dbus::DBusInstance>> watchedInstances;
+    steady_clock::time_point lastThrottledRefresh;
+    steady_clock::time_point lastDemandRefresh;
+
+    // The refresh statistics are read by the metrics exporter without the
+    // guard mutex.
+    std::atomic_uint64_t refreshes{0};
+    std::atomic_uint64_t refreshErrors{0};
+    std::atomic_uint64_t lastRefreshMicroseconds{0};
+    std::atomic_uint64_t totalRefreshMicroseconds{0};
+    std::atomic_size_t instancesCount{0};
+    std::atomic<steady_clock::rep> lastRefreshTime{0};
+
+    static constexpr seconds demandRefreshInterval{1};
 
   public:
     EntityDbusBroker(entity::EntityPtr entityPointer,
@@ -67,6 +105,56 @@ class EntityDbusBroker : public DBusBroker
     bool tryProcess(sdbusplus::bus::bus&, sdbusplus::bus::bus&) override;
 
     void registerObjectsListener(sdbusplus::bus::bus&) override;
+
+    void refreshThrottled(sdbusplus::bus::bus&) override;
+
+    void refreshDemand(sdbusplus::bus::bus& queryConnect,
+                       sdbusplus::bus::bus& watcherConnect) override;
+
+    const entity::EntityPtr& getEntity() const
+    {
+        return entity;
+    }
+
+    /**
+     * @brief The count of the succeeded entity refreshes
+     */
+    uint64_t getRefreshes() const
+    {
+        return refreshes.load(std::memory_order_relaxed);
+    }
+    uint64_t getRefreshErrors() const
+    {
+        return refreshErrors.load(std::memory_order_relaxed);
+    }
+    uint64_t getLastRefreshMicroseconds() const
+    {
+        return lastRefreshMicroseconds.load(std::memory_order_relaxed);
+    }
+    uint64_t getTotalRefreshMicroseconds() const
+    {
+        return totalRefreshMicroseconds.load(std::memory_order_relaxed);
+    }
+    /**
+     * @brief The count of the entity instances set by the last refresh
+     */
+    size_t getInstancesCount() const
+    {
+        return instancesCount.load(std::memory_order_relaxed);
+    }
+    /**
+     * @brief Get the time of the last succeeded refresh, nullopt if the
+     *        entity is never refreshed.
+     */
+    std::optional<steady_clock::time_point> getLastRefreshTime() const
+    {
+        const auto ticks = lastRefreshTime.load(std::memory_order_relaxed);
+        if (ticks == 0)
+        {
+            return std::nullopt;
+        }
+        return steady_clock::time_point(steady_clock::duration(ticks));
+    }
 };
 
 class DBusBrokerManager : public IBrokerManager
@@ -76,7 +164,23 @@ class DBusBrokerManager : public IBrokerManager
     // const size_t threadsWatchersTaskCount;
     std::atomic_bool active;
 
+    // The cold start queue is shared across the brokers threads: each thread
+    // claims the next not populated broker until the queue is drained.
+    std::atomic_size_t nextColdStartBroker;
+    std::atomic_size_t populatedBrokers;
+    steady_clock::time_point coldStartTime;
+
+    mutable std::mutex readyMutex;
+    mutable std::condition_variable readyCondition;
+    // Whether the broker of the same index is populated, guarded by the
+    // ready mutex.
+    std::vector<bool> populatedFlags;
+
     static constexpr size_t defaultBrokerThreadCount = 10;
+    // The failed cold start populations are retried by the cold start
+    // threads until the deadline, then by the regular polls.
+    static constexpr seconds coldStartRetryInterval{1};
+    static constexpr seconds coldStartRetryDeadline{60};
     static constexpr size_t objectsWatchersTheradCount = 1;
   public:
     DBusBrokerManager(const DBusBrokerManager&) = delete;
@@ -87,7 +191,7 @@ class DBusBrokerManager : public IBrokerManager
     explicit DBusBrokerManager(
         size_t brokersTaskCount = defaultBrokerThreadCount) :
         threadsBrokersTaskCount(brokersTaskCount),
-        active(false)
+        active(false), nextColdStartBroker(0), populatedBrokers(0)
     {
       LOG_DEBUG << "Total brokers thread count is " << threadsBrokersTaskCount;
       objectObserverConnect = createDbusConnection();
@@ -104,7 +208,42 @@ class DBusBrokerManager : public IBrokerManager
      */
     void bind(DBusBrokerPtr);
 
+    /**
+     * @brief Whether each bound broker has completed its initial population.
+     *        Only the succeeded populations are counted.
+     *
+     * @return true - all entities have been populated at least once
+     */
+    bool isReady() const;
+
+    /**
+     * @brief Block the caller until the initial population is completed or
+     *        the timeout is expired.
+     *
+     * @param timeout - the maximum time to wait
+     * @return true - all entities have been populated at least once
+     */
+    bool waitReady(milliseconds timeout) const;
+
+    /**
+     * @brief Get the bound brokers. The brokers are bound before the manager
+     *        is started, hence the list is not changed while it's read.
+     */
+    const std::vector<DBusBrokerPtr>& getBrokers() const
+    {
+        return brokers;
+    }
+
   protected:
+    void doColdStart(sdbusplus::bus::bus&, sdbusplus::bus::bus&);
+    /**
+     * @brief Process the broker task and count the first succeeded one.
+     *
+     * @param index - the index of the broker
+     * @return true - the broker task is succeeded
+     */
+    bool populate(size_t index, sdbusplus::bus::bus& queryConnect,
+                  sdbusplus::bus::bus& watcherConnect);
     void doCaptureDbus();
     void doManageringObjects();
 
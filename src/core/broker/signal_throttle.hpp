@@ -0,0 +1,286 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#ifndef __SIGNAL_THROTTLE_H__
+#define __SIGNAL_THROTTLE_H__
+
+#include <config.h>
+
+#include <logger/logger.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace app
+{
+namespace broker
+{
+
+class ServiceSignalLimiter;
+
+using ServiceSignalLimiterPtr = std::shared_ptr<ServiceSignalLimiter>;
+
+/**
+ * @brief The token bucket to limit the rate of the DBus signals processing.
+ */
+class TokenBucket final
+{
+    const double rate;
+    const double burst;
+    double tokens;
+    std::chrono::steady_clock::time_point lastRefill;
+    std::mutex guardMutex;
+
+  public:
+    TokenBucket(const TokenBucket&) = delete;
+    TokenBucket& operator=(const TokenBucket&) = delete;
+    TokenBucket(TokenBucket&&) = delete;
+    TokenBucket& operator=(TokenBucket&&) = delete;
+
+    /**
+     * @brief Construct a new Token Bucket object
+     *
+     * @param ratePerSecond - the count of tokens to refill each second.
+     * @param burstSize     - the maximum count of tokens to accumulate.
+     */
+    explicit TokenBucket(double ratePerSecond, double burstSize) :
+        rate(ratePerSecond), burst(burstSize), tokens(burstSize),
+        lastRefill(std::chrono::steady_clock::now())
+    {}
+    ~TokenBucket() noexcept = default;
+
+    bool tryConsume()
+    {
+        std::lock_guard<std::mutex> lock(guardMutex);
+
+        refill(std::chrono::steady_clock::now());
+        if (tokens < 1.0)
+        {
+            return false;
+        }
+        tokens -= 1.0;
+        return true;
+    }
+
+    /**
+     * @brief Consume the token of each bucket. No token is consumed unless
+     *        both buckets can give one.
+     *
+     * @param first  - the first bucket
+     * @param second - the second bucket
+     * @return std::pair<bool, bool> - whether the first and the second
+     *                                 bucket has the token
+     */
+    static std::pair<bool, bool> tryConsumeBoth(TokenBucket& first,
+                                                TokenBucket& second)
+    {
+        std::scoped_lock lock(first.guardMutex, second.guardMutex);
+
+        const auto now = std::chrono::steady_clock::now();
+        first.refill(now);
+        second.refill(now);
+        const bool hasFirstToken = first.tokens >= 1.0;
+        const bool hasSecondToken = second.tokens >= 1.0;
+        if (hasFirstToken && hasSecondToken)
+        {
+            first.tokens -= 1.0;
+            second.tokens -= 1.0;
+        }
+        return {hasFirstToken, hasSecondToken};
+    }
+
+  private:
+    void refill(std::chrono::steady_clock::time_point now)
+    {
+        const std::chrono::duration<double> elapsed = now - lastRefill;
+        tokens = std::min(burst, tokens + elapsed.count() * rate);
+        lastRefill = now;
+    }
+};
+
+/**
+ * @brief The signals rate limiter of a single DBus service. Counts the
+ *        accepted and the dropped signals of the service, including the
+ *        signals dropped by the limits of the service objects. The service
+ *        is throttled by its own limit only, until no signal is dropped by
+ *        it for the recovery interval.
+ */
+class ServiceSignalLimiter final
+{
+    const std::string service;
+    TokenBucket bucket;
+    std::atomic_uint64_t accepted;
+    std::atomic_uint64_t dropped;
+
+    mutable std::mutex stateMutex;
+    bool throttled;
+    std::chrono::steady_clock::time_point lastThrottledDrop;
+    // The signals dropped by the service limit while throttled
+    uint64_t throttledDrops;
+
+  public:
+    static constexpr std::chrono::seconds recoveryInterval{5};
+
+    ServiceSignalLimiter(const ServiceSignalLimiter&) = delete;
+    ServiceSignalLimiter& operator=(const ServiceSignalLimiter&) = delete;
+    ServiceSignalLimiter(ServiceSignalLimiter&&) = delete;
+    ServiceSignalLimiter& operator=(ServiceSignalLimiter&&) = delete;
+
+    explicit ServiceSignalLimiter(const std::string& serviceName,
+                                  double ratePerSecond) :
+        service(serviceName),
+        bucket(ratePerSecond, ratePerSecond), accepted(0), dropped(0),
+        throttled(false), throttledDrops(0)
+    {}
+    ~ServiceSignalLimiter() noexcept = default;
+
+    /**
+     * @brief Check both the object and the service limits.
+     *
+     * @param objectBucket - the bucket of the object that emits the signal
+     * @return true - the signal should be processed
+     */
+    bool tryAccept(TokenBucket& objectBucket)
+    {
+        const auto [hasObjectToken, hasServiceToken] =
+            TokenBucket::tryConsumeBoth(objectBucket, bucket);
+        if (hasObjectToken && hasServiceToken)
+        {
+            accepted++;
+        }
+        else
+        {
+            dropped++;
+        }
+        updateState(!hasServiceToken);
+        return hasObjectToken && hasServiceToken;
+    }
+
+    const std::string& getService() const
+    {
+        return service;
+    }
+    uint64_t getAccepted() const
+    {
+        return accepted;
+    }
+    uint64_t getDropped() const
+    {
+        return dropped;
+    }
+    bool isThrottled() const
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        const auto sinceDrop =
+            std::chrono::steady_clock::now() - lastThrottledDrop;
+        return throttled && sinceDrop < recoveryInterval;
+    }
+
+  private:
+    /**
+     * @brief Switch the throttled state of the service. Each transition is
+     *        logged once.
+     *
+     * @param isServiceDrop - the signal is dropped by the service limit
+     */
+    void updateState(bool isServiceDrop)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (isServiceDrop)
+        {
+            lastThrottledDrop = now;
+            throttledDrops++;
+            if (!throttled)
+            {
+                throttled = true;
+                LOG_WARNING << "DBus signals of the service '" << service
+                            << "' are throttled. Fall back to polling";
+            }
+            return;
+        }
+        if (throttled && now - lastThrottledDrop >= recoveryInterval)
+        {
+            LOG_INFO << "DBus signals of the service '" << service
+                     << "' are not throttled anymore. Dropped while "
+                        "throttled: "
+                     << throttledDrops;
+            throttled = false;
+            throttledDrops = 0;
+        }
+    }
+};
+
+/**
+ * @brief The registry of the per-service DBus signals limiters.
+ */
+class SignalThrottle final
+{
+    std::mutex limitersMutex;
+    std::map<std::string, ServiceSignalLimiterPtr> limiters;
+
+    SignalThrottle() = default;
+
+  public:
+    static constexpr double serviceSignalsRate = BMC_SIGNAL_RATE_SERVICE;
+    static constexpr double objectSignalsRate = BMC_SIGNAL_RATE_OBJECT;
+    // The minimal interval between polls of a throttled object.
+    static constexpr std::chrono::seconds throttledPollInterval{1};
+
+    SignalThrottle(const SignalThrottle&) = delete;
+    SignalThrottle& operator=(const SignalThrottle&) = delete;
+    SignalThrottle(SignalThrottle&&) = delete;
+    SignalThrottle& operator=(SignalThrottle&&) = delete;
+    ~SignalThrottle() noexcept = default;
+
+    static SignalThrottle& getInstance()
+    {
+        static SignalThrottle signalThrottle;
+        return signalThrottle;
+    }
+
+    /**
+     * @brief Get the limiter of the DBus service. The limiter is created on
+     *        the first request.
+     */
+    const ServiceSignalLimiterPtr& getLimiter(const std::string& service)
+    {
+        std::lock_guard<std::mutex> lock(limitersMutex);
+        auto findLimiterIt = limiters.find(service);
+        if (findLimiterIt == limiters.end())
+        {
+            findLimiterIt =
+                limiters
+                    .emplace(service, std::make_shared<ServiceSignalLimiter>(
+                                          service, serviceSignalsRate))
+                    .first;
+        }
+        return findLimiterIt->second;
+    }
+
+    /**
+     * @brief Get the limiters of all services that emit the watched signals
+     */
+    const std::vector<ServiceSignalLimiterPtr> getLimiters()
+    {
+        std::vector<ServiceSignalLimiterPtr> result;
+        std::lock_guard<std::mutex> lock(limitersMutex);
+        for (auto& [_, limiter] : limiters)
+        {
+            result.push_back(limiter);
+        }
+        return std::forward<std::vector<ServiceSignalLimiterPtr>>(result);
+    }
+};
+
+} // namespace broker
+} // namespace app
+
+#endif // __SIGNAL_THROTTLE_H__
@@ -0,0 +1,206 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#include <core/compression.hpp>
+#include <core/exceptions.hpp>
+#include <http/headers.hpp>
+#include <logger/logger.hpp>
+
+#include <sstream>
+
+namespace app
+{
+namespace core
+{
+
+namespace
+{
+// The zlib window bits of the gzip format, the zlib format is 15
+constexpr int gzipWindowBits = 15 + 16;
+constexpr int zlibWindowBits = 15;
+constexpr int memoryLevel = 8;
+} // namespace
+
+DeflateStreamBuffer::DeflateStreamBuffer(std::ostream& sinkStream,
+                                         std::string_view encoding,
+                                         size_t maxCaptured) :
+    sink(sinkStream),
+    stream(), isFinished(false), isFailed(false), captureLimit(maxCaptured)
+{
+    const int windowBits = encoding == http::content_encodings::gzip
+                               ? gzipWindowBits
+                               : zlibWindowBits;
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits,
+                     memoryLevel, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        throw exceptions::ObmcAppException(
+            "Can't initialize the zlib stream to compress the response");
+    }
+    setp(inputBuffer.data(), inputBuffer.data() + inputBuffer.size());
+}
+
+DeflateStreamBuffer::~DeflateStreamBuffer() noexcept
+{
+    deflateEnd(&stream);
+}
+
+bool DeflateStreamBuffer::finish()
+{
+    if (!isFinished)
+    {
+        deflatePending(Z_FINISH);
+        isFinished = true;
+        sink.flush();
+    }
+    return !isFailed;
+}
+
+const std::string* DeflateStreamBuffer::getCaptured() const
+{
+    if (!isFinished || isFailed || captureLimit == 0)
+    {
+        return nullptr;
+    }
+    return &captured;
+}
+
+DeflateStreamBuffer::int_type DeflateStreamBuffer::overflow(int_type symbol)
+{
+    if (isFinished || !deflatePending(Z_NO_FLUSH))
+    {
+        return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(symbol, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(symbol);
+        pbump(1);
+    }
+    return traits_type::not_eof(symbol);
+}
+
+int DeflateStreamBuffer::sync()
+{
+    // The pending data is compressed without the flush marker: the explicit
+    // flush of the writer would hurt the compression ratio otherwise.
+    if (isFinished || !deflatePending(Z_NO_FLUSH))
+    {
+        return -1;
+    }
+    sink.flush();
+    return sink.good() ? 0 : -1;
+}
+
+bool DeflateStreamBuffer::deflatePending(int flush)
+{
+    stream.next_in = reinterpret_cast<Bytef*>(pbase());
+    stream.avail_in = static_cast<uInt>(pptr() - pbase());
+
+    int status = Z_OK;
+    do
+    {
+        stream.next_out = reinterpret_cast<Bytef*>(outputBuffer.data());
+        stream.avail_out = static_cast<uInt>(outputBuffer.size());
+        status = deflate(&stream, flush);
+        if (status == Z_STREAM_ERROR)
+        {
+            LOG_ERROR << "Can't compress the response: " << stream.msg;
+            isFailed = true;
+            break;
+        }
+
+        const auto produced = outputBuffer.size() - stream.avail_out;
+        sink.write(outputBuffer.data(), static_cast<std::streamsize>(produced));
+        if (captureLimit != 0)
+        {
+            if (captured.size() + produced > captureLimit)
+            {
+                // Too big to cache, hence it isn't captured any more
+                captureLimit = 0;
+                captured.clear();
+                captured.shrink_to_fit();
+            }
+            else
+            {
+                captured.append(outputBuffer.data(), produced);
+            }
+        }
+    } while (stream.avail_out == 0 ||
+             (flush == Z_FINISH && status != Z_STREAM_END));
+
+    setp(inputBuffer.data(), inputBuffer.data() + inputBuffer.size());
+    isFailed = isFailed || !sink.good();
+    return !isFailed;
+}
+
+const std::string DeflateStreamBuffer::compress(std::string_view data,
+                                                std::string_view encoding)
+{
+    std::ostringstream output;
+    DeflateStreamBuffer compressor(output, encoding);
+    compressor.sputn(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!compressor.finish())
+    {
+        throw exceptions::ObmcAppException("Can't compress the response");
+    }
+    return std::forward<std::string>(output.str());
+}
+
+std::shared_ptr<const std::string>
+    CompressedResponseCache::find(const std::string& entityTag,
+                                  std::string_view encoding)
+{
+    const auto key = getKey(entityTag, encoding);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto findEntryIt = entriesIndex.find(key);
+    if (findEntryIt == entriesIndex.end())
+    {
+        misses++;
+        return nullptr;
+    }
+    hits++;
+    entries.splice(entries.begin(), entries, findEntryIt->second);
+    return findEntryIt->second->body;
+}
+
+void CompressedResponseCache::store(const std::string& entityTag,
+                                    std::string_view encoding,
+                                    std::shared_ptr<const std::string> body)
+{
+    if (!body || body->size() > maxEntryBytes)
+    {
+        return;
+    }
+
+    auto key = getKey(entityTag, encoding);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto findEntryIt = entriesIndex.find(key);
+    if (findEntryIt != entriesIndex.end())
+    {
+        totalBytes -= findEntryIt->second->body->size();
+        entries.erase(findEntryIt->second);
+        entriesIndex.erase(findEntryIt);
+    }
+    while (!entries.empty() && totalBytes + body->size() > capacityBytes)
+    {
+        totalBytes -= entries.back().body->size();
+        entriesIndex.erase(entries.back().key);
+        entries.pop_back();
+    }
+
+    totalBytes += body->size();
+    entries.push_front(CacheEntry{key, std::move(body)});
+    entriesIndex.emplace(std::move(key), entries.begin());
+}
+
+const std::string
+    CompressedResponseCache::getKey(const std::string& entityTag,
+                                    std::string_view encoding)
+{
+    std::string key(encoding);
+    key.push_back(':');
+    key.append(entityTag);
+    return std::forward<std::string>(key);
+}
+
+} // namespace core
+} // namespace app
@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#ifndef __COMPRESSION_H__
+#define __COMPRESSION_H__
+
+#include <zlib.h>
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace app
+{
+namespace core
+{
+
+/**
+ * @brief The output stream buffer which compresses the written data into the
+ *        sink stream. The gzip coding is written in the gzip format, the
+ *        deflate coding is written in the zlib format as RFC 7230 requires.
+ *        The compressed output might be captured to cache it.
+ */
+class DeflateStreamBuffer final : public std::streambuf
+{
+    static constexpr size_t chunkSize = 16 * 1024;
+
+  public:
+    DeflateStreamBuffer(const DeflateStreamBuffer&) = delete;
+    DeflateStreamBuffer& operator=(const DeflateStreamBuffer&) = delete;
+    DeflateStreamBuffer(DeflateStreamBuffer&&) = delete;
+    DeflateStreamBuffer& operator=(DeflateStreamBuffer&&) = delete;
+
+    /**
+     * @brief Construct the compressing stream buffer.
+     *
+     * @param sink         - the stream of the compressed output
+     * @param encoding     - the gzip or the deflate content coding
+     * @param captureLimit - the maximum size of the compressed output to
+     *                       capture, the zero disables the capturing
+     * @throw exceptions::ObmcAppException - the zlib stream can't be
+     *                                       initialized
+     */
+    DeflateStreamBuffer(std::ostream& sink, std::string_view encoding,
+                        size_t captureLimit = 0);
+    ~DeflateStreamBuffer() noexcept override;
+
+    /**
+     * @brief Compress the rest of the written data and write the trailer of
+     *        the compressed stream. Nothing is written after the finish.
+     *
+     * @return bool - whether the compressed stream is successfully written
+     */
+    bool finish();
+
+    /**
+     * @brief Get the whole captured compressed output
+     *
+     * @return const std::string* - the captured output, or nullptr if the
+     *                               output isn't finished or exceeds the
+     *                               capture limit
+     */
+    const std::string* getCaptured() const;
+
+    /**
+     * @brief Compress the data into the buffer
+     *
+     * @param data     - the data to compress
+     * @param encoding - the gzip or the deflate content coding
+     * @return const std::string - the compressed data
+     */
+    static const std::string compress(std::string_view data,
+                                      std::string_view encoding);
+
+  protected:
+    int_type overflow(int_type symbol) override;
+    int sync() override;
+
+    bool deflatePending(int flush);
+
+  private:
+    std::ostream& sink;
+    z_stream stream;
+    bool isFinished;
+    bool isFailed;
+    size_t captureLimit;
+    std::string captured;
+    std::array<char, chunkSize> inputBuffer;
+    std::array<char, chunkSize> outputBuffer;
+};
+
+/**
+ * @brief The bounded LRU cache of the compressed responses by the entity
+ *        tag and the content coding. The entity tag is changed once the data
+ *        of the response is changed, hence the popular response is
+ *        compressed once per the data change rather than once per request.
+ */
+class CompressedResponseCache final
+{
+    static constexpr size_t capacityBytes = 1024 * 1024;
+
+    struct CacheEntry
+    {
+        std::string key;
+        std::shared_ptr<const std::string> body;
+    };
+    using CacheList = std::list<CacheEntry>;
+
+    std::mutex cacheMutex;
+    CacheList entries;
+    std::unordered_map<std::string, CacheList::iterator> entriesIndex;
+    size_t totalBytes = 0;
+
+    CompressedResponseCache() = default;
+
+  public:
+    static constexpr size_t maxEntryBytes = capacityBytes / 4;
+
+    CompressedResponseCache(const CompressedResponseCache&) = delete;
+    CompressedResponseCache& operator=(const CompressedResponseCache&) = delete;
+    CompressedResponseCache(CompressedResponseCache&&) = delete;
+    CompressedResponseCache& operator=(CompressedResponseCache&&) = delete;
+    ~CompressedResponseCache() noexcept = default;
+
+    static CompressedResponseCache& getInstance()
+    {
+        static CompressedResponseCache compressedCache;
+        return compressedCache;
+    }
+
+    /**
+     * @brief Find the compressed body of the response
+     *
+     * @param entityTag - the entity tag of the response
+     * @param encoding  - the content coding
+     * @return std::shared_ptr<const std::string> - the compressed body, or
+     *                                              nullptr on the cache miss
+     */
+    std::shared_ptr<const std::string> find(const std::string& entityTag,
+                                            std::string_view encoding);
+
+    /**
+     * @brief Store the compressed body of the response. The body exceeding
+     *        the maximum entry size is not stored.
+     */
+    void store(const std::string& entityTag, std::string_view encoding,
+               std::shared_ptr<const std::string> body);
+
+    static size_t getHits()
+    {
+        return hits;
+    }
+
+    static size_t getMisses()
+    {
+        return misses;
+    }
+
+  protected:
+    static const std::string getKey(const std::string& entityTag,
+                                    std::string_view encoding);
+
+  private:
+    static inline std::atomic_size_t hits{0};
+    static inline std::atomic_size_t misses{0};
+};
+
+} // namespace core
+} // namespace app
+
+#endif // __COMPRESSION_H__
@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#ifndef __DBUS_STATISTICS_H__
+#define __DBUS_STATISTICS_H__
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace app
+{
+namespace connect
+{
+
+class ServiceCallCounter;
+
+using ServiceCallCounterPtr = std::shared_ptr<ServiceCallCounter>;
+
+/**
+ * @brief The counters of the DBus method calls to a single DBus service.
+ */
+class ServiceCallCounter final
+{
+    const std::string service;
+    std::atomic_uint64_t calls;
+    std::atomic_uint64_t errors;
+
+  public:
+    ServiceCallCounter(const ServiceCallCounter&) = delete;
+    ServiceCallCounter& operator=(const ServiceCallCounter&) = delete;
+    ServiceCallCounter(ServiceCallCounter&&) = delete;
+    ServiceCallCounter& operator=(ServiceCallCounter&&) = delete;
+
+    explicit ServiceCallCounter(const std::string& serviceName) :
+        service(serviceName), calls(0), errors(0)
+    {}
+    ~ServiceCallCounter() noexcept = default;
+
+    void countCall()
+    {
+        calls.fetch_add(1, std::memory_order_relaxed);
+    }
+    void countError()
+    {
+        errors.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const std::string& getService() const
+    {
+        return service;
+    }
+    uint64_t getCalls() const
+    {
+        return calls.load(std::memory_order_relaxed);
+    }
+    uint64_t getErrors() const
+    {
+        return errors.load(std::memory_order_relaxed);
+    }
+};
+
+/**
+ * @brief The registry of the per-service DBus calls counters.
+ */
+class DBusCallStatistics final
+{
+    std::mutex countersMutex;
+    std::map<std::string, ServiceCallCounterPtr, std::less<>> counters;
+
+    DBusCallStatistics() = default;
+
+  public:
+    DBusCallStatistics(const DBusCallStatistics&) = delete;
+    DBusCallStatistics& operator=(const DBusCallStatistics&) = delete;
+    DBusCallStatistics(DBusCallStatistics&&) = delete;
+    DBusCallStatistics& operator=(DBusCallStatistics&&) = delete;
+    ~DBusCallStatistics() noexcept = default;
+
+    static DBusCallStatistics& getInstance()
+    {
+        static DBusCallStatistics callStatistics;
+        return callStatistics;
+    }
+
+    /**
+     * @brief Get the calls counter of the DBus service. The counter is
+     *        created on the first request.
+     */
+    const ServiceCallCounterPtr getCounter(const std::string& service)
+    {
+        std::lock_guard<std::mutex> lock(countersMutex);
+        auto findCounterIt = counters.find(service);
+        if (findCounterIt == counters.end())
+        {
+            findCounterIt =
+                counters
+                    .emplace(service,
+                             std::make_shared<ServiceCallCounter>(service))
+                    .first;
+        }
+        return findCounterIt->second;
+    }
+
+    /**
+     * @brief Get the counters of all called DBus services
+     */
+    const std::vector<ServiceCallCounterPtr> getCounters()
+    {
+        std::vector<ServiceCallCounterPtr> result;
+        std::lock_guard<std::mutex> lock(countersMutex);
+        result.reserve(counters.size());
+        for (auto& [_, counter] : counters)
+        {
+            result.push_back(counter);
+        }
+        return result;
+    }
+};
+
+} // namespace connect
+} // namespace app
+
+#endif // __DBUS_STATISTICS_H__
@@ -2,19 +2,62 @@
 // SPDX-License-Identifier: Apache-2.0
 // Copyright (C) 2021 YADRO
 
+#include <core/compression.hpp>
 #include <core/connection.hpp>
+#include <core/request_metrics.hpp>
 #include <http/headers.hpp>
 #include <logger/logger.hpp>
 
+#include <array>
+#include <charconv>
+#include <limits>
+
 namespace app
 {
 namespace core
 {
 
+namespace
+{
+// Counts the request as active while the scope isn't left
+class ActiveRequestGuard final
+{
+  public:
+    ActiveRequestGuard(const ActiveRequestGuard&) = delete;
+    ActiveRequestGuard& operator=(const ActiveRequestGuard&) = delete;
+    ActiveRequestGuard(ActiveRequestGuard&&) = delete;
+    ActiveRequestGuard& operator=(ActiveRequestGuard&&) = delete;
+
+    explicit ActiveRequestGuard(std::atomic_size_t& activeCounter) noexcept :
+        counter(activeCounter)
+    {
+        counter.fetch_add(1, std::memory_order_relaxed);
+    }
+    ~ActiveRequestGuard() noexcept
+    {
+        counter.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic_size_t& counter;
+};
+} // namespace
+
 Connection::Connection() :
-    Fastcgipp::Request<char>(maxBodySizeByte), totalBytesRecived(0), request(),
-    router()
-{}
+    Fastcgipp::Request<char>(maxBodySizeByte), totalBytesRecived(0),
+    startTime(std::chrono::steady_clock::now()), request(), router(),
+    isQueued(true)
+{
+    queuedRequests.fetch_add(1, std::memory_order_relaxed);
+}
+
+Connection::~Connection()
+{
+    if (isQueued)
+    {
+        queuedRequests.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
 
 void Connection::inHandler(int bytesReceived)
 {
@@ -30,7 +73,8 @@ bool Connection::inProcessor()
 {
     LOG_DEBUG << "Custom 'Content Type' detected";
 
-    if (environment().contentType.empty())
+    if (environment().contentType.empty() &&
+        environment().requestMethod != Fastcgipp::Http::RequestMethod::GET)
     {
         LOG_ALERT << "Unknown Content Type. Immediate close";
         return false;
@@ -44,7 +88,7 @@ bool Connection::inProcessor()
 
     if (!router)
     {
-        router = std::make_unique<app::core::Router>(this->request);
+        router.emplace(this->request);
     }
 
     // Processing the 'preHandlers' in the 'inProcessor', because after that
@@ -57,6 +101,18 @@ bool Connection::response()
     LOG_DEBUG << "New Connection. Response";
     using namespace Fastcgipp::Http;
 
+    if (isQueued)
+    {
+        isQueued = false;
+        queuedRequests.fetch_sub(1, std::memory_order_relaxed);
+    }
+    const ActiveRequestGuard activeGuard(activeRequests);
+
+    if (message().type == bodyStreamMessage)
+    {
+        return writeStreamPart();
+    }
+
     if (!router)
     {
         LOG_CRITICAL << "The route handler not initialized.";
@@ -65,17 +121,187 @@ bool Connection::response()
 
     LOG_DEBUG << "Process Route.";
     decltype(auto) responsePtr = router->process();
-    LOG_DEBUG << "Write Headers.";
-    writeHeader(responsePtr);
-    LOG_DEBUG << "Write response to out.";
+    // The events stream lasts for minutes, it's not the request latency
+    const bool isEventStream = responsePtr->getContentType() ==
+                               app::http::content_types::textEventStream;
+    {
+        PhaseTimer writingTimer(RequestPhase::writing);
+        if (isEventStream)
+        {
+            writingTimer.discard();
+        }
+        const auto streamEncoding = encodeBody(responsePtr);
+        LOG_DEBUG << "Write Headers.";
+        writeHeader(responsePtr);
+        LOG_DEBUG << "Write response to out.";
 
-    out << *responsePtr;
-    LOG_DEBUG << "Immediate flush data.";
-    out.flush();
+        if (responsePtr->getStatus() != app::http::statuses::Code::NotModified)
+        {
+            if (responsePtr->getBodyStream())
+            {
+                bodyStream = responsePtr->getBodyStream();
+            }
+            else
+            {
+                writeEncodedBody(responsePtr, streamEncoding);
+            }
+        }
+        LOG_DEBUG << "Immediate flush data.";
+        out.flush();
+    }
 
+    auto& requestMetrics = RequestMetrics::getInstance();
+    if (!isEventStream)
+    {
+        requestMetrics.recordPhase(
+            RequestPhase::total, std::chrono::steady_clock::now() - startTime);
+    }
+    requestMetrics.countRequest(static_cast<int>(responsePtr->getStatus()));
+
+    if (bodyStream)
+    {
+        // The request is completed by the last part of the stream, the
+        // worker thread is free until the stream wakes the request up.
+        auto wakeup = callback();
+        bodyStream->start([wakeup]() {
+            Fastcgipp::Message message;
+            message.type = bodyStreamMessage;
+            wakeup(std::move(message));
+        });
+        return writeStreamPart();
+    }
     return true;
 }
 
+bool Connection::writeStreamPart()
+{
+    if (!bodyStream)
+    {
+        return true;
+    }
+
+    bool isCompleted = true;
+    try
+    {
+        isCompleted = bodyStream->writeNext(out);
+        out.flush();
+    }
+    catch (std::exception& ex)
+    {
+        LOG_ERROR << "Can't write the body stream: " << ex.what();
+    }
+    if (isCompleted)
+    {
+        bodyStream.reset();
+    }
+    return isCompleted;
+}
+
+const char* Connection::encodeBody(const ResponseUni& responsePointer)
+{
+    using namespace app::http;
+
+    // The events stream is flushed per event, the compression would hold
+    // the events back.
+    if (responsePointer->getStatus() == statuses::Code::NotModified ||
+        responsePointer->getContentType() == content_types::textEventStream ||
+        (!responsePointer->isStreamed() &&
+         responsePointer->totalSize() < compressionThreshold))
+    {
+        return content_encodings::identity;
+    }
+    responsePointer->setHeader(headers::vary, headers::acceptEncoding);
+
+    auto findHeaderIt = environment().others.find(acceptEncodingHeader);
+    if (findHeaderIt == environment().others.end())
+    {
+        return content_encodings::identity;
+    }
+    const auto encoding = content_encodings::negotiate(findHeaderIt->second);
+    if (std::string_view(encoding) == content_encodings::identity)
+    {
+        return encoding;
+    }
+
+    auto& compressedCache = CompressedResponseCache::getInstance();
+    const auto& entityTag = responsePointer->getEntityTag();
+    auto compressedBody =
+        entityTag.empty() ? nullptr : compressedCache.find(entityTag, encoding);
+    // The length of the streamed body is unknown until it's written, hence
+    // it's compressed while written unless it's cached.
+    if (!compressedBody && responsePointer->isStreamed())
+    {
+        responsePointer->setHeader(headers::contentEncoding, encoding);
+        return encoding;
+    }
+
+    try
+    {
+        if (!compressedBody)
+        {
+            compressedBody = std::make_shared<const std::string>(
+                DeflateStreamBuffer::compress(responsePointer->getBody(),
+                                              encoding));
+            if (!entityTag.empty())
+            {
+                compressedCache.store(entityTag, encoding, compressedBody);
+            }
+        }
+        responsePointer->setBody(std::move(compressedBody));
+    }
+    catch (std::exception& ex)
+    {
+        LOG_ERROR << "Can't compress the response: " << ex.what();
+        return content_encodings::identity;
+    }
+    responsePointer->setHeader(headers::contentEncoding, encoding);
+    return content_encodings::identity;
+}
+
+void Connection::writeEncodedBody(const ResponseUni& responsePointer,
+                                  const char* encoding)
+{
+    using namespace app::http;
+
+    try
+    {
+        if (std::string_view(encoding) == content_encodings::identity)
+        {
+            responsePointer->writeBody(out);
+            return;
+        }
+
+        const auto& entityTag = responsePointer->getEntityTag();
+        DeflateStreamBuffer compressor(
+            out, encoding,
+            entityTag.empty() ? 0 : CompressedResponseCache::maxEntryBytes);
+        std::ostream compressedOutput(&compressor);
+        responsePointer->writeBody(compressedOutput);
+        // The compressed stream is finished even if the body is incomplete,
+        // but only the complete body is cached by the entity tag.
+        const bool isCompleted = static_cast<bool>(compressedOutput);
+        if (!compressor.finish() || !isCompleted)
+        {
+            LOG_ERROR << "The compressed response is truncated";
+            return;
+        }
+
+        const auto* captured = compressor.getCaptured();
+        if (captured != nullptr)
+        {
+            CompressedResponseCache::getInstance().store(
+                entityTag, encoding,
+                std::make_shared<const std::string>(*captured));
+        }
+    }
+    catch (std::exception& ex)
+    {
+        // The headers are already sent, the body is truncated and isn't
+        // cached.
+        LOG_ERROR << "Can't write the response body: " << ex.what();
+    }
+}
+
 void Connection::writeHeader(const ResponseUni& responsePointer)
 {
     using namespace app::http;
@@ -83,16 +309,36 @@ void Connection::writeHeader(const ResponseUni& responsePointer)
     decltype(auto) status = responsePointer->getStatus();
 
     LOG_DEBUG << "Write status header." << static_cast<int>(status);
-    out << headerStatus(status) << std::endl;
 
-    responsePointer->setHeader(headers::contentType,
-                               content_types::applicationJson);
-    responsePointer->setHeader(headers::contentLength,
-                               std::to_string(responsePointer->totalSize()));
+    // The 304 response has no body, hence no representation headers.
+    if (status != statuses::Code::NotModified)
+    {
+        responsePointer->setHeader(headers::contentType,
+                                   responsePointer->getContentType());
+        // The length of the streamed body is unknown until it is written.
+        // The web server delimits such response by itself, e.g. by chunked
+        // encoding.
+        if (!responsePointer->isStreamed())
+        {
+            std::array<char, std::numeric_limits<size_t>::digits10 + 1>
+                lengthBuffer;
+            const auto* lengthEnd =
+                std::to_chars(lengthBuffer.begin(), lengthBuffer.end(),
+                              responsePointer->totalSize())
+                    .ptr;
+            responsePointer->setHeader(
+                headers::contentLength,
+                std::string_view(lengthBuffer.data(),
+                                 static_cast<size_t>(lengthEnd -
+                                                     lengthBuffer.data())));
+        }
+    }
     responsePointer->setHeader(headers::date,
-                               app::helpers::utils::getFormattedCurrentDate());
+                               app::helpers::utils::getCachedCurrentDate());
 
-    out << responsePointer->getHeaders();
+    // The head is written into the buffer of the output and is sent along
+    // with the body by the single flush.
+    responsePointer->writeHead(out);
 }
 
 } // namespace core
@@ -11,6 +11,10 @@
 
 #include <config.h>
 
+#include <atomic>
+#include <chrono>
+#include <optional>
+
 namespace app
 {
 namespace core
@@ -19,6 +23,12 @@ namespace core
 class Connection :public Fastcgipp::Request<char>
 {
     static constexpr const size_t maxBodySizeByte = (HTTP_REQ_BODY_LIMIT_MB << 20U);
+    static constexpr const size_t compressionThreshold =
+        BMC_COMPRESSION_THRESHOLD;
+    static constexpr const char* acceptEncodingHeader = "HTTP_ACCEPT_ENCODING";
+    // The message type which wakes the request up to write the next part of
+    // the body stream. The zero type is reserved by the FastCGI records.
+    static constexpr const int bodyStreamMessage = 1;
 
   public:
     Connection();
@@ -29,7 +39,24 @@ class Connection :public Fastcgipp::Request<char>
     Connection& operator=(const Connection&) = delete;
     Connection& operator=(const Connection&&) = delete;
 
-    ~Connection() = default;
+    ~Connection();
+
+    /**
+     * @brief The count of the requests accepted by the FastCGI manager which
+     *        are still received or wait for the free worker thread.
+     */
+    static size_t getQueuedRequests()
+    {
+        return queuedRequests.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief The count of the requests being responded by the worker threads
+     */
+    static size_t getActiveRequests()
+    {
+        return activeRequests.load(std::memory_order_relaxed);
+    }
 
   protected:
     void inHandler(int) override;
@@ -38,10 +65,38 @@ class Connection :public Fastcgipp::Request<char>
 
   private:
     void writeHeader(const ResponseUni&);
+    /**
+     * @brief Negotiate the content coding of the response body and compress
+     *        the body in advance if the length of it is known. The
+     *        compressed body is taken from the cache by the entity tag if
+     *        present.
+     *
+     * @return const char* - the coding to compress the streamed body while
+     *                       it's written, the identity if the body is sent
+     *                       as is
+     */
+    const char* encodeBody(const ResponseUni&);
+    void writeEncodedBody(const ResponseUni&, const char* encoding);
+    /**
+     * @brief Write the next part of the body stream. The worker thread is
+     *        released until the stream wakes the request up again.
+     *
+     * @return true - the body and the request are completed
+     */
+    bool writeStreamPart();
     size_t totalBytesRecived;
+    const std::chrono::steady_clock::time_point startTime;
 
     RequestPtr request;
-    RouteUni router;
+    // The router is the part of the connection, hence it's not allocated
+    // per request.
+    std::optional<Router> router;
+    // The body stream being written, the request is kept incomplete
+    BodyStreamPtr bodyStream;
+    bool isQueued;
+
+    static inline std::atomic_size_t queuedRequests{0};
+    static inline std::atomic_size_t activeRequests{0};
 };
 
 
@@ -1,9 +1,13 @@
 // SPDX-License-Identifier: Apache-2.0
 // Copyright (C) 2021 YADRO
 
+#include <core/connect/dbus_statistics.hpp>
 #include <core/entity/dbus_query.hpp>
 #include <core/exceptions.hpp>
 
+#include <algorithm>
+#include <cstring>
+
 namespace app
 {
 namespace query
@@ -12,6 +16,266 @@ namespace dbus
 {
 using namespace app::core::exceptions;
 
+namespace
+{
+
+int checkDecodeStatus(int status, const char* step)
+{
+    if (status < 0)
+    {
+        throw ObmcAppException(std::string("Can't decode DBus message at '") +
+                               step + "'. Reason: " + std::strerror(-status));
+    }
+    return status;
+}
+
+/**
+ * @brief Call the DBus method and count the call and the failure of it by
+ *        the counter of the called service.
+ */
+sdbusplus::message::message
+    callMethod(sdbusplus::bus::bus& connect,
+               sdbusplus::message::message& method,
+               const app::connect::ServiceCallCounterPtr& callCounter)
+{
+    callCounter->countCall();
+    try
+    {
+        auto response = connect.call(method);
+        if (response.is_method_error())
+        {
+            callCounter->countError();
+        }
+        return response;
+    }
+    catch (...)
+    {
+        callCounter->countError();
+        throw;
+    }
+}
+
+bool isSupportedSignature(std::string_view signature)
+{
+    constexpr std::string_view basicTypes = "sogbynqiuxtd";
+    if (signature.size() == 1)
+    {
+        return basicTypes.find(signature.front()) != std::string_view::npos;
+    }
+    return signature == "as" || signature == "ad" || signature == "a(sss)";
+}
+
+template <typename TValue>
+IEntity::IEntityMember::IInstance::FieldType readBasic(sd_bus_message* message,
+                                                       char type)
+{
+    TValue value{};
+    checkDecodeStatus(sd_bus_message_read_basic(message, type, &value),
+                      "read basic value");
+    return IEntity::IEntityMember::IInstance::FieldType(
+        std::in_place_type<TValue>, value);
+}
+
+IEntity::IEntityMember::IInstance::FieldType readBasicValue(sd_bus_message* message,
+                                                            char type)
+{
+    using FieldType = IEntity::IEntityMember::IInstance::FieldType;
+    switch (type)
+    {
+        case SD_BUS_TYPE_STRING:
+        case SD_BUS_TYPE_OBJECT_PATH:
+        case 'g':
+        {
+            const char* value = nullptr;
+            checkDecodeStatus(sd_bus_message_read_basic(message, type, &value),
+                              "read string value");
+            return FieldType(std::in_place_type<std::string>,
+                             value ? value : "");
+        }
+        case SD_BUS_TYPE_BOOLEAN:
+        {
+            // The sd-bus boolean is stored as the 'int'
+            int value = 0;
+            checkDecodeStatus(sd_bus_message_read_basic(message, type, &value),
+                              "read boolean value");
+            return FieldType(std::in_place_type<bool>, value != 0);
+        }
+        case SD_BUS_TYPE_BYTE:
+            return readBasic<uint8_t>(message, type);
+        case SD_BUS_TYPE_INT16:
+            return readBasic<int16_t>(message, type);
+        case SD_BUS_TYPE_UINT16:
+            return readBasic<uint16_t>(message, type);
+        case SD_BUS_TYPE_INT32:
+            return readBasic<int32_t>(message, type);
+        case SD_BUS_TYPE_UINT32:
+            return readBasic<uint32_t>(message, type);
+        case SD_BUS_TYPE_INT64:
+            return readBasic<int64_t>(message, type);
+        case SD_BUS_TYPE_UINT64:
+            return readBasic<uint64_t>(message, type);
+        case SD_BUS_TYPE_DOUBLE:
+            return readBasic<double>(message, type);
+        default:
+            break;
+    }
+    throw ObmcAppException(std::string("Unsupported DBus basic type: ") +
+                           type);
+}
+
+} // namespace
+
+const DBusPropertyFormatter::FieldType
+    DBusPropertyFormatter::format(const PropertyName& property,
+                                  const FieldType& value) const
+{
+    FieldType formattedValue(value);
+    for (auto formatter : formatters)
+    {
+        formattedValue = formatter(property, formattedValue);
+    }
+    return formattedValue;
+}
+
+void DBusPropertyDecoder::addSlot(const InterfaceName& interface,
+                                  const PropertyName& property,
+                                  const MemberName& member,
+                                  const DBusPropertyFormatter* formatter)
+{
+    interfaceSlots[interface].emplace(property,
+                                      Slot{property, member, formatter});
+}
+
+const DBusPropertyDecoder::PropertySlots*
+    DBusPropertyDecoder::getSlots(std::string_view interface) const
+{
+    auto findInterfaceIt = interfaceSlots.find(interface);
+    if (findInterfaceIt == interfaceSlots.end())
+    {
+        return nullptr;
+    }
+    return &findInterfaceIt->second;
+}
+
+void DBusPropertyDecoder::decodeProperties(
+    sdbusplus::message::message& message, const PropertySlots& propertySlots,
+    DBusInstance& instance) const
+{
+    auto* rawMessage = message.get();
+
+    checkDecodeStatus(
+        sd_bus_message_enter_container(rawMessage, SD_BUS_TYPE_ARRAY, "{sv}"),
+        "enter properties");
+    while (checkDecodeStatus(sd_bus_message_enter_container(
+                                 rawMessage, SD_BUS_TYPE_DICT_ENTRY, "sv"),
+                             "enter property") > 0)
+    {
+        const char* propertyName = nullptr;
+        checkDecodeStatus(sd_bus_message_read_basic(
+                              rawMessage, SD_BUS_TYPE_STRING, &propertyName),
+                          "read property name");
+
+        auto findSlotIt = propertySlots.find(std::string_view(propertyName));
+        if (findSlotIt == propertySlots.end())
+        {
+            checkDecodeStatus(sd_bus_message_skip(rawMessage, "v"),
+                              "skip property");
+        }
+        else
+        {
+            decodeVariant(message, findSlotIt->second, instance);
+        }
+        checkDecodeStatus(sd_bus_message_exit_container(rawMessage),
+                          "exit property");
+    }
+    checkDecodeStatus(sd_bus_message_exit_container(rawMessage),
+                      "exit properties");
+}
+
+void DBusPropertyDecoder::decodeInterfaces(sdbusplus::message::message& message,
+                                           DBusInstance& instance) const
+{
+    auto* rawMessage = message.get();
+
+    checkDecodeStatus(sd_bus_message_enter_container(
+                          rawMessage, SD_BUS_TYPE_ARRAY, "{sa{sv}}"),
+                      "enter interfaces");
+    while (checkDecodeStatus(sd_bus_message_enter_container(
+                                 rawMessage, SD_BUS_TYPE_DICT_ENTRY, "sa{sv}"),
+                             "enter interface") > 0)
+    {
+        const char* interfaceName = nullptr;
+        checkDecodeStatus(sd_bus_message_read_basic(
+                              rawMessage, SD_BUS_TYPE_STRING, &interfaceName),
+                          "read interface name");
+
+        auto propertySlots = getSlots(interfaceName);
+        if (!propertySlots)
+        {
+            checkDecodeStatus(sd_bus_message_skip(rawMessage, "a{sv}"),
+                              "skip interface");
+        }
+        else
+        {
+            decodeProperties(message, *propertySlots, instance);
+        }
+        checkDecodeStatus(sd_bus_message_exit_container(rawMessage),
+                          "exit interface");
+    }
+    checkDecodeStatus(sd_bus_message_exit_container(rawMessage),
+                      "exit interfaces");
+}
+
+void DBusPropertyDecoder::decodeVariant(sdbusplus::message::message& message,
+                                        const Slot& slot,
+                                        DBusInstance& instance) const
+{
+    auto* rawMessage = message.get();
+    char type = 0;
+    const char* contents = nullptr;
+
+    checkDecodeStatus(sd_bus_message_peek_type(rawMessage, &type, &contents),
+                      "peek property type");
+    const std::string_view signature(contents ? contents : "");
+    if (type != SD_BUS_TYPE_VARIANT || !isSupportedSignature(signature))
+    {
+        LOG_DEBUG << "Unsupported type '" << signature << "' of the property "
+                  << slot.property << ". Skipping";
+        checkDecodeStatus(sd_bus_message_skip(rawMessage, "v"),
+                          "skip property");
+        return;
+    }
+
+    checkDecodeStatus(
+        sd_bus_message_enter_container(rawMessage, SD_BUS_TYPE_VARIANT, contents),
+        "enter property value");
+    if (signature.size() == 1)
+    {
+        instance.fillMember(slot,
+                            readBasicValue(rawMessage, signature.front()));
+    }
+    else if (signature == "as")
+    {
+        std::vector<std::string> values;
+        message.read(values);
+        instance.captureComplexDBusProperty(slot.member, values);
+    }
+    else if (signature == "ad")
+    {
+        std::vector<double> values;
+        message.read(values);
+        instance.captureComplexDBusProperty(slot.member, values);
+    }
+    else
+    {
+        DBusAssociationsType associations;
+        message.read(associations);
+        instance.captureDBusAssociations(slot.member, associations);
+    }
+    checkDecodeStatus(sd_bus_message_exit_container(rawMessage),
+                      "exit property value");
+}
+
 EntityManager::EntityBuilderPtr DBusQueryBuilder::complete()
 {
     return std::move(this->entityBuilder);
@@ -41,16 +305,19 @@ std::vector<IEntity::InstancePtr>
         std::vector<std::pair<std::string, DBusServiceInterfaces>>;
     std::vector<DBusInstancePtr> dbusInstances;
 
+    static const std::string mapperService = "xyz.openbmc_project.ObjectMapper";
     auto mapperCall = connect.new_method_call(
-        "xyz.openbmc_project.ObjectMapper",
-        "/xyz/openbmc_project/object_mapper",
+        mapperService.c_str(), "/xyz/openbmc_project/object_mapper",
         "xyz.openbmc_project.ObjectMapper", "GetSubTree");
 
     mapperCall.append(getQueryCriteria().path);
     mapperCall.append(getQueryCriteria().depth);
     mapperCall.append(getQueryCriteria().interfaces);
 
-    auto mapperResponseMsg = connect.call(mapperCall);
+    static const auto mapperCallCounter =
+        app::connect::DBusCallStatistics::getInstance().getCounter(
+            mapperService);
+    auto mapperResponseMsg = callMethod(connect, mapperCall, mapperCallCounter);
 
     if (mapperResponseMsg.is_method_error())
     {
@@ -181,16 +448,13 @@ EntityDBusQueryConstWeakPtr FindObjectDBusQuery::getWeakPtr() const
 std::vector<IEntity::InstancePtr>
     IntrospectServiceDBusQuery::process(sdbusplus::bus::bus& connect)
 {
-    using ObjectValueTree =
-        std::map<sdbusplus::message::object_path, DBusInterfacesMap>;
     std::vector<DBusInstancePtr> dbusInstances;
-    ObjectValueTree interfacesResponse;
 
     auto mapperCall = connect.new_method_call(
         serviceName.c_str(), "/", "org.freedesktop.DBus.ObjectManager",
         "GetManagedObjects");
 
-    auto mapperResponseMsg = connect.call(mapperCall);
+    auto mapperResponseMsg = callMethod(connect, mapperCall, callCounter);
 
     if (mapperResponseMsg.is_method_error())
     {
@@ -198,21 +462,33 @@ std::vector<IEntity::InstancePtr>
         throw ObmcAppException("ERROR of mapper call");
     }
 
-    mapperResponseMsg.read(interfacesResponse);
-
-    for (auto& [objectPath, interfaces] : interfacesResponse)
+    // Decode the 'a{oa{sa{sv}}}' reply in place. Only the requested
+    // interfaces are materialized.
+    auto* rawMessage = mapperResponseMsg.get();
+    checkDecodeStatus(sd_bus_message_enter_container(
+                          rawMessage, SD_BUS_TYPE_ARRAY, "{oa{sa{sv}}}"),
+                      "enter objects");
+    while (checkDecodeStatus(sd_bus_message_enter_container(
+                                 rawMessage, SD_BUS_TYPE_DICT_ENTRY,
+                                 "oa{sa{sv}}"),
+                             "enter object") > 0)
     {
+        const char* objectPath = nullptr;
+        checkDecodeStatus(sd_bus_message_read_basic(
+                              rawMessage, SD_BUS_TYPE_OBJECT_PATH, &objectPath),
+                          "read object path");
+
         auto instance = std::make_shared<DBusInstance>(
-            serviceName, objectPath.str, getSearchPropertiesMap(),
-            getWeakPtr());
+            serviceName, objectPath, getSearchPropertiesMap(), getWeakPtr());
+        getDecoder().decodeInterfaces(mapperResponseMsg, *instance);
+        checkDecodeStatus(sd_bus_message_exit_container(rawMessage),
+                          "exit object");
 
-        for (auto& [interfaceName, propertiesMap] : interfaces)
-        {
-            instance->fillMembers(interfaceName, propertiesMap);
-        }
         this->supplementByStaticFields(instance);
         dbusInstances.push_back(instance);
     }
+    checkDecodeStatus(sd_bus_message_exit_container(rawMessage),
+                      "exit objects");
 
     LOG_DEBUG << "Process Found DBus Object query is sucess.";
 
@@ -248,8 +524,7 @@ DBusInstancePtr DBusQuery<TInstance>::createInstance(
               << "'";
     for (auto& interface : interfaces)
     {
-        auto properties = entityInstance->queryProperties(connect, interface);
-        entityInstance->fillMembers(interface, properties);
+        entityInstance->queryProperties(connect, interface);
     }
 
     this->supplementByStaticFields(entityInstance);
@@ -266,6 +541,7 @@ void DBusQuery<TInstance>::addObserver(sdbusplus::bus::match::match&& observer)
 const std::vector<DBusInstancePtr> DBusInstance::getComplexInstances() const
 {
     std::vector<DBusInstancePtr> childs;
+    std::lock_guard<std::mutex> lock(fieldsMutex);
     for (auto [_, instance] : complexInstances)
     {
         childs.push_back(instance);
@@ -277,7 +553,7 @@ void DBusInstance::fillMembers(
     const InterfaceName& interfaceName,
     const std::map<PropertyName, DbusVariantType>& properties)
 {
-    auto propertyMemberDict = getPropertyMemberDict(interfaceName);
+    auto& propertyMemberDict = getPropertyMemberDict(interfaceName);
     if (propertyMemberDict.empty())
     {
         LOG_DEBUG << "Properties of interface not provided: " << interfaceName;
@@ -291,11 +567,69 @@ void DBusInstance::fillMembers(
         {
             continue;
         }
-        auto formattedValue = dbusQuery.lock()->processFormatters(
-            propertyName, findProperty->second);
+        this->resolveFormattedProperty(propertyName, memberName,
+                                       findProperty->second);
+    }
+}
+
+void DBusInstance::fillMember(
+    const DBusPropertyDecoder::Slot& slot,
+    IEntity::IEntityMember::IInstance::FieldType&& value)
+{
+    if (slot.formatter)
+    {
+        value = slot.formatter->format(slot.property, value);
+    }
 
-        this->resolveDBusVariant(memberName, formattedValue);
+    std::lock_guard<std::mutex> lock(fieldsMutex);
+    auto findMemberIt = memberInstances.find(slot.member);
+    if (findMemberIt != memberInstances.end())
+    {
+        findMemberIt->second->setValue(value);
+        return;
+    }
+    memberInstances.emplace(
+        slot.member, std::make_shared<DBusMemberInstance>(std::move(value)));
+}
+
+void DBusInstance::resolveFormattedProperty(const PropertyName& propertyName,
+                                            const MemberName& memberName,
+                                            const DbusVariantType& value)
+{
+    auto query = dbusQuery.lock();
+    if (!query)
+    {
+        LOG_ERROR << "The query of DBus instance is expired. ObjectPath="
+                  << objectPath;
+        return;
     }
+    auto formatter = query->getFormatter(propertyName);
+    if (!formatter)
+    {
+        this->resolveDBusVariant(memberName, value);
+        return;
+    }
+
+    // Only the scalar values are subject of formatting.
+    std::visit(
+        [this, formatter, &propertyName, &memberName,
+         &value](auto&& propertyValue) {
+            using TProperty = std::decay_t<decltype(propertyValue)>;
+            if constexpr (std::is_constructible_v<DBusMemberInstance::FieldType,
+                                                  TProperty>)
+            {
+                this->supplementOrUpdate(
+                    memberName,
+                    formatter->format(
+                        propertyName,
+                        DBusMemberInstance::FieldType(propertyValue)));
+            }
+            else
+            {
+                this->resolveDBusVariant(memberName, value);
+            }
+        },
+        value);
 }
 
 const IEntity::IEntityMember::InstancePtr&
@@ -307,6 +641,8 @@ const IEntity::IEntityMember::InstancePtr&
 const IEntity::IEntityMember::InstancePtr&
     DBusInstance::getField(const MemberName& entityMemberName) const
 {
+    // The member instances are never erased, the reference stays valid
+    std::lock_guard<std::mutex> lock(fieldsMutex);
     auto findInstanceIt = memberInstances.find(entityMemberName);
     if (findInstanceIt == memberInstances.end())
     {
@@ -318,16 +654,52 @@ const IEntity::IEntityMember::InstancePtr&
     return findInstanceIt->second;
 }
 
+const IEntity::IInstance::FieldsMap& DBusInstance::getFields() const
+{
+    return memberInstances;
+}
+
+const IEntity::IInstance::FieldsValues DBusInstance::getFieldsValues() const
+{
+    FieldsValues result;
+    std::lock_guard<std::mutex> lock(fieldsMutex);
+    for (const auto& [memberName, memberInstance] : memberInstances)
+    {
+        result.emplace(memberName, memberInstance->getValue());
+    }
+    return std::forward<FieldsValues>(result);
+}
+
 bool DBusInstance::hasField(const MemberName& memberName) const
 {
+    std::lock_guard<std::mutex> lock(fieldsMutex);
     return memberInstances.find(memberName) != memberInstances.end();
 }
 
-const DBusPropertiesMap
-    DBusInstance::queryProperties(sdbusplus::bus::bus& connect,
-                                  const InterfaceName& interface)
+void DBusInstance::queryProperties(sdbusplus::bus::bus& connect,
+                                   const InterfaceName& interface)
 {
-    std::map<PropertyName, DbusVariantType> properties;
+    auto query = dbusQuery.lock();
+    if (!query)
+    {
+        LOG_ERROR << "The query of DBus instance is expired. ObjectPath="
+                  << objectPath;
+        return;
+    }
+
+    auto& decoder = query->getDecoder();
+    auto propertySlots = decoder.getSlots(interface);
+    if (!propertySlots)
+    {
+        LOG_DEBUG << "Properties of interface not requested: " << interface;
+        return;
+    }
+    objectInterfaces.insert(interface);
+    if (!query->isInterfaceDemanded(interface))
+    {
+        LOG_DEBUG << "Properties of interface not demanded: " << interface;
+        return;
+    }
 
     LOG_DEBUG << "Create DBUs 'GetAll' properties call. Service='"
               << serviceName << "', ObjectPath='" << objectPath
@@ -340,43 +712,142 @@ const DBusPropertiesMap
 
     try
     {
-        sdbusplus::message::message response = connect.call(getProperties);
-        response.read(properties);
+        sdbusplus::message::message response =
+            callMethod(connect, getProperties, callCounter);
+        decoder.decodeProperties(response, *propertySlots, *this);
 
-        LOG_DEBUG << "DBus Properties read SUCCESS. Count properties: "
-                  << properties.size();
+        LOG_DEBUG << "DBus Properties read SUCCESS.";
     }
     catch (const std::exception& e)
     {
         LOG_CRITICAL << "Failed to GetAll properties. PATH=" << objectPath
                      << ", INTF=" << interface << ", WHAT=" << e.what();
     }
+}
 
-    return std::forward<const DBusPropertiesMap>(properties);
+void DBusInstance::bindListeners(sdbusplus::bus::bus& connection,
+                                 const EntityPtr& entity)
+{
+    auto query = dbusQuery.lock();
+    if (!query)
+    {
+        return;
+    }
+
+    signalLimiter = broker::SignalThrottle::getInstance().getLimiter(serviceName);
+    for (auto& [interface, _] : targetProperties)
+    {
+        if (query->isInterfaceDemanded(interface))
+        {
+            bindListener(connection, interface, entity);
+        }
+    }
 }
 
-void DBusInstance::bindListeners(sdbusplus::bus::bus& connection, const EntityPtr& entity)
+void DBusInstance::bindListener(sdbusplus::bus::bus& connection,
+                                const InterfaceName& interface,
+                                const EntityPtr& entity)
 {
     using namespace sdbusplus::bus::match;
 
     auto self = shared_from_this();
+    match matcher(
+        connection,
+        rules::propertiesChanged(this->getObjectPath(), interface),
+        [self, entity](sdbusplus::message::message& message) {
+            // Drop to the latest: the actual values will be polled by
+            // the broker once the signals of the source are throttled.
+            if (!self->signalLimiter->tryAccept(self->signalBucket))
+            {
+                self->throttled = true;
+                return;
+            }
 
-    for (auto [interface, _] : targetProperties)
-    {
-        match matcher(
-            connection,
-            rules::propertiesChanged(this->getObjectPath(), interface),
-            [self, entity](sdbusplus::message::message& message) {
-                std::map<PropertyName, DbusVariantType> changedValues;
+            auto query = self->dbusQuery.lock();
+            if (!query)
+            {
+                return;
+            }
+
+            try
+            {
                 InterfaceName interfaceName;
-                message.read(interfaceName, changedValues);
+                message.read(interfaceName);
+
+                auto& decoder = query->getDecoder();
+                auto propertySlots = decoder.getSlots(interfaceName);
+                if (propertySlots)
+                {
+                    decoder.decodeProperties(message, *propertySlots,
+                                             *self);
+                    entity->bumpVersion(self->getHash());
+                }
+            }
+            catch (const std::exception& ex)
+            {
+                LOG_ERROR << "Can't read PropertiesChanged signal. PATH="
+                          << self->getObjectPath()
+                          << ", WHAT=" << ex.what();
+            }
+        });
+    LOG_DEBUG << "Registried watcher for Object=" << this->getObjectPath()
+              << ", Interface=" << interface;
+    listeners.insert_or_assign(interface, std::forward<match>(matcher));
+}
 
-                self->fillMembers(interfaceName, changedValues);
-            });
-        LOG_DEBUG << "Registried watcher for Object=" << this->getObjectPath()
-                  << ", Interface=" << interface;
-        listeners.push_back(std::forward<match>(matcher));
+bool DBusInstance::refreshDemand(sdbusplus::bus::bus& queryConnection,
+                                 sdbusplus::bus::bus& watcherConnection,
+                                 const EntityPtr& entity)
+{
+    auto query = dbusQuery.lock();
+    if (!query)
+    {
+        return false;
     }
+
+    bool isFetched = false;
+    for (auto& [interface, _] : targetProperties)
+    {
+        const bool isWatched = listeners.count(interface) != 0;
+        if (isWatched == query->isInterfaceDemanded(interface))
+        {
+            continue;
+        }
+        if (isWatched)
+        {
+            LOG_DEBUG << "Stop watching the not demanded interface. Object="
+                      << objectPath << ", Interface=" << interface;
+            listeners.erase(interface);
+            continue;
+        }
+
+        // The properties might be changed while the interface is not
+        // watched, hence they are fetched again.
+        LOG_DEBUG << "Resume watching the demanded interface. Object="
+                  << objectPath << ", Interface=" << interface;
+        bindListener(watcherConnection, interface, entity);
+        if (objectInterfaces.count(interface) != 0)
+        {
+            queryProperties(queryConnection, interface);
+            isFetched = true;
+        }
+    }
+    return isFetched;
+}
+
+bool DBusInstance::refreshThrottled(sdbusplus::bus::bus& connection)
+{
+    if (!throttled.exchange(false))
+    {
+        return false;
+    }
+
+    LOG_DEBUG << "Poll the throttled object: " << objectPath;
+    for (auto& [interface, _] : targetProperties)
+    {
+        this->queryProperties(connection, interface);
+    }
+    return true;
 }
 
 const ObjectPath& DBusInstance::getObjectPath() const
@@ -394,6 +865,7 @@ void DBusInstance::supplement(
     const IEntity::IEntityMember::IInstance::FieldType& value)
 {
     auto memberInstance = std::make_shared<DBusMemberInstance>(value);
+    std::lock_guard<std::mutex> lock(fieldsMutex);
     if (!memberInstances.emplace(member, std::move(memberInstance)).second)
     {
         throw std::logic_error("The requested member '" + member +
@@ -405,13 +877,15 @@ void DBusInstance::supplementOrUpdate(
     const MemberName& memberName,
     const IEntity::IEntityMember::IInstance::FieldType& value)
 {
-    if (hasField(memberName))
+    std::lock_guard<std::mutex> lock(fieldsMutex);
+    auto findMemberIt = memberInstances.find(memberName);
+    if (findMemberIt != memberInstances.end())
     {
-        getField(memberName)->setValue(value);
+        findMemberIt->second->setValue(value);
         return;
     }
-
-    supplement(memberName, value);
+    memberInstances.emplace(memberName,
+                            std::make_shared<DBusMemberInstance>(value));
 }
 
 bool DBusInstance::checkCondition(const IEntity::ConditionPtr condition) const
@@ -425,7 +899,7 @@ std::size_t DBusInstance::getHash() const
     std::size_t hashPath = std::hash<std::string>{}(objectPath);
     std::size_t hashServiceName = std::hash<std::string>{}(serviceName);
 
-    return (hashPath ^ (hashServiceName << 1));
+    return (hashPath ^ (hashServiceName << 1) ^ (valueHash << 2));
 }
 
 template <typename TProperty>
@@ -433,19 +907,32 @@ void DBusInstance::captureComplexDBusProperty(const MemberName& memberName,
                                               const TProperty& property)
 
 {
+    using TValue = typename TProperty::value_type;
+
     LOG_DEBUG << "Complex Primitive capture, member name=" << memberName;
+    std::lock_guard<std::mutex> lock(fieldsMutex);
+    // The outdated values of the property are replaced by the actual ones
+    for (auto complexIt = complexInstances.begin();
+         complexIt != complexInstances.end();)
+    {
+        if (complexIt->second->hasField(memberName))
+        {
+            complexIt = complexInstances.erase(complexIt);
+            continue;
+        }
+        ++complexIt;
+    }
+
     for (auto& value : property)
     {
-        DBusPropertiesMap properties{
-            {memberName, value},
-        };
         auto complexInstance = std::make_shared<DBusInstance>(
             serviceName, objectPath, targetProperties, dbusQuery);
-        complexInstance->fillMembers(memberName, properties);
+        complexInstance->valueHash = std::hash<TValue>{}(value);
+        complexInstance->supplement(
+            memberName, IEntity::IEntityMember::IInstance::FieldType(value));
         this->complexInstances.insert_or_assign(complexInstance->getHash(),
                                               complexInstance);
     }
-    return;
 }
 
 const IEntity::IEntityMember::InstancePtr&
@@ -467,6 +954,7 @@ void DBusInstance::captureDBusAssociations(
     LOG_DEBUG << "Complex Association values process, member name="
               << interfaceName;
 
+    std::lock_guard<std::mutex> lock(fieldsMutex);
     this->complexInstances.clear();
     // Since the complex association is a disclose of shadow one DBus Property,
     // we should clear outdated instances with the same specified interface
@@ -528,6 +1016,7 @@ void DBusInstance::resolveDBusVariant(const MemberName& memberName,
 const std::map<std::size_t, IEntity::InstancePtr>
     DBusInstance::getComplex() const
 {
+    std::lock_guard<std::mutex> lock(fieldsMutex);
     std::map<std::size_t, IEntity::InstancePtr> result(complexInstances.begin(),
                                                        complexInstances.end());
     return std::forward<std::map<std::size_t, IEntity::InstancePtr>>(result);
@@ -535,6 +1024,7 @@ const std::map<std::size_t, IEntity::InstancePtr>
 
 bool DBusInstance::isComplex() const
 {
+    std::lock_guard<std::mutex> lock(fieldsMutex);
     return complexInstances.empty();
 }
 
@@ -548,17 +1038,19 @@ void DBusInstance::initDefaultFieldsValue()
     }
 }
 
-const DBusPropertyMemberDict
+const DBusPropertyMemberDict&
     DBusInstance::getPropertyMemberDict(const InterfaceName& interface) const
 {
+    static const DBusPropertyMemberDict emptyPropertyMemberDict;
+
     auto findInterface = this->targetProperties.find(interface);
     if (findInterface == this->targetProperties.end())
     {
         LOG_DEBUG << "Interface '" << interface << "' missmatch. Skipping";
-        return DBusPropertyMemberDict();
+        return emptyPropertyMemberDict;
     }
 
-    return std::move(findInterface->second);
+    return findInterface->second;
 }
 
 const IEntity::IEntityMember::IInstance::FieldType&
@@ -593,32 +1085,68 @@ void DBusMemberInstance::setValue(const FieldType& value)
 }
 
 template <class TInstance>
-const DbusVariantType
-    DBusQuery<TInstance>::processFormatters(const PropertyName& property,
-                                            const DbusVariantType& value) const
+const DBusPropertyFormatter*
+    DBusQuery<TInstance>::getFormatter(const PropertyName& property) const
+{
+    auto findPipelineIt = formatterPipelines.find(property);
+    if (findPipelineIt == formatterPipelines.end())
+    {
+        return nullptr;
+    }
+    return &findPipelineIt->second;
+}
 
+template <class TInstance>
+void DBusQuery<TInstance>::compileDecoder()
 {
-    if (getFormatters().empty())
+    for (auto& [property, formatters] : getFormatters())
     {
-        LOG_DEBUG << "No formatters";
-        return std::move(value);
+        formatterPipelines.try_emplace(property, formatters);
     }
 
-    auto findFormattersIt = getFormatters().find(property);
-    if (getFormatters().end() == findFormattersIt)
+    for (auto& [interface, propertyMemberDict] : getSearchPropertiesMap())
     {
-        return std::move(value);
+        for (auto& [property, member] : propertyMemberDict)
+        {
+            decoder.addSlot(interface, property, member,
+                            getFormatter(property));
+        }
     }
+}
 
-    LOG_DEBUG << "Found formatter for Property=" << property;
-    DbusVariantType formattedValue(value);
+template <class TInstance>
+void DBusQuery<TInstance>::setTargetEntity(const EntityPtr& entity)
+{
+    targetEntity = entity;
+}
 
-    for (auto& formatter : findFormattersIt->second)
+template <class TInstance>
+bool DBusQuery<TInstance>::isInterfaceDemanded(
+    const InterfaceName& interface) const
+{
+    auto entity = targetEntity.lock();
+    if (!entity)
     {
-        formattedValue = std::invoke(formatter, property, formattedValue);
+        return true;
     }
+    const auto& searchProperties = getSearchPropertiesMap();
+    auto findInterfaceIt = searchProperties.find(interface);
+    if (findInterfaceIt == searchProperties.end())
+    {
+        return false;
+    }
+    return std::any_of(findInterfaceIt->second.begin(),
+                       findInterfaceIt->second.end(),
+                       [&entity](const auto& propertyMember) {
+                           return entity->isMemberDemanded(
+                               propertyMember.second);
+                       });
+}
 
-    return formattedValue;
+template <class TInstance>
+const DBusPropertyDecoder& DBusQuery<TInstance>::getDecoder() const
+{
+    return decoder;
 }
 
 template <class TInstance>
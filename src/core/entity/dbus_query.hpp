@@ -5,6 +5,8 @@
 #define __QUERY_DBUS_H__
 
 #include <core/broker/dbus_broker.hpp>
+#include <core/broker/signal_throttle.hpp>
+#include <core/connect/dbus_statistics.hpp>
 #include <core/entity/entity.hpp>
 #include <core/entity/query.hpp>
 #include <definitions.hpp>
@@ -15,6 +17,9 @@
 
 #include <functional>
 #include <map>
+#include <mutex>
+#include <set>
+#include <string_view>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -64,6 +69,99 @@ using EntityDBusQuery = DBusQuery<IEntity::InstancePtr>;
 using EntityDBusQueryConstWeakPtr = std::weak_ptr<const EntityDBusQuery>;
 using EntityDBusQueryPtr = std::shared_ptr<EntityDBusQuery>;
 
+/**
+ * @brief The formatting pipeline of a single DBus property.
+ *
+ * The pipeline is bound to the decoder slot of the property when the query is
+ * constructed, hence the properties without formatters pay nothing. The
+ * pipeline is immutable, so it is applied concurrently without locking.
+ */
+class DBusPropertyFormatter final
+{
+  public:
+    using FieldType = IEntity::IEntityMember::IInstance::FieldType;
+    using FormatterFn = const FieldType (*)(const PropertyName&,
+                                            const FieldType&);
+    using Formatters = std::vector<FormatterFn>;
+
+    DBusPropertyFormatter(const DBusPropertyFormatter&) = delete;
+    DBusPropertyFormatter& operator=(const DBusPropertyFormatter&) = delete;
+    DBusPropertyFormatter(DBusPropertyFormatter&&) = delete;
+    DBusPropertyFormatter& operator=(DBusPropertyFormatter&&) = delete;
+
+    explicit DBusPropertyFormatter(const Formatters& pipeline) :
+        formatters(pipeline)
+    {}
+    ~DBusPropertyFormatter() noexcept = default;
+
+    const FieldType format(const PropertyName&, const FieldType&) const;
+
+  private:
+    const Formatters formatters;
+};
+
+/**
+ * @brief The precompiled table to decode the DBus properties replies.
+ *
+ * The table is built once per query from the search properties map. Each one
+ * slot binds the property of an interface to the target entity member, so the
+ * reply is read straight from the sd-bus message into the instance member.
+ * The properties which nobody requested are skipped without materializing of
+ * the DbusVariantType value.
+ */
+class DBusPropertyDecoder final
+{
+  public:
+    struct Slot
+    {
+        const PropertyName property;
+        const MemberName member;
+        const DBusPropertyFormatter* formatter;
+    };
+
+    using PropertySlots = std::map<PropertyName, Slot, std::less<>>;
+    using InterfaceSlots = std::map<InterfaceName, PropertySlots, std::less<>>;
+
+    DBusPropertyDecoder(const DBusPropertyDecoder&) = delete;
+    DBusPropertyDecoder& operator=(const DBusPropertyDecoder&) = delete;
+    DBusPropertyDecoder(DBusPropertyDecoder&&) = delete;
+    DBusPropertyDecoder& operator=(DBusPropertyDecoder&&) = delete;
+
+    explicit DBusPropertyDecoder() = default;
+    ~DBusPropertyDecoder() noexcept = default;
+
+    void addSlot(const InterfaceName&, const PropertyName&, const MemberName&,
+                 const DBusPropertyFormatter*);
+
+    /**
+     * @brief Get the slots of the specified interface
+     *
+     * @return const PropertySlots* - nullptr if no one property of interface
+     *                                is requested.
+     */
+    const PropertySlots* getSlots(std::string_view) const;
+
+    /**
+     * @brief Decode the 'a{sv}' container from the current message position
+     *        into the members of the instance.
+     */
+    void decodeProperties(sdbusplus::message::message&, const PropertySlots&,
+                          DBusInstance&) const;
+
+    /**
+     * @brief Decode the 'a{sa{sv}}' container from the current message
+     *        position into the members of the instance.
+     */
+    void decodeInterfaces(sdbusplus::message::message&, DBusInstance&) const;
+
+  protected:
+    void decodeVariant(sdbusplus::message::message&, const Slot&,
+                       DBusInstance&) const;
+
+  private:
+    InterfaceSlots interfaceSlots;
+};
+
 class DBusInstance final :
     public IEntity::IInstance,
     public std::enable_shared_from_this<DBusInstance>
@@ -76,11 +174,23 @@ class DBusInstance final :
     EntityDBusQueryConstWeakPtr dbusQuery;
 
     std::map<InstanceHash, DBusInstancePtr> complexInstances;
-    std::vector<sdbusplus::bus::match::match> listeners;
+    // The hash of the value captured by the complex instance. The complex
+    // instances of the same object are distinguished by it.
+    std::size_t valueHash = 0;
+    // The listeners of the demanded interfaces only
+    std::map<InterfaceName, sdbusplus::bus::match::match> listeners;
+    // The interfaces of the object which have the requested properties
+    std::set<InterfaceName> objectInterfaces;
+
+    broker::ServiceSignalLimiterPtr signalLimiter;
+    broker::TokenBucket signalBucket;
+    // Resolved once, the registry of the counters is locked on lookup.
+    const connect::ServiceCallCounterPtr callCounter;
+    // Whether a signal has been dropped by the limits since the last poll.
+    std::atomic_bool throttled;
 
   public:
-    using MemberInstancesMap =
-        std::map<entity::MemberName, IEntity::IEntityMember::InstancePtr>;
+    using MemberInstancesMap = IEntity::IInstance::FieldsMap;
 
     DBusInstance(const DBusInstance&) = delete;
     DBusInstance& operator=(const DBusInstance&) = delete;
@@ -93,7 +203,12 @@ class DBusInstance final :
         const EntityDBusQueryConstWeakPtr& queryObject) noexcept :
         serviceName(inServiceName),
         objectPath(inObjectPath), targetProperties(targetPropertiesDict),
-        dbusQuery(queryObject)
+        dbusQuery(queryObject),
+        signalBucket(broker::SignalThrottle::objectSignalsRate,
+                     broker::SignalThrottle::objectSignalsRate),
+        callCounter(
+            connect::DBusCallStatistics::getInstance().getCounter(serviceName)),
+        throttled(false)
     {
         using namespace app::entity::obmc::definitions;
         try
@@ -114,18 +229,40 @@ class DBusInstance final :
     const std::vector<DBusInstancePtr> getComplexInstances() const;
 
     void fillMembers(const InterfaceName&, const DBusPropertiesMap&);
+    void fillMember(const DBusPropertyDecoder::Slot&,
+                    IEntity::IEntityMember::IInstance::FieldType&&);
 
     const IEntity::IEntityMember::InstancePtr&
         getField(const IEntity::EntityMemberPtr&) const override;
     const IEntity::IEntityMember::InstancePtr&
         getField(const MemberName&) const override;
+    const FieldsMap& getFields() const override;
+    const FieldsValues getFieldsValues() const override;
     bool hasField(const MemberName&) const override;
     // TODO(IK) Move to the IFormatter abstractions instead the
     // FindObjectDBusQuery weak pointer.
-    const DBusPropertiesMap queryProperties(sdbusplus::bus::bus&,
-                                            const InterfaceName&);
+    void queryProperties(sdbusplus::bus::bus&, const InterfaceName&);
 
     void bindListeners(sdbusplus::bus::bus&, const EntityPtr&);
+
+    /**
+     * @brief Follow the demand of the interfaces: stop watching the
+     *        interfaces which members nobody reads and fetch again the ones
+     *        which are demanded again.
+     *
+     * @return true - the properties of the instance have been fetched
+     */
+    bool refreshDemand(sdbusplus::bus::bus& queryConnection,
+                       sdbusplus::bus::bus& watcherConnection,
+                       const EntityPtr&);
+
+    /**
+     * @brief Poll the properties of the instance if some of its signals have
+     *        been dropped by the rate limits.
+     *
+     * @return true - the instance has been polled
+     */
+    bool refreshThrottled(sdbusplus::bus::bus&);
     const ObjectPath& getObjectPath() const;
     const ServiceName& getService() const;
 
@@ -148,6 +285,8 @@ class DBusInstance final :
                                  const DBusAssociationsType&);
 
     void resolveDBusVariant(const MemberName&, const DbusVariantType&);
+    void resolveFormattedProperty(const PropertyName&, const MemberName&,
+                                  const DbusVariantType&);
 
     const std::map<std::size_t, IEntity::InstancePtr> getComplex() const override;
     bool isComplex() const override;
@@ -156,10 +295,16 @@ class DBusInstance final :
   protected:
     virtual const IEntity::IEntityMember::InstancePtr& instanceNotFound() const;
 
-    const DBusPropertyMemberDict
+    void bindListener(sdbusplus::bus::bus&, const InterfaceName&,
+                      const EntityPtr&);
+
+    const DBusPropertyMemberDict&
         getPropertyMemberDict(const InterfaceName&) const;
 
   private:
+    // Guards the fields and the complex instances: the signals update them
+    // while the readers copy them, e.g. the snapshot saving.
+    mutable std::mutex fieldsMutex;
     MemberInstancesMap memberInstances;
 };
 
@@ -202,8 +347,34 @@ class DBusQuery : public IQuery<TInstance, sdbusplus::bus::bus>
     explicit DBusQuery() noexcept = default;
     ~DBusQuery() noexcept override = default;
 
-    const DbusVariantType processFormatters(const PropertyName&,
-                                            const DbusVariantType&) const;
+    /**
+     * @brief Get the formatting pipeline of the property
+     *
+     * @return const DBusPropertyFormatter* - nullptr if the property has no
+     *                                        formatters
+     */
+    const DBusPropertyFormatter* getFormatter(const PropertyName&) const;
+
+    /**
+     * @brief Precompile the decoding table of the DBus properties replies and
+     *        bind the formatting pipelines to its slots. Should be called
+     *        once, right after the query is constructed.
+     */
+    void compileDecoder();
+    const DBusPropertyDecoder& getDecoder() const;
+
+    /**
+     * @brief Bind the entity populated by the query. The interfaces are
+     *        fetched and watched only while the bound members of them are
+     *        read by the recent GraphQL queries.
+     */
+    void setTargetEntity(const EntityPtr&);
+
+    /**
+     * @brief Whether any member bound to the properties of the interface is
+     *        read by the recent queries.
+     */
+    bool isInterfaceDemanded(const InterfaceName&) const;
 
     virtual const DefaultFieldsValueDict& getDefaultFieldsValue() const
     {
@@ -215,10 +386,10 @@ class DBusQuery : public IQuery<TInstance, sdbusplus::bus::bus>
     virtual void registerObjectRemovingObserver(sdbusplus::bus::bus&) = 0;
 
   protected:
-    using FormatterFn = std::function<const DbusVariantType(
-        const PropertyName&, const DbusVariantType&)>;
+    using FieldType = IEntity::IEntityMember::IInstance::FieldType;
+    using FormatterFn = DBusPropertyFormatter::FormatterFn;
     using FieldsFormattingMap =
-        std::map<PropertyName, std::vector<FormatterFn>>;
+        std::map<PropertyName, DBusPropertyFormatter::Formatters>;
 
     virtual const FieldsFormattingMap& getFormatters() const;
     virtual const DBusPropertyEndpointMap& getSearchPropertiesMap() const = 0;
@@ -234,6 +405,11 @@ class DBusQuery : public IQuery<TInstance, sdbusplus::bus::bus>
                                            const std::vector<InterfaceName>&);
 
     void addObserver(sdbusplus::bus::match::match&&);
+
+  private:
+    DBusPropertyDecoder decoder;
+    std::map<PropertyName, DBusPropertyFormatter> formatterPipelines;
+    EntityWeak targetEntity;
 };
 
 class DBusQueryBuilder final
@@ -260,6 +436,8 @@ class DBusQueryBuilder final
             std::is_base_of_v<EntityDBusQuery, TDBusQuery>,
             "This is not a query");
         auto dbusQuery = std::make_shared<TDBusQuery>();
+        dbusQuery->compileDecoder();
+        dbusQuery->setTargetEntity(entity);
         auto broker = std::make_shared<app::broker::EntityDbusBroker>(
             entity, dbusQuery, args...);
         manager.bind(std::move(broker));
@@ -310,12 +488,15 @@ class IntrospectServiceDBusQuery :
     public std::enable_shared_from_this<IntrospectServiceDBusQuery>
 {
     const std::string serviceName;
+    const connect::ServiceCallCounterPtr callCounter;
 
   public:
     explicit IntrospectServiceDBusQuery(
         const ServiceName& serviceNameInput) noexcept :
         DBusQuery(),
-        serviceName(serviceNameInput)
+        serviceName(serviceNameInput),
+        callCounter(
+            connect::DBusCallStatistics::getInstance().getCounter(serviceName))
     {}
     ~IntrospectServiceDBusQuery() noexcept override = default;
 
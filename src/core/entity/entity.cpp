@@ -1,9 +1,13 @@
 // SPDX-License-Identifier: Apache-2.0
 // Copyright (C) 2021 YADRO
 
+#include <config.h>
+
 #include <core/application.hpp>
 #include <core/entity/entity.hpp>
 
+#include <algorithm>
+
 namespace app
 {
 namespace entity
@@ -22,6 +26,26 @@ const IEntity::IEntityMember::InstancePtr&
     return this->instance;
 }
 
+void Entity::EntityMember::markDemanded()
+{
+    lastDemanded = std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+bool Entity::EntityMember::isDemanded() const
+{
+    // The zero window disables the projection pushdown: each member is
+    // fetched regardless of the queries.
+    static constexpr std::chrono::seconds demandWindow(
+        BMC_PROJECTION_DEMAND_WINDOW_SEC);
+    if (demandWindow == std::chrono::seconds::zero())
+    {
+        return true;
+    }
+    const std::chrono::steady_clock::time_point demandedAt(
+        std::chrono::steady_clock::duration(lastDemanded.load()));
+    return std::chrono::steady_clock::now() - demandedAt < demandWindow;
+}
+
 void Entity::Relation::addConditionBuildRules(const RelationRulesList& rules)
 {
     conditionBuildRules.insert(conditionBuildRules.end(), rules.begin(),
@@ -49,6 +73,33 @@ const std::vector<IEntity::ConditionPtr>
     return std::forward<const std::vector<IEntity::ConditionPtr>>(conditions);
 }
 
+bool Entity::Relation::isRelated(const InstancePtr& source,
+                                 const InstancePtr& destination) const
+{
+    for (const auto& [memberSource, memberDest, compare] : conditionBuildRules)
+    {
+        if (!std::invoke(compare, destination->getField(memberDest),
+                         source->getField(memberSource)->getValue()))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Entity::Relation::markDemanded() const
+{
+    auto sourceEntity = source.lock();
+    for (const auto& [memberSource, memberDest, _] : conditionBuildRules)
+    {
+        if (sourceEntity)
+        {
+            sourceEntity->getMember(memberSource)->markDemanded();
+        }
+        destination->getMember(memberDest)->markDemanded();
+    }
+}
+
 IEntity::IRelation::LinkWay Entity::Relation::getLinkWay() const
 {
     // TODO(IK) should we remove the LinkWay abstraction?
@@ -72,16 +123,16 @@ bool Entity::Condition::check(const IEntity::IInstance& sourceInstance) const
 bool Entity::Condition::fieldValueCompare(
     const IEntity::IInstance& sourceInstance) const
 {
-    bool result = true;
     for (auto& [ruleMeta, compareCallback] : rules)
     {
-        MemberName memberName;
-        IEntityMember::IInstance::FieldType rightValue;
+        const auto& [memberName, rightValue] = ruleMeta;
         auto memberInstance = sourceInstance.getField(memberName);
-        std::tie(memberName, rightValue) = ruleMeta;
-        result &= std::invoke(compareCallback, memberInstance, rightValue);
+        if (!std::invoke(compareCallback, memberInstance, rightValue))
+        {
+            return false;
+        }
     }
-    return result;
+    return true;
 }
 
 bool Entity::addMember(const EntityMemberPtr& member)
@@ -120,8 +171,16 @@ const IEntity::EntityMemberPtr
     return it->second;
 }
 
+bool Entity::isMemberDemanded(const MemberName& memberName) const
+{
+    auto findMemberIt = this->members.find(memberName);
+    return findMemberIt == this->members.end() ||
+           findMemberIt->second->isDemanded();
+}
+
 const IEntity::InstancePtr Entity::getInstance(std::size_t hash) const
 {
+    std::lock_guard<std::mutex> lock(instancesMutex);
     auto findInstanceIt = this->instances.find(hash);
     if (findInstanceIt == instances.end())
     {
@@ -134,8 +193,63 @@ const IEntity::InstancePtr Entity::getInstance(std::size_t hash) const
 const std::vector<IEntity::InstancePtr>
     Entity::getInstances(const ConditionPtr condition) const
 {
+    std::map<InstanceHash, InstancePtr> actualInstances;
+    {
+        std::lock_guard<std::mutex> lock(instancesMutex);
+        actualInstances = instances;
+    }
+    return expandInstances(actualInstances, condition);
+}
+
+const std::vector<IEntity::InstancePtr>
+    Entity::getInstances(const ConditionPtr condition,
+                         const std::set<std::size_t>& storedHashes) const
+{
+    std::map<InstanceHash, InstancePtr> actualInstances;
+    {
+        std::lock_guard<std::mutex> lock(instancesMutex);
+        for (auto instanceHash : storedHashes)
+        {
+            auto findInstanceIt = instances.find(instanceHash);
+            if (findInstanceIt != instances.end())
+            {
+                actualInstances.insert(*findInstanceIt);
+            }
+        }
+    }
+    return expandInstances(actualInstances, condition);
+}
+
+const std::vector<IEntity::InstancePtr> Entity::expandInstances(
+    const std::map<InstanceHash, InstancePtr>& actualInstances,
+    const ConditionPtr condition) const
+{
+    // The provider which supplies only the members nobody reads is not
+    // resolved. Otherwise, the members of the provider are read by the link
+    // rule, hence they are demanded too.
+    std::vector<const ProviderLink*> demandedProviders;
+    for (auto& providerLink : this->providers)
+    {
+        const bool isDemanded =
+            providerLink.suppliedMembers.empty() ||
+            std::any_of(providerLink.suppliedMembers.begin(),
+                        providerLink.suppliedMembers.end(),
+                        [this](const auto& memberName) {
+                            return isMemberDemanded(memberName);
+                        });
+        if (!isDemanded)
+        {
+            continue;
+        }
+        for (auto& [_, member] : providerLink.provider->getMembers())
+        {
+            member->markDemanded();
+        }
+        demandedProviders.push_back(&providerLink);
+    }
+
     std::vector<IEntity::InstancePtr> result;
-    for (auto [_, instanceObject] : instances)
+    for (auto [_, instanceObject] : actualInstances)
     {
         instanceObject->initDefaultFieldsValue();
 
@@ -144,9 +258,10 @@ const std::vector<IEntity::InstancePtr>
                                           instanceObject);
         for (auto [_, instance] : complexInstances)
         {
-            for (auto& provider : this->providers)
+            for (auto& providerLink : demandedProviders)
             {
-                provider.first->supplementInstance(instance, provider.second);
+                providerLink->provider->supplementInstance(
+                    instance, providerLink->linkRule);
             }
             if (!condition || instance->checkCondition(condition))
             {
@@ -159,25 +274,128 @@ const std::vector<IEntity::InstancePtr>
 
 void Entity::setInstances(std::vector<InstancePtr> instancesList)
 {
-    instances.clear();
+    std::map<InstanceHash, InstancePtr> actualInstances;
     for (auto& inputInstance : instancesList)
     {
-        this->instances.insert_or_assign(inputInstance->getHash(),
+        actualInstances.insert_or_assign(inputInstance->getHash(),
                                          inputInstance);
     }
+
+    std::lock_guard<std::mutex> lock(instancesMutex);
+    this->instances.swap(actualInstances);
+    this->bumpVersion();
+}
+
+const std::vector<IEntity::InstancePtr> Entity::getStoredInstances() const
+{
+    std::map<InstanceHash, InstancePtr> actualInstances;
+    {
+        std::lock_guard<std::mutex> lock(instancesMutex);
+        actualInstances = instances;
+    }
+
+    std::vector<IEntity::InstancePtr> result;
+    result.reserve(actualInstances.size());
+    for (auto& [_, instanceObject] : actualInstances)
+    {
+        auto complexInstances = instanceObject->getComplex();
+        complexInstances.insert_or_assign(instanceObject->getHash(),
+                                          instanceObject);
+        for (auto& [_, instance] : complexInstances)
+        {
+            result.push_back(instance);
+        }
+    }
+    return result;
+}
+
+std::size_t Entity::getInstancesCount() const
+{
+    std::lock_guard<std::mutex> lock(instancesMutex);
+    return instances.size();
+}
+
+uint64_t Entity::getVersion() const
+{
+    // Each version only grows, hence the sum grows on any change of the
+    // entity itself or of the supplement providers.
+    uint64_t result = version;
+    for (auto& providerLink : this->providers)
+    {
+        result += providerLink.provider->getVersion();
+    }
+    return result;
+}
+
+uint64_t Entity::getStructureVersion() const
+{
+    uint64_t result = structureVersion;
+    for (auto& providerLink : this->providers)
+    {
+        result += providerLink.provider->getVersion();
+    }
+    return result;
+}
+
+void Entity::bumpVersion()
+{
+    structureVersion++;
+    version++;
+    EntityChangeNotifier::getInstance().notify();
+}
+
+void Entity::bumpVersion(std::size_t instanceHash)
+{
+    {
+        // The change is logged before the version is increased: the reader
+        // which has seen the new version finds the change in the log.
+        std::lock_guard<std::mutex> lock(changesMutex);
+        changes.emplace_back(++changesPosition, instanceHash);
+        if (changes.size() > maxChangesLog)
+        {
+            changes.pop_front();
+        }
+    }
+    version++;
+    EntityChangeNotifier::getInstance().notify();
+}
+
+const std::optional<std::set<std::size_t>>
+    Entity::getChangedInstances(uint64_t& position) const
+{
+    std::lock_guard<std::mutex> lock(changesMutex);
+    const auto seenPosition = position;
+    position = changesPosition;
+    if (seenPosition == changesPosition)
+    {
+        return std::set<std::size_t>();
+    }
+    if (changes.empty() || changes.front().first > seenPosition + 1)
+    {
+        return std::nullopt;
+    }
+
+    std::set<std::size_t> result;
+    for (auto it = changes.rbegin();
+         it != changes.rend() && it->first > seenPosition; ++it)
+    {
+        result.insert(it->second);
+    }
+    return result;
 }
 
 void Entity::linkSupplementProvider(
     const EntitySupplementProviderPtr& provider,
-    ISupplementProvider::ProviderLinkRule linkRule)
+    ISupplementProvider::ProviderLinkRule linkRule,
+    const std::vector<MemberName>& suppliedMembers)
 {
     LOG_DEBUG << "Link provider: " << provider->getName();
-    providers.push_back(std::make_pair(provider, linkRule));
+    providers.push_back(ProviderLink{provider, linkRule, suppliedMembers});
 }
 
 void Entity::addRelation(const RelationPtr relation)
 {
-    if (relation)
+    if (!relation)
     {
         LOG_ERROR << "Attempt to register nullptr_t of the relation object.";
         return;
@@ -216,7 +434,8 @@ EntityManager::EntityBuilder& EntityManager::EntityBuilder::addMembers(
 EntityManager::EntityBuilder&
     EntityManager::EntityBuilder::linkSupplementProvider(
         const std::string& providerName,
-        IEntity::ISupplementProvider::ProviderLinkRule linkRule)
+        IEntity::ISupplementProvider::ProviderLinkRule linkRule,
+        const std::vector<MemberName>& suppliedMembers)
 {
     auto findProviderIt = providers.find(providerName);
     if (findProviderIt == providers.end())
@@ -225,7 +444,8 @@ EntityManager::EntityBuilder&
             "Requested provider is not registered: " + providerName);
     }
 
-    this->entity->linkSupplementProvider(findProviderIt->second, linkRule);
+    this->entity->linkSupplementProvider(findProviderIt->second, linkRule,
+                                         suppliedMembers);
     return *this;
 }
 
@@ -9,10 +9,17 @@
 
 #include <definitions.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <set>
 #include <string>
 #include <variant>
 #include <vector>
@@ -118,12 +125,28 @@ class IEntity
         virtual const std::string getName() const noexcept = 0;
         virtual const InstancePtr& getInstance() const = 0;
 
+        /**
+         * @brief Mark the member as read by a query. The members which are
+         *        not read by the recent queries are not fetched by the
+         *        brokers.
+         */
+        virtual void markDemanded() = 0;
+        /**
+         * @brief Whether the member is read by the recent queries
+         */
+        virtual bool isDemanded() const = 0;
+
         virtual ~IEntityMember() noexcept = default;
     };
 
     class IInstance
     {
       public:
+        using FieldsMap =
+            std::map<MemberName, IEntityMember::InstancePtr>;
+        using FieldsValues =
+            std::map<MemberName, IEntityMember::IInstance::FieldType>;
+
         virtual ~IInstance() noexcept = default;
         /**
          * @brief Get the Field of Entity Instance
@@ -140,6 +163,24 @@ class IEntity
         virtual const IEntity::IEntityMember::InstancePtr&
             getField(const MemberName& entityMemberName) const = 0;
 
+        /**
+         * @brief Get all Fields of Entity Instance
+         *
+         * @return const FieldsMap& The Field Instances by the Entity Member
+         * names
+         */
+        virtual const FieldsMap& getFields() const = 0;
+
+        /**
+         * @brief Copy the values of all Fields of Entity Instance. Unlike the
+         *        'getFields' the copy is consistent while the instance is
+         *        updated by the broker.
+         *
+         * @return const FieldsValues The Field values by the Entity Member
+         * names
+         */
+        virtual const FieldsValues getFieldsValues() const = 0;
+
         virtual void supplement(const MemberName&,
                                 const IEntityMember::IInstance::FieldType&) = 0;
         virtual void supplementOrUpdate(const MemberName&,
@@ -206,6 +247,18 @@ class IEntity
 
         virtual const EntityPtr& getDestinationTarget() const = 0;
         virtual const std::vector<ConditionPtr> getConditions() const = 0;
+        /**
+         * @brief Check whether the instance of the destination entity is
+         *        related to the instance of the source entity: each rule
+         *        compares the destination member against the source one.
+         */
+        virtual bool isRelated(const InstancePtr& source,
+                               const InstancePtr& destination) const = 0;
+        /**
+         * @brief Mark the members compared by the relation as demanded, so
+         *        the brokers and the supplement providers keep them filled.
+         */
+        virtual void markDemanded() const = 0;
 
         virtual LinkWay getLinkWay() const = 0;
     };
@@ -218,15 +271,85 @@ class IEntity
         getMember(const std::string& memberName) const = 0;
 
     virtual const MemberMap& getMembers() const = 0;
+    /**
+     * @brief Whether the member is read by the recent queries. The unknown
+     *        member is considered as demanded.
+     */
+    virtual bool isMemberDemanded(const MemberName&) const = 0;
 
     virtual const InstancePtr getInstance(std::size_t) const = 0;
     virtual const std::vector<InstancePtr>
         getInstances(const ConditionPtr = ConditionPtr()) const = 0;
+    /**
+     * @brief Get the instances like getInstances() does, but only the ones
+     *        which are expanded from the stored instances of the given hashes.
+     */
+    virtual const std::vector<InstancePtr>
+        getInstances(const ConditionPtr,
+                     const std::set<std::size_t>& storedHashes) const = 0;
     virtual void setInstances(std::vector<InstancePtr>) = 0;
+    /**
+     * @brief Get the stored instances as is: neither the default values nor
+     *        the supplement providers are applied. The complex instances are
+     *        expanded.
+     */
+    virtual const std::vector<InstancePtr> getStoredInstances() const = 0;
+    /**
+     * @brief Get the count of the stored instances without retrieving them.
+     *        The complex instances are counted as a single one.
+     */
+    virtual std::size_t getInstancesCount() const = 0;
 
-    virtual void
-        linkSupplementProvider(const EntitySupplementProviderPtr&,
-                               ISupplementProvider::ProviderLinkRule) = 0;
+    /**
+     * @brief Get the version of the entity data. The version is increased
+     *        each time the instances of the entity or the instances of the
+     *        linked supplement providers are changed.
+     */
+    virtual uint64_t getVersion() const = 0;
+    /**
+     * @brief Get the version of the entity data which is not increased by
+     *        the instances changed in place, see bumpVersion(std::size_t).
+     *        The versions of the supplement providers are included as is.
+     */
+    virtual uint64_t getStructureVersion() const = 0;
+    /**
+     * @brief Increase the version of the entity data. Should be called once
+     *        the instances are changed and which of them is unknown.
+     */
+    virtual void bumpVersion() = 0;
+    /**
+     * @brief Increase the version of the entity data and record the stored
+     *        instance to the log of the changes. Should be called once the
+     *        fields of the single instance are changed in place.
+     *
+     * @param instanceHash - the hash of the changed stored instance
+     */
+    virtual void bumpVersion(std::size_t instanceHash) = 0;
+    /**
+     * @brief Get the stored instances changed in place since the position
+     *        of the log of the changes.
+     *
+     * @param position[in,out] - the position of the log seen by the caller,
+     *                           it is moved to the current one
+     * @return std::optional<std::set<std::size_t>> - the hashes of the
+     *         changed instances, or std::nullopt if the log has not kept the
+     *         changes since the position
+     */
+    virtual const std::optional<std::set<std::size_t>>
+        getChangedInstances(uint64_t& position) const = 0;
+
+    /**
+     * @brief Link the supplement provider to the entity.
+     *
+     * @param suppliedMembers - the members written by the link rule. The
+     *                          provider is not applied unless any of them is
+     *                          demanded. The empty list means the provider is
+     *                          always applied.
+     */
+    virtual void linkSupplementProvider(
+        const EntitySupplementProviderPtr&,
+        ISupplementProvider::ProviderLinkRule,
+        const std::vector<MemberName>& suppliedMembers = {}) = 0;
 
     virtual void addRelation(const RelationPtr) = 0;
     virtual const std::vector<RelationPtr>& getRelations() const = 0;
@@ -236,21 +359,42 @@ class IEntity
 
 class Entity : public IEntity
 {
-    using ProviderRulesDict =
-        std::vector<std::pair<const EntitySupplementProviderPtr,
-                              ISupplementProvider::ProviderLinkRule>>;
+    struct ProviderLink
+    {
+        const EntitySupplementProviderPtr provider;
+        ISupplementProvider::ProviderLinkRule linkRule;
+        std::vector<MemberName> suppliedMembers;
+    };
+    using ProviderRulesDict = std::vector<ProviderLink>;
     using InstanceHash = std::size_t;
     MemberMap members;
     const EntityName name;
+    mutable std::mutex instancesMutex;
     std::map<InstanceHash, InstancePtr> instances;
     ProviderRulesDict providers;
     std::vector<RelationPtr> relations;
+    std::atomic_uint64_t version;
+    std::atomic_uint64_t structureVersion;
+    // The log of the instances changed in place: the position of the change
+    // and the hash of the instance.
+    mutable std::mutex changesMutex;
+    uint64_t changesPosition;
+    std::deque<std::pair<uint64_t, InstanceHash>> changes;
+
+    const std::vector<InstancePtr>
+        expandInstances(const std::map<InstanceHash, InstancePtr>&,
+                        const ConditionPtr) const;
 
   public:
+    // The changes of the instances kept by the log
+    static constexpr std::size_t maxChangesLog = 1024;
+
     class EntityMember : public IEntityMember
     {
         const MemberName name;
         InstancePtr instance;
+        // The steady clock ticks of the latest read by a query
+        std::atomic<std::chrono::steady_clock::rep> lastDemanded;
 
       public:
         static constexpr const char* fieldValueNotAvailable = "N/A";
@@ -297,7 +441,9 @@ class Entity : public IEntity
 
         explicit EntityMember(const std::string& memberName) noexcept :
             name(memberName), instance(std::make_shared<StaticInstance>(
-                                  std::string(fieldValueNotAvailable)))
+                                  std::string(fieldValueNotAvailable))),
+            lastDemanded(
+                std::chrono::steady_clock::now().time_since_epoch().count())
         {}
 
         explicit EntityMember() = delete;
@@ -311,6 +457,9 @@ class Entity : public IEntity
         const MemberName getName() const noexcept override;
 
         const InstancePtr& getInstance() const override;
+
+        void markDemanded() override;
+        bool isDemanded() const override;
     };
 
     class Condition : public ICondition
@@ -359,6 +508,9 @@ class Entity : public IEntity
 
         const EntityPtr& getDestinationTarget() const override;
         const std::vector<ConditionPtr> getConditions() const override;
+        bool isRelated(const InstancePtr& source,
+                       const InstancePtr& destination) const override;
+        void markDemanded() const override;
         LinkWay getLinkWay() const override;
     };
 
@@ -369,7 +521,9 @@ class Entity : public IEntity
     Entity(Entity&&) = delete;
     Entity& operator=(Entity&&) = delete;
 
-    explicit Entity(const std::string& objectName) noexcept : name(objectName)
+    explicit Entity(const std::string& objectName) noexcept :
+        name(objectName), version(0), structureVersion(0),
+        changesPosition(0)
     {
     }
 
@@ -385,13 +539,28 @@ class Entity : public IEntity
     {
         return this->members;
     }
+    bool isMemberDemanded(const MemberName&) const override;
     const InstancePtr getInstance(std::size_t) const override;
     const std::vector<InstancePtr>
         getInstances(const ConditionPtr = ConditionPtr()) const override;
+    const std::vector<InstancePtr>
+        getInstances(const ConditionPtr,
+                     const std::set<std::size_t>& storedHashes) const override;
     void setInstances(std::vector<InstancePtr>) override;
+    const std::vector<InstancePtr> getStoredInstances() const override;
+    std::size_t getInstancesCount() const override;
+
+    uint64_t getVersion() const override;
+    uint64_t getStructureVersion() const override;
+    void bumpVersion() override;
+    void bumpVersion(std::size_t instanceHash) override;
+    const std::optional<std::set<std::size_t>>
+        getChangedInstances(uint64_t& position) const override;
 
-    void linkSupplementProvider(const EntitySupplementProviderPtr&,
-                                ISupplementProvider::ProviderLinkRule) override;
+    void linkSupplementProvider(
+        const EntitySupplementProviderPtr&,
+        ISupplementProvider::ProviderLinkRule,
+        const std::vector<MemberName>& suppliedMembers = {}) override;
 
     void addRelation(const RelationPtr) override;
     const std::vector<RelationPtr>& getRelations() const override;
@@ -412,6 +581,67 @@ class EntitySupplementProvider :
                             ProviderLinkRule) override;
 };
 
+/**
+ * @brief The notification of the entities data changes. The waiters are woken
+ *        up once the version of any entity is increased.
+ */
+class EntityChangeNotifier final
+{
+    std::mutex changeMutex;
+    std::condition_variable changeCondition;
+    uint64_t generation;
+
+    EntityChangeNotifier() : generation(0)
+    {}
+
+  public:
+    EntityChangeNotifier(const EntityChangeNotifier&) = delete;
+    EntityChangeNotifier& operator=(const EntityChangeNotifier&) = delete;
+    EntityChangeNotifier(EntityChangeNotifier&&) = delete;
+    EntityChangeNotifier& operator=(EntityChangeNotifier&&) = delete;
+    ~EntityChangeNotifier() noexcept = default;
+
+    static EntityChangeNotifier& getInstance()
+    {
+        static EntityChangeNotifier changeNotifier;
+        return changeNotifier;
+    }
+
+    void notify()
+    {
+        {
+            std::lock_guard<std::mutex> lock(changeMutex);
+            generation++;
+        }
+        changeCondition.notify_all();
+    }
+
+    uint64_t getGeneration()
+    {
+        std::lock_guard<std::mutex> lock(changeMutex);
+        return generation;
+    }
+
+    /**
+     * @brief Wait for the entities changes after the seen generation.
+     *
+     * @param seenGeneration - the generation observed by the caller, updated
+     *                         to the actual one
+     * @param timeout        - the maximum time to wait
+     * @return true - the entities have been changed
+     */
+    bool waitChanges(uint64_t& seenGeneration,
+                     std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(changeMutex);
+        const bool isChanged = changeCondition.wait_for(
+            lock, timeout,
+            [this, seenGeneration] { return generation != seenGeneration; });
+        seenGeneration = generation;
+        return isChanged;
+    }
+};
+
 class EntityManager final
 {
     using EntityMap = std::map<const std::string, EntityPtr>;
@@ -464,7 +694,8 @@ class EntityManager final
 
         EntityBuilder& linkSupplementProvider(
             const std::string& providerName,
-            IEntity::ISupplementProvider::ProviderLinkRule);
+            IEntity::ISupplementProvider::ProviderLinkRule,
+            const std::vector<MemberName>& suppliedMembers = {});
 
         EntityBuilder& addRelations(const std::string&,
                                     const IEntity::IRelation::RelationRulesList&);
@@ -486,6 +717,16 @@ class EntityManager final
      */
     const EntityPtr getEntity(const EntityName& entityName) const;
 
+    const EntityMap& getEntities() const
+    {
+        return entityDictionary;
+    }
+
+    const SupplementProviderDict& getSupplementProviders() const
+    {
+        return supplementProviders;
+    }
+
   protected:
     EntityMap entityDictionary;
     SupplementProviderDict supplementProviders;
@@ -0,0 +1,616 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#include <core/entity/snapshot.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+namespace app
+{
+namespace entity
+{
+
+using namespace exceptions;
+
+namespace
+{
+
+using FieldType = IEntity::IEntityMember::IInstance::FieldType;
+
+class SnapshotWriter final
+{
+    std::string buffer;
+
+  public:
+    template <typename TValue>
+    void write(const TValue& value)
+    {
+        if constexpr (std::is_same_v<TValue, std::string>)
+        {
+            write(static_cast<uint32_t>(value.size()));
+            buffer.append(value);
+        }
+        else if constexpr (std::is_same_v<TValue, bool>)
+        {
+            write(static_cast<uint8_t>(value));
+        }
+        else
+        {
+            static_assert(std::is_arithmetic_v<TValue>,
+                          "Unexpected type of the snapshot value");
+            buffer.append(reinterpret_cast<const char*>(&value),
+                          sizeof(TValue));
+        }
+    }
+
+    void writeField(const FieldType& value)
+    {
+        write(static_cast<uint8_t>(value.index()));
+        std::visit([this](auto&& fieldValue) { write(fieldValue); }, value);
+    }
+
+    void writeMagic(std::string_view magic)
+    {
+        buffer.append(magic);
+    }
+
+    const std::string& getBuffer() const
+    {
+        return buffer;
+    }
+};
+
+class SnapshotReader final
+{
+    const char* data;
+    const size_t size;
+    size_t offset;
+
+  public:
+    explicit SnapshotReader(const char* buffer, size_t bufferSize) :
+        data(buffer), size(bufferSize), offset(0)
+    {}
+
+    template <typename TValue>
+    TValue read()
+    {
+        if constexpr (std::is_same_v<TValue, std::string>)
+        {
+            auto length = read<uint32_t>();
+            return std::string(take(length), length);
+        }
+        else if constexpr (std::is_same_v<TValue, bool>)
+        {
+            return read<uint8_t>() != 0;
+        }
+        else
+        {
+            static_assert(std::is_arithmetic_v<TValue>,
+                          "Unexpected type of the snapshot value");
+            TValue value;
+            std::memcpy(&value, take(sizeof(TValue)), sizeof(TValue));
+            return value;
+        }
+    }
+
+    template <std::size_t Index = 0>
+    FieldType readField(std::size_t typeIndex)
+    {
+        if constexpr (Index < std::variant_size_v<FieldType>)
+        {
+            if (typeIndex == Index)
+            {
+                using TField = std::variant_alternative_t<Index, FieldType>;
+                return FieldType(std::in_place_index<Index>, read<TField>());
+            }
+            return readField<Index + 1>(typeIndex);
+        }
+        else
+        {
+            throw SnapshotException("unknown field type #" +
+                                    std::to_string(typeIndex));
+        }
+    }
+
+    FieldType readField()
+    {
+        return readField(read<uint8_t>());
+    }
+
+    bool checkMagic(std::string_view magic)
+    {
+        return std::string_view(take(magic.size()), magic.size()) == magic;
+    }
+
+    bool isEnd() const
+    {
+        return offset == size;
+    }
+
+  protected:
+    const char* take(size_t length)
+    {
+        if (length > size - offset)
+        {
+            throw SnapshotException("unexpected end of file");
+        }
+        auto chunk = data + offset;
+        offset += length;
+        return chunk;
+    }
+};
+
+/**
+ * @brief Read-only memory mapping of the whole snapshot file.
+ */
+class MappedFile final
+{
+    int descriptor;
+    void* data;
+    size_t size;
+
+  public:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+
+    explicit MappedFile(const std::string& path) :
+        descriptor(open(path.c_str(), O_RDONLY | O_CLOEXEC)), data(MAP_FAILED),
+        size(0)
+    {
+        if (descriptor < 0)
+        {
+            throw SnapshotException("can't open " + path + ": " +
+                                    strerror(errno));
+        }
+
+        struct stat fileStat;
+        if (fstat(descriptor, &fileStat) < 0 || fileStat.st_size <= 0)
+        {
+            close(descriptor);
+            throw SnapshotException("empty or unavailable file " + path);
+        }
+
+        size = static_cast<size_t>(fileStat.st_size);
+        data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (data == MAP_FAILED)
+        {
+            close(descriptor);
+            throw SnapshotException("can't map " + path + ": " +
+                                    strerror(errno));
+        }
+    }
+
+    ~MappedFile() noexcept
+    {
+        munmap(data, size);
+        close(descriptor);
+    }
+
+    SnapshotReader getReader() const
+    {
+        return SnapshotReader(static_cast<const char*>(data), size);
+    }
+};
+
+/**
+ * @brief Write the whole buffer to the new file and flush it to the storage,
+ *        so the file is complete before it replaces the previous snapshot.
+ */
+void writeSynced(const std::string& path, const std::string& buffer)
+{
+    int descriptor =
+        open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (descriptor < 0)
+    {
+        throw SnapshotException("can't open " + path + ": " +
+                                strerror(errno));
+    }
+
+    size_t written = 0;
+    while (written < buffer.size())
+    {
+        auto result = ::write(descriptor, buffer.data() + written,
+                              buffer.size() - written);
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result < 0)
+        {
+            const std::string reason(strerror(errno));
+            close(descriptor);
+            throw SnapshotException("can't write " + path + ": " + reason);
+        }
+        written += static_cast<size_t>(result);
+    }
+
+    if (fsync(descriptor) < 0)
+    {
+        const std::string reason(strerror(errno));
+        close(descriptor);
+        throw SnapshotException("can't sync " + path + ": " + reason);
+    }
+    if (close(descriptor) < 0)
+    {
+        throw SnapshotException("can't close " + path + ": " +
+                                strerror(errno));
+    }
+}
+
+/**
+ * @brief Flush the directory entries to the storage, so the renamed file
+ *        survives the power loss.
+ */
+void syncDirectory(const std::string& path)
+{
+    int descriptor = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (descriptor < 0)
+    {
+        throw SnapshotException("can't open the directory " + path + ": " +
+                                strerror(errno));
+    }
+    const bool isSynced = fsync(descriptor) == 0;
+    const std::string reason(isSynced ? "" : strerror(errno));
+    close(descriptor);
+    if (!isSynced)
+    {
+        throw SnapshotException("can't sync the directory " + path + ": " +
+                                reason);
+    }
+}
+
+inline void fnvHash(uint64_t& hash, std::string_view value)
+{
+    constexpr uint64_t fnvPrime = 0x100000001b3ULL;
+    for (auto symbol : value)
+    {
+        hash ^= static_cast<uint8_t>(symbol);
+        hash *= fnvPrime;
+    }
+    // separate the adjacent values
+    hash ^= 0xff;
+    hash *= fnvPrime;
+}
+
+} // namespace
+
+const IEntity::IEntityMember::InstancePtr&
+    SnapshotInstance::getField(const IEntity::EntityMemberPtr& member) const
+{
+    return getField(member->getName());
+}
+
+const IEntity::IEntityMember::InstancePtr&
+    SnapshotInstance::getField(const MemberName& memberName) const
+{
+    static IEntity::IEntityMember::InstancePtr notAvailable =
+        std::make_shared<Entity::EntityMember::StaticInstance>(
+            std::string(Entity::EntityMember::fieldValueNotAvailable));
+
+    auto findFieldIt = fields.find(memberName);
+    if (findFieldIt == fields.end())
+    {
+        return notAvailable;
+    }
+    return findFieldIt->second;
+}
+
+const IEntity::IInstance::FieldsMap& SnapshotInstance::getFields() const
+{
+    return fields;
+}
+
+const IEntity::IInstance::FieldsValues
+    SnapshotInstance::getFieldsValues() const
+{
+    FieldsValues result;
+    for (const auto& [memberName, field] : fields)
+    {
+        result.emplace(memberName, field->getValue());
+    }
+    return std::forward<FieldsValues>(result);
+}
+
+void SnapshotInstance::supplement(
+    const MemberName& memberName,
+    const IEntity::IEntityMember::IInstance::FieldType& value)
+{
+    auto field = std::make_shared<Entity::EntityMember::StaticInstance>(value);
+    if (!fields.emplace(memberName, std::move(field)).second)
+    {
+        throw std::logic_error("The requested member '" + memberName +
+                               "' already registried.");
+    }
+}
+
+void SnapshotInstance::supplementOrUpdate(
+    const MemberName& memberName,
+    const IEntity::IEntityMember::IInstance::FieldType& value)
+{
+    auto findFieldIt = fields.find(memberName);
+    if (findFieldIt != fields.end())
+    {
+        findFieldIt->second->setValue(value);
+        return;
+    }
+    supplement(memberName, value);
+}
+
+bool SnapshotInstance::hasField(const MemberName& memberName) const
+{
+    return fields.find(memberName) != fields.end();
+}
+
+bool SnapshotInstance::checkCondition(
+    const IEntity::ConditionPtr condition) const
+{
+    return !condition || condition->check(*this);
+}
+
+const std::map<std::size_t, IEntity::InstancePtr>
+    SnapshotInstance::getComplex() const
+{
+    // The complex instances are flattened on the snapshot saving.
+    return std::map<std::size_t, IEntity::InstancePtr>();
+}
+
+bool SnapshotInstance::isComplex() const
+{
+    return false;
+}
+
+void SnapshotInstance::initDefaultFieldsValue()
+{
+    // The default values were captured with the snapshot.
+}
+
+std::size_t SnapshotInstance::getHash() const
+{
+    return hash;
+}
+
+EntitySnapshot::~EntitySnapshot() noexcept
+{
+    terminate();
+}
+
+bool EntitySnapshot::load()
+{
+    std::vector<std::pair<EntityPtr, std::vector<IEntity::InstancePtr>>>
+        restoredEntities;
+    size_t totalInstances = 0;
+
+    try
+    {
+        if (!std::filesystem::exists(path))
+        {
+            LOG_INFO << "No entities snapshot found at " << path;
+            return false;
+        }
+
+        MappedFile snapshotFile(path);
+        auto reader = snapshotFile.getReader();
+
+        if (!reader.checkMagic(magic) ||
+            reader.read<uint32_t>() != formatVersion ||
+            reader.read<uint64_t>() != getSchemaHash())
+        {
+            LOG_WARNING << "The entities snapshot " << path
+                        << " is incompatible. Ignoring";
+            return false;
+        }
+
+        auto entitiesCount = reader.read<uint32_t>();
+        for (uint32_t entityIndex = 0; entityIndex < entitiesCount;
+             entityIndex++)
+        {
+            auto entityName = reader.read<std::string>();
+            auto& providers = entityManager.getSupplementProviders();
+            auto findProviderIt = providers.find(entityName);
+            auto entity = findProviderIt != providers.end()
+                              ? findProviderIt->second
+                              : entityManager.getEntity(entityName);
+
+            std::vector<IEntity::InstancePtr> instances;
+            auto instancesCount = reader.read<uint32_t>();
+            for (uint32_t instanceIndex = 0; instanceIndex < instancesCount;
+                 instanceIndex++)
+            {
+                auto instance = std::make_shared<SnapshotInstance>(
+                    static_cast<std::size_t>(reader.read<uint64_t>()));
+                auto fieldsCount = reader.read<uint32_t>();
+                for (uint32_t fieldIndex = 0; fieldIndex < fieldsCount;
+                     fieldIndex++)
+                {
+                    auto memberName = reader.read<std::string>();
+                    instance->supplementOrUpdate(memberName,
+                                                 reader.readField());
+                }
+                instances.push_back(std::move(instance));
+            }
+            totalInstances += instances.size();
+            restoredEntities.emplace_back(std::move(entity),
+                                          std::move(instances));
+        }
+
+        if (!reader.isEnd())
+        {
+            throw SnapshotException("unexpected trailing data");
+        }
+    }
+    catch (std::exception& ex)
+    {
+        LOG_WARNING << "Fail to load the entities snapshot. Reason: "
+                    << ex.what();
+        return false;
+    }
+
+    // Apply the snapshot only when it is read completely
+    for (auto& [entity, instances] : restoredEntities)
+    {
+        entity->setInstances(std::move(instances));
+    }
+
+    loaded = true;
+    LOG_INFO << "Restored " << totalInstances << " instances of "
+             << restoredEntities.size() << " entities from " << path;
+    return true;
+}
+
+void EntitySnapshot::save() const
+{
+    std::vector<EntityPtr> entities;
+    for (auto& [_, provider] : entityManager.getSupplementProviders())
+    {
+        entities.push_back(provider);
+    }
+    for (auto& [_, entity] : entityManager.getEntities())
+    {
+        entities.push_back(entity);
+    }
+
+    SnapshotWriter writer;
+    writer.writeMagic(magic);
+    writer.write(formatVersion);
+    writer.write(getSchemaHash());
+    writer.write(static_cast<uint32_t>(entities.size()));
+    for (auto& entity : entities)
+    {
+        // The stored instances are taken as is: the supplement providers are
+        // saved by themselves and applied again once the snapshot is loaded.
+        auto instances = entity->getStoredInstances();
+        writer.write(entity->getName());
+        writer.write(static_cast<uint32_t>(instances.size()));
+        for (auto& instance : instances)
+        {
+            // The DBus instances are updated by the brokers meanwhile,
+            // hence the values are copied under the instance lock.
+            const auto fields = instance->getFieldsValues();
+            writer.write(static_cast<uint64_t>(instance->getHash()));
+            writer.write(static_cast<uint32_t>(fields.size()));
+            for (auto& [memberName, value] : fields)
+            {
+                writer.write(memberName);
+                writer.writeField(value);
+            }
+        }
+    }
+
+    const std::filesystem::path snapshotPath(path);
+    const std::string temporaryPath = path + ".tmp";
+
+    std::error_code error;
+    std::filesystem::create_directories(snapshotPath.parent_path(), error);
+    if (error)
+    {
+        throw SnapshotException("can't create the directory of " + path +
+                                ": " + error.message());
+    }
+
+    writeSynced(temporaryPath, writer.getBuffer());
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        throw SnapshotException("can't replace " + path + ": " +
+                                strerror(errno));
+    }
+    syncDirectory(snapshotPath.has_parent_path()
+                      ? snapshotPath.parent_path().string()
+                      : std::string("."));
+    LOG_DEBUG << "The entities snapshot saved to " << path;
+}
+
+void EntitySnapshot::start(ReadyPredicate isReady)
+{
+    active = true;
+    saveThread =
+        std::thread(&EntitySnapshot::doSaveSnapshots, this, std::move(isReady));
+    LOG_INFO << "Save the entities snapshot each " << interval.count()
+             << "s to " << path;
+}
+
+void EntitySnapshot::terminate()
+{
+    {
+        std::lock_guard<std::mutex> lock(terminateMutex);
+        active = false;
+    }
+    terminateCondition.notify_all();
+
+    if (saveThread.joinable())
+    {
+        saveThread.join();
+    }
+}
+
+uint64_t EntitySnapshot::getSchemaHash() const
+{
+    constexpr uint64_t fnvOffsetBasis = 0xcbf29ce484222325ULL;
+    uint64_t hash = fnvOffsetBasis;
+
+    fnvHash(hash, std::to_string(std::variant_size_v<FieldType>));
+    auto hashEntity = [&hash](const EntityPtr& entity) {
+        fnvHash(hash, entity->getName());
+        for (auto& [memberName, _] : entity->getMembers())
+        {
+            fnvHash(hash, memberName);
+        }
+    };
+
+    for (auto& [_, provider] : entityManager.getSupplementProviders())
+    {
+        hashEntity(provider);
+    }
+    for (auto& [_, entity] : entityManager.getEntities())
+    {
+        hashEntity(entity);
+    }
+    return hash;
+}
+
+void EntitySnapshot::doSaveSnapshots(ReadyPredicate isReady)
+{
+    bool isTerminated = false;
+    while (!isTerminated)
+    {
+        {
+            std::unique_lock<std::mutex> lock(terminateMutex);
+            isTerminated = terminateCondition.wait_for(
+                lock, interval, [this]() { return !active; });
+        }
+
+        if (!isReady())
+        {
+            LOG_DEBUG << "The entities are not populated yet. Skip saving "
+                         "the snapshot";
+            continue;
+        }
+
+        try
+        {
+            save();
+            lastSaveTime.store(
+                std::chrono::steady_clock::now().time_since_epoch().count(),
+                std::memory_order_relaxed);
+        }
+        catch (std::exception& ex)
+        {
+            LOG_ERROR << "Fail to save the entities snapshot. Reason: "
+                      << ex.what();
+        }
+    }
+    LOG_INFO << "Terminate the entities snapshot thread";
+}
+
+} // namespace entity
+} // namespace app
@@ -0,0 +1,194 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#ifndef __ENTITY_SNAPSHOT_H__
+#define __ENTITY_SNAPSHOT_H__
+
+#include <core/entity/entity.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace app
+{
+namespace entity
+{
+
+class EntitySnapshot;
+
+using EntitySnapshotUni = std::unique_ptr<EntitySnapshot>;
+
+namespace exceptions
+{
+
+class SnapshotException : public EntityException
+{
+  public:
+    explicit SnapshotException(const std::string& arg) :
+        EntityException("Entities snapshot: " + arg)
+    {}
+    virtual ~SnapshotException() noexcept = default;
+};
+
+} // namespace exceptions
+
+/**
+ * @brief The entity instance restored from the snapshot. It keeps the fields
+ *        values captured at the moment of the snapshot saving and serves them
+ *        until the brokers repopulate the entity.
+ */
+class SnapshotInstance final : public IEntity::IInstance
+{
+    const std::size_t hash;
+    FieldsMap fields;
+
+  public:
+    SnapshotInstance(const SnapshotInstance&) = delete;
+    SnapshotInstance& operator=(const SnapshotInstance&) = delete;
+    SnapshotInstance(SnapshotInstance&&) = delete;
+    SnapshotInstance& operator=(SnapshotInstance&&) = delete;
+
+    explicit SnapshotInstance(std::size_t instanceHash) noexcept :
+        hash(instanceHash)
+    {}
+    ~SnapshotInstance() noexcept override = default;
+
+    const IEntity::IEntityMember::InstancePtr&
+        getField(const IEntity::EntityMemberPtr&) const override;
+    const IEntity::IEntityMember::InstancePtr&
+        getField(const MemberName&) const override;
+    const FieldsMap& getFields() const override;
+    const FieldsValues getFieldsValues() const override;
+
+    void supplement(
+        const MemberName&,
+        const IEntity::IEntityMember::IInstance::FieldType&) override;
+    void supplementOrUpdate(
+        const MemberName&,
+        const IEntity::IEntityMember::IInstance::FieldType&) override;
+
+    bool hasField(const MemberName&) const override;
+    bool checkCondition(const IEntity::ConditionPtr) const override;
+
+    const std::map<std::size_t, IEntity::InstancePtr>
+        getComplex() const override;
+    bool isComplex() const override;
+
+    void initDefaultFieldsValue() override;
+    std::size_t getHash() const override;
+};
+
+/**
+ * @brief The binary snapshot of the entities store.
+ *
+ * The snapshot is loaded once on startup, before the brokers are started, so
+ * the requests are served by the stale-but-valid data while the brokers
+ * repopulate the entities. Then the snapshot is periodically saved by the
+ * own thread. The snapshot is bound to the schema of the entities: the
+ * snapshot of another schema or format version is ignored.
+ *
+ * Layout (host byte order):
+ *   header   := magic[8] version:u32 schema:u64 entities:u32 entity*
+ *   entity   := name:str instances:u32 instance*
+ *   instance := hash:u64 fields:u32 field*
+ *   field    := name:str type:u8 value
+ *   str      := length:u32 bytes[length]
+ */
+class EntitySnapshot final
+{
+  public:
+    using ReadyPredicate = std::function<bool()>;
+
+    static constexpr std::string_view magic = "OBMCSNAP";
+    static constexpr uint32_t formatVersion = 1;
+
+    EntitySnapshot(const EntitySnapshot&) = delete;
+    EntitySnapshot& operator=(const EntitySnapshot&) = delete;
+    EntitySnapshot(EntitySnapshot&&) = delete;
+    EntitySnapshot& operator=(EntitySnapshot&&) = delete;
+
+    explicit EntitySnapshot(const EntityManager& manager,
+                            const std::string& snapshotPath,
+                            std::chrono::seconds saveInterval) :
+        entityManager(manager),
+        path(snapshotPath), interval(saveInterval), loaded(false),
+        active(false)
+    {}
+    ~EntitySnapshot() noexcept;
+
+    /**
+     * @brief Restore the instances of the entities from the snapshot file.
+     *        The missed, corrupted or incompatible snapshot is ignored.
+     *
+     * @return true - the snapshot has been restored
+     */
+    bool load();
+
+    /**
+     * @brief Serialize the actual entities store to the snapshot file. The
+     *        file is replaced atomically.
+     *
+     * @throw exceptions::SnapshotException
+     */
+    void save() const;
+
+    /**
+     * @brief Start the thread to save the snapshot periodically.
+     *
+     * @param isReady - the snapshot is saved only when the predicate is
+     *                  satisfied, e.g. the entities are fully populated.
+     */
+    void start(ReadyPredicate isReady);
+    void terminate();
+
+    bool isLoaded() const
+    {
+        return loaded;
+    }
+
+    /**
+     * @brief Get the time of the last snapshot saved by the own thread,
+     *        nullopt if the snapshot is never saved.
+     */
+    std::optional<std::chrono::steady_clock::time_point> getLastSaveTime() const
+    {
+        const auto ticks = lastSaveTime.load(std::memory_order_relaxed);
+        if (ticks == 0)
+        {
+            return std::nullopt;
+        }
+        return std::chrono::steady_clock::time_point(
+            std::chrono::steady_clock::duration(ticks));
+    }
+
+  protected:
+    uint64_t getSchemaHash() const;
+    void doSaveSnapshots(ReadyPredicate isReady);
+
+  private:
+    const EntityManager& entityManager;
+    const std::string path;
+    const std::chrono::seconds interval;
+
+    std::atomic_bool loaded;
+    std::atomic_bool active;
+    std::atomic<std::chrono::steady_clock::rep> lastSaveTime{0};
+    std::mutex terminateMutex;
+    std::condition_variable terminateCondition;
+    std::thread saveThread;
+};
+
+} // namespace entity
+} // namespace app
+
+#endif // __ENTITY_SNAPSHOT_H__
@@ -0,0 +1,302 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#ifndef __HELPERS_JSON_WRITER_H__
+#define __HELPERS_JSON_WRITER_H__
+
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <ostream>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+namespace app
+{
+namespace helpers
+{
+namespace writer
+{
+
+/**
+ * @brief The incremental JSON writer to serialize the values straight into
+ *        the output stream without building the JSON DOM.
+ *
+ * The formatting follows the nlohmann::json::dump(): the same indentation,
+ * the same strings escaping and the floating point numbers always keep the
+ * fraction or the exponent part. The non-finite numbers are written as null.
+ */
+class JsonWriter final
+{
+    struct Scope
+    {
+        bool isObject;
+        bool isEmpty;
+    };
+
+    std::ostream& output;
+    const int indent;
+    const size_t baseDepth;
+    std::vector<Scope> scopes;
+    bool isKeyWritten;
+
+  public:
+    static constexpr int compact = -1;
+
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+    JsonWriter(JsonWriter&&) = delete;
+    JsonWriter& operator=(JsonWriter&&) = delete;
+
+    /**
+     * @brief Construct a new Json Writer object
+     *
+     * @param outputStream - the stream to write into.
+     * @param indentSize   - the count of spaces to indent the nested values.
+     *                       The negative value means the compact output.
+     * @param depth        - the nesting depth of the written value in the
+     *                       enclosing document, see getDepth()
+     */
+    explicit JsonWriter(std::ostream& outputStream, int indentSize = compact,
+                        size_t depth = 0) :
+        output(outputStream),
+        indent(indentSize), baseDepth(depth), isKeyWritten(false)
+    {}
+    ~JsonWriter() noexcept = default;
+
+    void beginObject()
+    {
+        beginValue();
+        output.put('{');
+        scopes.push_back({true, true});
+    }
+
+    void endObject()
+    {
+        endScope('}');
+    }
+
+    void beginArray()
+    {
+        beginValue();
+        output.put('[');
+        scopes.push_back({false, true});
+    }
+
+    void endArray()
+    {
+        endScope(']');
+    }
+
+    void key(std::string_view name)
+    {
+        separate();
+        writeString(name);
+        output.put(':');
+        if (indent >= 0)
+        {
+            output.put(' ');
+        }
+        isKeyWritten = true;
+    }
+
+    void value(std::string_view stringValue)
+    {
+        beginValue();
+        writeString(stringValue);
+    }
+
+    void value(const char* stringValue)
+    {
+        value(std::string_view(stringValue));
+    }
+
+    void value(bool boolValue)
+    {
+        beginValue();
+        output << (boolValue ? "true" : "false");
+    }
+
+    void value(std::nullptr_t)
+    {
+        beginValue();
+        output << "null";
+    }
+
+    template <typename TValue>
+    std::enable_if_t<std::is_arithmetic_v<TValue> &&
+                     !std::is_same_v<TValue, bool>>
+        value(TValue numberValue)
+    {
+        beginValue();
+        std::array<char, 64> buffer;
+        if constexpr (std::is_floating_point_v<TValue>)
+        {
+            if (!std::isfinite(numberValue))
+            {
+                output << "null";
+                return;
+            }
+            auto [end, _] = std::to_chars(buffer.begin(), buffer.end(),
+                                          numberValue);
+            const std::string_view number(buffer.data(),
+                                          static_cast<size_t>(end - buffer.data()));
+            output.write(number.data(),
+                         static_cast<std::streamsize>(number.size()));
+            if (number.find_first_of(".eE") == std::string_view::npos)
+            {
+                output << ".0";
+            }
+        }
+        else
+        {
+            // Promote the char-like integers to be written as the numbers
+            auto [end, _] = std::to_chars(buffer.begin(), buffer.end(),
+                                          +numberValue);
+            output.write(buffer.data(),
+                         static_cast<std::streamsize>(end - buffer.data()));
+        }
+    }
+
+    template <typename... TTypes>
+    void value(const std::variant<TTypes...>& variantValue)
+    {
+        std::visit([this](auto&& alternative) { value(alternative); },
+                   variantValue);
+    }
+
+    /**
+     * @brief Write the value serialized by another writer. The value has to
+     *        be written with the same indentation at the same depth.
+     */
+    void rawValue(std::string_view serializedValue)
+    {
+        beginValue();
+        output.write(serializedValue.data(),
+                     static_cast<std::streamsize>(serializedValue.size()));
+    }
+
+    int getIndent() const
+    {
+        return indent;
+    }
+
+    /**
+     * @brief Get the nesting depth of the next written value
+     */
+    size_t getDepth() const
+    {
+        return baseDepth + scopes.size();
+    }
+
+  protected:
+    void newLine(size_t depth)
+    {
+        if (indent < 0)
+        {
+            return;
+        }
+        output.put('\n');
+        for (size_t spaces = (baseDepth + depth) * static_cast<size_t>(indent);
+             spaces > 0; spaces--)
+        {
+            output.put(' ');
+        }
+    }
+
+    void separate()
+    {
+        if (scopes.empty())
+        {
+            return;
+        }
+        auto& scope = scopes.back();
+        if (!scope.isEmpty)
+        {
+            output.put(',');
+        }
+        scope.isEmpty = false;
+        newLine(scopes.size());
+    }
+
+    void beginValue()
+    {
+        if (isKeyWritten)
+        {
+            isKeyWritten = false;
+            return;
+        }
+        separate();
+    }
+
+    void endScope(char closeSymbol)
+    {
+        const bool isEmpty = scopes.back().isEmpty;
+        scopes.pop_back();
+        if (!isEmpty)
+        {
+            newLine(scopes.size());
+        }
+        output.put(closeSymbol);
+    }
+
+    void writeString(std::string_view stringValue)
+    {
+        static constexpr std::string_view hexDigits = "0123456789abcdef";
+
+        output.put('"');
+        size_t chunkBegin = 0;
+        for (size_t position = 0; position < stringValue.size(); position++)
+        {
+            const auto symbol = static_cast<unsigned char>(stringValue[position]);
+            if (symbol >= 0x20 && symbol != '"' && symbol != '\\')
+            {
+                continue;
+            }
+
+            output.write(stringValue.data() + chunkBegin,
+                         static_cast<std::streamsize>(position - chunkBegin));
+            chunkBegin = position + 1;
+            switch (symbol)
+            {
+                case '"':
+                    output << "\\\"";
+                    break;
+                case '\\':
+                    output << "\\\\";
+                    break;
+                case '\b':
+                    output << "\\b";
+                    break;
+                case '\f':
+                    output << "\\f";
+                    break;
+                case '\n':
+                    output << "\\n";
+                    break;
+                case '\r':
+                    output << "\\r";
+                    break;
+                case '\t':
+                    output << "\\t";
+                    break;
+                default:
+                    output << "\\u00" << hexDigits[symbol >> 4U]
+                           << hexDigits[symbol & 0x0FU];
+                    break;
+            }
+        }
+        output.write(stringValue.data() + chunkBegin,
+                     static_cast<std::streamsize>(stringValue.size() -
+                                                  chunkBegin));
+        output.put('"');
+    }
+};
+
+} // namespace writer
+} // namespace helpers
+} // namespace app
+
+#endif // __HELPERS_JSON_WRITER_H__
@@ -7,7 +7,10 @@
 #include <logger/logger.hpp>
 #include <openssl/crypto.h>
 
+#include <array>
+#include <ctime>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <filesystem>
 
@@ -163,6 +166,36 @@ inline const std::string getFormattedCurrentDate()
     return std::forward<std::string>(dateStr);
 }
 
+/**
+ * @brief Get the current date in the format of the 'Date' header. The date
+ *        is formatted once per second by each thread, hence the response
+ *        doesn't format nor allocate the date.
+ *
+ * @return std::string_view - the date, valid until the next second
+ */
+inline std::string_view getCachedCurrentDate()
+{
+    struct CachedDate
+    {
+        time_t second = -1;
+        std::array<char, 32> text{};
+        size_t length = 0;
+    };
+    thread_local CachedDate cachedDate;
+
+    const time_t currentSecond = time(nullptr);
+    if (currentSecond != cachedDate.second)
+    {
+        tm currentTm{};
+        gmtime_r(&currentSecond, &currentTm);
+        cachedDate.length =
+            strftime(cachedDate.text.data(), cachedDate.text.size(),
+                     "%a, %d %b %Y %H:%M:%S GMT", &currentTm);
+        cachedDate.second = currentSecond;
+    }
+    return std::string_view(cachedDate.text.data(), cachedDate.length);
+}
+
 inline std::string urlEncode(const std::string_view value)
 {
     std::ostringstream escaped;
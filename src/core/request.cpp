@@ -29,6 +29,12 @@ bool Request::validate()
         "text/plain",
     };
 
+    // The GET request has no body, e.g. the EventSource subscription
+    if (environment().requestMethod == Fastcgipp::Http::RequestMethod::GET)
+    {
+        return true;
+    }
+
     return !environment().contentType.empty() &&
            allowedContentTypes.contains(environment().contentType);
 }
@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#include <core/request_metrics.hpp>
+
+#include <algorithm>
+#include <bit>
+
+namespace app
+{
+namespace core
+{
+
+namespace
+{
+// The single writer increments the value without the read-modify-write
+inline void increment(std::atomic_uint64_t& value, uint64_t delta = 1) noexcept
+{
+    value.store(value.load(std::memory_order_relaxed) + delta,
+                std::memory_order_relaxed);
+}
+} // namespace
+
+uint64_t LatencyHistogram::Snapshot::getQuantile(double quantile) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    const auto rank = static_cast<uint64_t>(
+        std::clamp(quantile, 0.0, 1.0) * static_cast<double>(count - 1));
+    uint64_t seen = 0;
+    for (size_t index = 0; index < bucketsCount; index++)
+    {
+        seen += buckets[index];
+        if (seen > rank)
+        {
+            return getBucketUpperBound(index);
+        }
+    }
+    return getBucketUpperBound(bucketsCount - 1);
+}
+
+void LatencyHistogram::record(uint64_t microseconds) noexcept
+{
+    increment(buckets[getBucketIndex(microseconds)]);
+    increment(sumMicroseconds, microseconds);
+    increment(count);
+}
+
+void LatencyHistogram::collect(Snapshot& snapshot) const noexcept
+{
+    // The count is read first, hence the buckets might be a bit ahead of it
+    // while the owner thread records.
+    snapshot.count += count.load(std::memory_order_relaxed);
+    snapshot.sumMicroseconds += sumMicroseconds.load(std::memory_order_relaxed);
+    for (size_t index = 0; index < bucketsCount; index++)
+    {
+        snapshot.buckets[index] += buckets[index].load(std::memory_order_relaxed);
+    }
+}
+
+size_t LatencyHistogram::getBucketIndex(uint64_t microseconds) noexcept
+{
+    if (microseconds < subBuckets)
+    {
+        return static_cast<size_t>(microseconds);
+    }
+    // The magnitude is the count of the halvings to fit the sub-buckets, the
+    // sub-bucket is the bits next to the most significant one.
+    const auto shift =
+        static_cast<size_t>(std::bit_width(microseconds)) - subBucketBits - 1;
+    const auto subBucket =
+        static_cast<size_t>(microseconds >> shift) & (subBuckets - 1);
+    return std::min((shift + 1) * subBuckets + subBucket, bucketsCount - 1);
+}
+
+uint64_t LatencyHistogram::getBucketUpperBound(size_t bucketIndex) noexcept
+{
+    if (bucketIndex < subBuckets)
+    {
+        return bucketIndex + 1;
+    }
+    const auto shift = bucketIndex / subBuckets - 1;
+    const auto subBucket = bucketIndex % subBuckets;
+    return (subBuckets + subBucket + 1) << shift;
+}
+
+void RequestMetrics::recordPhase(
+    RequestPhase phase, std::chrono::steady_clock::duration latency)
+{
+    const auto microseconds =
+        std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    getThreadMetrics()
+        .phases[static_cast<size_t>(phase)]
+        .record(static_cast<uint64_t>(std::max<decltype(microseconds)>(
+            microseconds, 0)));
+}
+
+void RequestMetrics::countRequest(int statusCode)
+{
+    auto& threadMetrics = getThreadMetrics();
+    increment(threadMetrics.requests);
+    if (statusCode >= 500)
+    {
+        increment(threadMetrics.serverErrors);
+    }
+    else if (statusCode >= 400)
+    {
+        increment(threadMetrics.clientErrors);
+    }
+}
+
+const RequestMetrics::Snapshot RequestMetrics::collect()
+{
+    Snapshot snapshot;
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    for (const auto& threadMetrics : threadsMetrics)
+    {
+        for (size_t phase = 0; phase < phasesCount; phase++)
+        {
+            threadMetrics->phases[phase].collect(snapshot.phases[phase]);
+        }
+        snapshot.requests +=
+            threadMetrics->requests.load(std::memory_order_relaxed);
+        snapshot.clientErrors +=
+            threadMetrics->clientErrors.load(std::memory_order_relaxed);
+        snapshot.serverErrors +=
+            threadMetrics->serverErrors.load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+const char* RequestMetrics::getPhaseName(RequestPhase phase)
+{
+    switch (phase)
+    {
+        case RequestPhase::session:
+            return "session";
+        case RequestPhase::authentication:
+            return "authentication";
+        case RequestPhase::parsing:
+            return "parsing";
+        case RequestPhase::execution:
+            return "execution";
+        case RequestPhase::writing:
+            return "writing";
+        case RequestPhase::total:
+            return "total";
+        default:
+            break;
+    }
+    return "unknown";
+}
+
+RequestMetrics::ThreadMetrics& RequestMetrics::getThreadMetrics()
+{
+    // The metrics of the thread are registered once by the first request
+    // served by the thread.
+    thread_local ThreadMetrics* threadMetrics = [this]() {
+        auto metrics = std::make_shared<ThreadMetrics>();
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        threadsMetrics.push_back(metrics);
+        return metrics.get();
+    }();
+    return *threadMetrics;
+}
+
+} // namespace core
+} // namespace app
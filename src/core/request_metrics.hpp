@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#ifndef __REQUEST_METRICS_H__
+#define __REQUEST_METRICS_H__
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace app
+{
+namespace core
+{
+
+/**
+ * @brief The phases of the request handling. The body of the response is
+ *        serialized while it's written, hence the serialization is measured
+ *        by the writing phase.
+ */
+enum class RequestPhase : size_t
+{
+    session,        // re-reading the sessions shared with the bmcweb
+    authentication, // authenticating the session of the request
+    parsing,        // parsing the request body by the route handler
+    execution,      // running the route handler
+    writing,        // serializing and writing the response
+    total,          // the whole request since the connection is created
+    count
+};
+
+/**
+ * @brief The latency histogram of the log-linear buckets in microseconds,
+ *        alike the HDR histogram: each power of two is split into the linear
+ *        sub-buckets, hence the relative error is below 1/subBuckets.
+ *
+ * The histogram is written by the single owner thread without the atomic
+ * read-modify-write operations, the other threads read the relaxed values.
+ */
+class LatencyHistogram final
+{
+  public:
+    static constexpr size_t subBucketBits = 3;
+    static constexpr size_t subBuckets = 1U << subBucketBits;
+    // Covers up to 2^40 microseconds, the larger values are clamped
+    static constexpr size_t bucketsCount = subBuckets * 38;
+
+    struct Snapshot
+    {
+        uint64_t count = 0;
+        uint64_t sumMicroseconds = 0;
+        std::array<uint64_t, bucketsCount> buckets{};
+
+        /**
+         * @brief Get the upper bound of the bucket which holds the quantile
+         *
+         * @param quantile - the quantile in the range [0, 1]
+         * @return uint64_t - the latency in microseconds
+         */
+        uint64_t getQuantile(double quantile) const;
+    };
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+    LatencyHistogram(LatencyHistogram&&) = delete;
+    LatencyHistogram& operator=(LatencyHistogram&&) = delete;
+
+    LatencyHistogram() = default;
+    ~LatencyHistogram() noexcept = default;
+
+    /**
+     * @brief Record the latency. Called by the owner thread only.
+     */
+    void record(uint64_t microseconds) noexcept;
+    void collect(Snapshot& snapshot) const noexcept;
+
+    static size_t getBucketIndex(uint64_t microseconds) noexcept;
+    /**
+     * @brief Get the exclusive upper bound of the bucket in microseconds
+     */
+    static uint64_t getBucketUpperBound(size_t bucketIndex) noexcept;
+
+  private:
+    std::atomic_uint64_t count{0};
+    std::atomic_uint64_t sumMicroseconds{0};
+    std::array<std::atomic_uint64_t, bucketsCount> buckets{};
+};
+
+/**
+ * @brief The per-phase latencies and the counters of the served requests.
+ *        Each thread records into its own histograms, which are merged only
+ *        once the metrics are collected, hence the request handling doesn't
+ *        contend with the other requests nor with the exporting.
+ */
+class RequestMetrics final
+{
+    static constexpr size_t phasesCount =
+        static_cast<size_t>(RequestPhase::count);
+
+    struct ThreadMetrics
+    {
+        std::array<LatencyHistogram, phasesCount> phases;
+        std::atomic_uint64_t requests{0};
+        std::atomic_uint64_t clientErrors{0};
+        std::atomic_uint64_t serverErrors{0};
+    };
+    using ThreadMetricsPtr = std::shared_ptr<ThreadMetrics>;
+
+    // The metrics of the exited threads are kept to not lose the counts
+    std::mutex threadsMutex;
+    std::vector<ThreadMetricsPtr> threadsMetrics;
+
+    RequestMetrics() = default;
+
+  public:
+    struct Snapshot
+    {
+        std::array<LatencyHistogram::Snapshot, phasesCount> phases;
+        uint64_t requests = 0;
+        uint64_t clientErrors = 0;
+        uint64_t serverErrors = 0;
+
+        const LatencyHistogram::Snapshot& getPhase(RequestPhase phase) const
+        {
+            return phases[static_cast<size_t>(phase)];
+        }
+    };
+
+    RequestMetrics(const RequestMetrics&) = delete;
+    RequestMetrics& operator=(const RequestMetrics&) = delete;
+    RequestMetrics(RequestMetrics&&) = delete;
+    RequestMetrics& operator=(RequestMetrics&&) = delete;
+    ~RequestMetrics() noexcept = default;
+
+    static RequestMetrics& getInstance()
+    {
+        static RequestMetrics requestMetrics;
+        return requestMetrics;
+    }
+
+    /**
+     * @brief Record the latency of the request phase by the current thread
+     */
+    void recordPhase(RequestPhase phase,
+                     std::chrono::steady_clock::duration latency);
+
+    /**
+     * @brief Count the served request by the HTTP status code of it
+     */
+    void countRequest(int statusCode);
+
+    /**
+     * @brief Merge the metrics of all threads
+     */
+    const Snapshot collect();
+
+    static const char* getPhaseName(RequestPhase phase);
+
+  protected:
+    ThreadMetrics& getThreadMetrics();
+};
+
+/**
+ * @brief Record the latency of the request phase once the scope is left
+ */
+class PhaseTimer final
+{
+  public:
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+    PhaseTimer(PhaseTimer&&) = delete;
+    PhaseTimer& operator=(PhaseTimer&&) = delete;
+
+    explicit PhaseTimer(RequestPhase measuredPhase) noexcept :
+        phase(measuredPhase), startTime(std::chrono::steady_clock::now())
+    {}
+    ~PhaseTimer() noexcept
+    {
+        if (isDiscarded)
+        {
+            return;
+        }
+        try
+        {
+            RequestMetrics::getInstance().recordPhase(
+                phase, std::chrono::steady_clock::now() - startTime);
+        }
+        catch (...)
+        {
+            // The metrics are never the reason to fail the request
+        }
+    }
+
+    /**
+     * @brief Don't record the phase, e.g. the long-living events stream
+     */
+    void discard() noexcept
+    {
+        isDiscarded = true;
+    }
+
+  private:
+    const RequestPhase phase;
+    const std::chrono::steady_clock::time_point startTime;
+    bool isDiscarded = false;
+};
+
+} // namespace core
+} // namespace app
+
+#endif // __REQUEST_METRICS_H__
@@ -15,7 +15,7 @@ namespace core
 
 size_t Response::totalSize() const
 {
-    return internalBuffer.length();
+    return getBody().length();
 }
 
 const statuses::Code& Response::getStatus()
@@ -28,30 +28,115 @@ void Response::setStatus(const statuses::Code& status)
     this->status = status;
 }
 
-void Response::setHeader(const std::string& headerName, const std::string& value)
+void Response::setHeader(std::string_view headerName, std::string_view value)
 {
-    headerBuffer += (app::http::header(headerName, value) + endHeaderLine);
+    headerBuffer.append(headerName).append(": ").append(value).append(
+        endHeaderLine);
+    if (headerName == app::http::headers::etag)
+    {
+        entityTag = value;
+    }
 }
 
-const std::string Response::getHeaders() const
+const std::string& Response::getEntityTag() const
 {
-    return (headerBuffer + endHeaderLine);
+    return entityTag;
+}
+
+const std::string& Response::getHeaders() const
+{
+    return headerBuffer;
+}
+
+void Response::writeHead(std::ostream& os) const
+{
+    app::http::writeHeaderStatus(os, status);
+    os.write(headerBuffer.data(),
+             static_cast<std::streamsize>(headerBuffer.size()));
+    os << endHeaderLine;
+}
+
+void Response::setContentType(const std::string& mediaType)
+{
+    contentType = mediaType;
+}
+
+std::string_view Response::getContentType() const
+{
+    if (contentType.empty())
+    {
+        return content_types::applicationJson;
+    }
+    return contentType;
 }
 
 const std::string& Response::getBody() const
 {
-    return internalBuffer;
+    return sharedBody ? *sharedBody : internalBuffer;
 }
 
-void Response::push(const std::string& buffer)
+void Response::push(std::string_view buffer)
 {
-    internalBuffer += buffer;
+    if (sharedBody)
+    {
+        internalBuffer = *sharedBody;
+        sharedBody.reset();
+    }
+    internalBuffer.append(buffer);
 };
 
+void Response::setBody(std::shared_ptr<const std::string> body)
+{
+    internalBuffer.clear();
+    bodyWriter = nullptr;
+    bodyStream.reset();
+    sharedBody = std::move(body);
+}
+
 void Response::clear()
 {
     internalBuffer.clear();
+    sharedBody.reset();
+    bodyWriter = nullptr;
+    bodyStream.reset();
 };
 
+void Response::setBodyWriter(BodyWriter writer)
+{
+    internalBuffer.clear();
+    sharedBody.reset();
+    bodyStream.reset();
+    bodyWriter = std::move(writer);
+}
+
+void Response::setBodyStream(BodyStreamPtr stream)
+{
+    internalBuffer.clear();
+    sharedBody.reset();
+    bodyWriter = nullptr;
+    bodyStream = std::move(stream);
+}
+
+const BodyStreamPtr& Response::getBodyStream() const
+{
+    return bodyStream;
+}
+
+bool Response::isStreamed() const
+{
+    return bodyWriter || bodyStream;
+}
+
+void Response::writeBody(std::ostream& os) const
+{
+    if (bodyWriter)
+    {
+        bodyWriter(os);
+        return;
+    }
+    const auto& body = getBody();
+    os.write(body.data(), static_cast<std::streamsize>(body.size()));
+}
+
 } // namespace core
 } // namespace app
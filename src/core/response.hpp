@@ -8,9 +8,11 @@
 #include <http/headers.hpp>
 #include <nlohmann/json.hpp>
 
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
 
 namespace app
 {
@@ -20,6 +22,36 @@ namespace core
 using namespace Fastcgipp;
 using namespace app::http;
 
+/**
+ * @brief The body written by parts, e.g. the events stream. The connection
+ *        releases the worker thread between the parts and writes the next
+ *        part once the stream wakes it up.
+ */
+class IBodyStream
+{
+  public:
+    using Wakeup = std::function<void()>;
+
+    virtual ~IBodyStream() = default;
+
+    /**
+     * @brief Start the stream once the head of the response is sent.
+     *
+     * @param wakeup - the callback to schedule writing the next part, it
+     *                 may be called by any thread
+     */
+    virtual void start(Wakeup) = 0;
+    /**
+     * @brief Write the part of the body which is ready.
+     *
+     * @param os - the output stream
+     * @return true - the body is completed
+     */
+    virtual bool writeNext(std::ostream&) = 0;
+};
+
+using BodyStreamPtr = std::shared_ptr<IBodyStream>;
+
 /**
  * @brief
  *
@@ -27,6 +59,8 @@ using namespace app::http;
 class IResponse
 {
   public:
+    using BodyWriter = std::function<void(std::ostream&)>;
+
     // struct IStatus
     // {
     //   public:
@@ -65,14 +99,38 @@ class IResponse
      * @param headerName - name of header
      * @param headerValue - value of header
      */
-    virtual void setHeader(const std::string&, const std::string&) = 0;
+    virtual void setHeader(std::string_view, std::string_view) = 0;
+
+    /**
+     * @brief Get the value of the ETag header
+     *
+     * @return const std::string& - the entity tag, empty if not set
+     */
+    virtual const std::string& getEntityTag() const = 0;
+
+    /**
+     * @brief Set the media type of the body. The JSON is sent by default.
+     *
+     * @param contentType - the value of the Content-Type header
+     */
+    virtual void setContentType(const std::string&) = 0;
+    virtual std::string_view getContentType() const = 0;
 
     /**
      * @brief Get the Headers buffer
      *
-     * @return const std::string& the buffer of all headers.
+     * @return const std::string& the buffer of all header lines, without the
+     *         empty line which terminates the head.
+     */
+    virtual const std::string& getHeaders() const = 0;
+
+    /**
+     * @brief Write the head of the response: the status line, the headers
+     *        and the empty line.
+     *
+     * @param os - the output stream
      */
-    virtual const std::string getHeaders() const = 0;
+    virtual void writeHead(std::ostream&) const = 0;
     /**
      * @brief Destroy the IResponse object
      *
@@ -85,12 +143,52 @@ class IResponse
      *
      * @param buffer data
      */
-    virtual void push(const std::string&) = 0;
+    virtual void push(std::string_view) = 0;
+
+    /**
+     * @brief Set the immutable body shared with the other responses, e.g.
+     *        the cached one. The body is sent without being copied.
+     *
+     * @param body - the shared body
+     */
+    virtual void setBody(std::shared_ptr<const std::string>) = 0;
     /**
      * @brief clear the internal output buffer
      */
     virtual void clear() = 0;
 
+    /**
+     * @brief Set the writer to stream the body straight into the output.
+     *        The streamed body has unknown length, hence it is sent
+     *        without the Content-Length header. The writer throws if the
+     *        body can't be completely written.
+     *
+     * @param writer - the callback to write the body
+     */
+    virtual void setBodyWriter(BodyWriter) = 0;
+
+    /**
+     * @brief Set the stream to write the body by parts. The streamed body is
+     *        sent without the Content-Length header and is never compressed.
+     *
+     * @param stream - the body stream
+     */
+    virtual void setBodyStream(BodyStreamPtr) = 0;
+    virtual const BodyStreamPtr& getBodyStream() const = 0;
+
+    /**
+     * @brief Whether the body is streamed by the body writer or the body
+     *        stream
+     */
+    virtual bool isStreamed() const = 0;
+
+    /**
+     * @brief Write the body to the output stream
+     *
+     * @param os - the output stream
+     */
+    virtual void writeBody(std::ostream&) const = 0;
+
     /**
      * @brief
      *
@@ -208,9 +306,15 @@ class IResponse
 class Response : public IResponse
 {
     static constexpr const char* endHeaderLine = "\r\n";
+    // Fits the headers of the most responses, hence the headers are
+    // appended without the reallocation.
+    static constexpr size_t headerCapacity = 512;
 
   public:
-    explicit Response() : status(statuses::Code::NotFound){};
+    explicit Response() : status(statuses::Code::NotFound)
+    {
+        headerBuffer.reserve(headerCapacity);
+    };
     Response(const Response&) = delete;
     Response(const Response&&) = delete;
 
@@ -231,16 +335,34 @@ class Response : public IResponse
 
     void setStatus(const statuses::Code&) override;
 
-    void setHeader(const std::string&, const std::string&) override;
-    const std::string getHeaders() const override;
+    void setHeader(std::string_view, std::string_view) override;
+    const std::string& getEntityTag() const override;
+    const std::string& getHeaders() const override;
+    void writeHead(std::ostream&) const override;
+
+    void setContentType(const std::string&) override;
+    std::string_view getContentType() const override;
 
-    void push(const std::string&) override;
+    void push(std::string_view) override;
+    void setBody(std::shared_ptr<const std::string>) override;
 
     void clear() override;
 
+    void setBodyWriter(BodyWriter) override;
+    void setBodyStream(BodyStreamPtr) override;
+    const BodyStreamPtr& getBodyStream() const override;
+    bool isStreamed() const override;
+    void writeBody(std::ostream&) const override;
+
   private:
     std::string headerBuffer;
+    // The empty type is the default JSON
+    std::string contentType;
     std::string internalBuffer;
+    std::shared_ptr<const std::string> sharedBody;
+    std::string entityTag;
+    BodyWriter bodyWriter;
+    BodyStreamPtr bodyStream;
     statuses::Code status;
 };
 
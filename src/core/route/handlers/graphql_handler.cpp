@@ -1,14 +1,24 @@
 // SPDX-License-Identifier: Apache-2.0
 // Copyright (C) 2021 YADRO
 
+#include <config.h>
+
 #include <graphqlparser/AstVisitor.h>
+#include <graphqlparser/GraphQLParser.h>
 
 #include <core/application.hpp>
 #include <core/route/handlers/graphql_handler.hpp>
+#include <core/route/handlers/graphql_persisted.hpp>
+#include <core/route/handlers/graphql_subscription.hpp>
+#include <http/headers.hpp>
 #include <logger/logger.hpp>
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <functional>
+#include <set>
 #include <type_traits>
 
 namespace app
@@ -25,39 +35,31 @@ using namespace nlohmann;
 using namespace facebook::graphql;
 using namespace facebook::graphql::ast;
 
-GqlObjectBuild::GqlObjectBuild(const std::string& objectName,
-                               const entity::EntityPtr& inputEntity,
-                               GqlBuildPtr parentBuilder) :
-    name(objectName),
-    entityObject(inputEntity), parent(parentBuilder), fragment(json::object({}))
-{
-
-    LOG_DEBUG << "Build Objects " << objectName;
-
-    if (!entityObject)
-    {
-        LOG_WARNING << "Attempt to create builder without Entity object";
-        return;
-    }
-
-    for (auto instance : entityObject->getInstances())
-    {
-        // init each one json object for each specified entity instance
-        fragment[std::to_string(instance->getHash())] = json::object({});
-    }
-}
-
 bool ObmcGqlVisitor::visitOperationDefinition(
     const OperationDefinition& operationDefinition)
 {
     LOG_DEBUG << "visitOperationDefinition: "
               << operationDefinition.getOperation();
 
-    result.push_back({operationDefinition.getOperation(), json::object({})});
+    const auto* name = operationDefinition.getName();
+    const std::string operationName = name ? name->getValue() : "";
+    const auto& operations = plan.getOperations();
+    if (!operationName.empty() &&
+        std::any_of(operations.begin(), operations.end(),
+                    [&operationName](const auto& operation) {
+                        return operation.operationName == operationName;
+                    }))
+    {
+        throw exceptions::GqlAstError("The operation name is not unique: " +
+                                      operationName);
+    }
+
+    auto& operation = plan.addOperation(operationDefinition.getOperation(),
+                                        operationName);
 
     LOG_DEBUG << "Make visitor";
     decltype(auto) visitor = VisitorFactory::build(
-        operationDefinition.getOperation(), result.back());
+        operationDefinition.getOperation(), operation);
 
     LOG_DEBUG << "visitor created";
     if (!visitor)
@@ -66,7 +68,8 @@ bool ObmcGqlVisitor::visitOperationDefinition(
     }
 
     operationDefinition.accept(visitor.get());
-    return true;
+    // The operation is already compiled by the specific visitor
+    return false;
 }
 
 void ObmcGqlVisitor::endVisitOperationDefinition(
@@ -76,31 +79,139 @@ void ObmcGqlVisitor::endVisitOperationDefinition(
               << operationDefinition.getOperation();
 }
 
-const nlohmann::json& ObmcGqlVisitor::getResult() const
+// QUERY VISITOR
+void GqlQueryVisitor::compileValue(const Value& value,
+                                   const json::json_pointer& path,
+                                   GqlArgumentValue& argument) const
 {
-    return result;
+    auto& target = argument.literal[path];
+    try
+    {
+        if (auto variable = dynamic_cast<const Variable*>(&value))
+        {
+            const std::string variableName = variable->getName().getValue();
+            if (operation.variables.count(variableName) == 0)
+            {
+                throw exceptions::GqlInvalidArgument(
+                    variableName, "Variable is not defined");
+            }
+            argument.variables.emplace_back(path, variableName);
+        }
+        else if (auto intValue = dynamic_cast<const IntValue*>(&value))
+        {
+            target = std::stoll(intValue->getValue());
+        }
+        else if (auto floatValue = dynamic_cast<const FloatValue*>(&value))
+        {
+            target = std::stod(floatValue->getValue());
+        }
+        else if (auto stringValue = dynamic_cast<const StringValue*>(&value))
+        {
+            target = stringValue->getValue();
+        }
+        else if (auto enumValue = dynamic_cast<const EnumValue*>(&value))
+        {
+            // The enum values are matched to the string fields values
+            target = enumValue->getValue();
+        }
+        else if (auto boolValue = dynamic_cast<const BooleanValue*>(&value))
+        {
+            target = boolValue->getValue();
+        }
+        else if (auto listValue = dynamic_cast<const ListValue*>(&value))
+        {
+            target = json::array();
+            size_t index = 0;
+            for (const auto& item : listValue->getValues())
+            {
+                compileValue(*item, path / index++, argument);
+            }
+        }
+        else if (auto objectValue = dynamic_cast<const ObjectValue*>(&value))
+        {
+            target = json::object();
+            for (const auto& objectField : objectValue->getFields())
+            {
+                compileValue(objectField->getValue(),
+                             path / objectField->getName().getValue(),
+                             argument);
+            }
+        }
+        else
+        {
+            target = nullptr;
+        }
+    }
+    catch (std::logic_error& ex)
+    {
+        // The out of range numbers
+        LOG_ERROR << "Invalid GQL argument value: " << ex.what();
+        throw exceptions::GqlInvalidArgument(path.to_string(),
+                                             "Invalid value");
+    }
+}
+
+void GqlQueryVisitor::compileArguments(const Field& field,
+                                       GqlSelection& selection) const
+{
+    static const std::set<std::string> supportedArguments{
+        GqlSelectionArguments::filter,
+        GqlSelectionArguments::first,
+        GqlSelectionArguments::after,
+    };
+
+    for (const auto& argument : *field.getArguments())
+    {
+        const std::string argumentName = argument->getName().getValue();
+        if (supportedArguments.count(argumentName) == 0)
+        {
+            throw exceptions::GqlInvalidArgument(argumentName,
+                                                 "Unknown argument");
+        }
+        GqlArgumentValue argumentValue;
+        compileValue(argument->getValue(), json::json_pointer(),
+                     argumentValue);
+        selection.arguments.values.insert_or_assign(argumentName,
+                                                    std::move(argumentValue));
+    }
 }
 
-// QUERY VISITOR
 bool GqlQueryVisitor::visitVariableDefinition(
-    const VariableDefinition&)
+    const VariableDefinition& variableDefinition)
 {
-    throw exceptions::NotSupported(
-        "GQL Variable definition temporarry not supported");
+    const std::string variableName =
+        variableDefinition.getVariable().getName().getValue();
+    LOG_DEBUG << "visitVariableDefinition: " << variableName;
+
+    json defaultValue;
+    if (variableDefinition.getDefaultValue())
+    {
+        GqlArgumentValue compiledValue;
+        compileValue(*variableDefinition.getDefaultValue(),
+                     json::json_pointer(), compiledValue);
+        if (!compiledValue.variables.empty())
+        {
+            throw exceptions::GqlInvalidArgument(
+                variableName, "The default value must be a constant");
+        }
+        defaultValue = std::move(compiledValue.literal);
+    }
+    operation.variables.insert_or_assign(variableName,
+                                         std::move(defaultValue));
+    // The type of the variable is not checked: the schema is not typed.
+    return false;
 }
 
 bool GqlQueryVisitor::visitArgument(const Argument& argument)
 {
-    LOG_DEBUG << "visitArgument: "
-              << argument.getName().getValue() << " with value ";
-    return true;
-
+    LOG_DEBUG << "visitArgument: " << argument.getName().getValue();
+    // The arguments are compiled by the field which they belong to.
+    return false;
 }
 
 void GqlQueryVisitor::endVisitArgument(const Argument& argument)
 {
-    LOG_DEBUG << "endVisitArgument: "
-              << argument.getName().getValue() << " with value ";
+    LOG_DEBUG << "endVisitArgument: " << argument.getName().getValue();
 }
 
 bool GqlQueryVisitor::visitStringValue(const StringValue& stringValue)
@@ -119,63 +230,111 @@ bool GqlQueryVisitor::visitField(const Field& field)
     LOG_DEBUG << "visitField: " << field.getName().getValue();
 
     const std::string fieldName = field.getName().getValue();
-    auto fieldAlias =
-        field.getAlias()
-            ? std::optional<std::string>(field.getAlias()->getValue())
-            : std::nullopt;
+    const std::string responseName =
+        field.getAlias() ? field.getAlias()->getValue() : fieldName;
+
+    auto& targetSelections = parentSelections.empty()
+                                 ? operation.selections
+                                 : parentSelections.back()->selections;
+    // The response is streamed without the intermediate document, hence the
+    // fields of the same response name are merged by the plan compilation.
+    auto sameSelectionIt =
+        std::find_if(targetSelections.begin(), targetSelections.end(),
+                     [&responseName](const auto& selection) {
+                         return selection.responseName == responseName;
+                     });
+    const bool hasSameResponseName = sameSelectionIt != targetSelections.end();
+    const bool hasArguments =
+        field.getArguments() && !field.getArguments()->empty();
+    if (hasSameResponseName &&
+        (sameSelectionIt->fieldName != fieldName ||
+         sameSelectionIt->isObject() != bool(field.getSelectionSet()) ||
+         hasArguments || !sameSelectionIt->arguments.empty()))
+    {
+        LOG_ERROR << "The fields conflict by the response name "
+                  << responseName;
+        throw exceptions::GqlInvalidArgument(responseName, "Fields conflict");
+    }
 
     if (field.getSelectionSet())
     {
         // This is object
         LOG_DEBUG << "This is object";
-
-        if (!fragmentBuilder)
+        if (hasSameResponseName)
         {
-            LOG_ERROR << "Not found builder for the " << fieldName
-                      << " field (aliased)";
-            throw exceptions::GqlInternalError("The builder was not found");
+            parentSelections.push_back(&(*sameSelectionIt));
+            return true;
         }
-
         try
         {
             auto entity = application.getEntityManager().getEntity(fieldName);
-            GqlBuildPtr childObjectBuilder = std::make_shared<GqlObjectBuild>(
-                fieldName, entity, fragmentBuilder);
-
-            if (fieldAlias.has_value())
+            auto& selection = targetSelections.emplace_back(
+                GqlSelection{fieldName, responseName, entity, {}, {}, {}, {}});
+            if (!parentSelections.empty())
             {
-                childObjectBuilder->setAlias(*fieldAlias);
+                // The nested object is joined to the parent instance by the
+                // relation of the entities, if any.
+                const auto& relations =
+                    parentSelections.back()->entity->getRelations();
+                auto findRelationIt = std::find_if(
+                    relations.begin(), relations.end(),
+                    [&entity](const auto& relation) {
+                        return relation->getDestinationTarget() == entity;
+                    });
+                if (findRelationIt != relations.end())
+                {
+                    selection.relation = *findRelationIt;
+                }
             }
-
-            fragmentBuilder = std::move(childObjectBuilder);
+            if (hasArguments)
+            {
+                compileArguments(field, selection);
+            }
+            parentSelections.push_back(&selection);
         }
         catch (entity::exceptions::EntityException& ex)
         {
             LOG_ERROR << "Not found object " << fieldName;
             throw exceptions::GqlAstError(ex.what());
         }
-        catch (nlohmann::detail::type_error& ex)
-        {
-            LOG_ERROR << "JSON type error: " << ex.what();
-            throw exceptions::GqlAstError(
-                "Internal GQL implementation error or requested AST structure "
-                "is not supported");
-        }
     }
     else
     {
         // Scalar field
         LOG_DEBUG << "Scalar field";
-        if (!fragmentBuilder)
+        if (parentSelections.empty())
+        {
+            LOG_ERROR << "The scalar field " << fieldName
+                      << " is requested out of an object";
+            throw exceptions::GqlInvalidArgument(fieldName, "Field not found");
+        }
+        if (hasArguments)
+        {
+            throw exceptions::GqlInvalidArgument(
+                fieldName, "The scalar field has no arguments");
+        }
+        if (hasSameResponseName)
+        {
+            return true;
+        }
+        if (fieldName == GqlSelection::cursorField)
         {
-            LOG_ERROR << "Not found builder for the " << fieldName
-                      << " field (aliased)";
-            throw exceptions::GqlInternalError("Not builder found");
+            targetSelections.emplace_back(
+                GqlSelection{fieldName, responseName, {}, {}, {}, {}, {}});
+            return true;
         }
 
-        LOG_DEBUG << "Set field value";
-        fragmentBuilder->supplement(fieldAlias.has_value() ? *fieldAlias
-                                                           : fieldName);
+        try
+        {
+            auto member = parentSelections.back()->entity->getMember(fieldName);
+            targetSelections.emplace_back(
+                GqlSelection{fieldName, responseName, {}, member, {}, {}, {}});
+        }
+        catch (entity::exceptions::EntityException& ex)
+        {
+            LOG_ERROR << "GQL Invalid Argument: " << ex.what();
+            throw exceptions::GqlInvalidArgument(fieldName, "Field not found");
+        }
     }
 
     return true;
@@ -187,228 +346,529 @@ void GqlQueryVisitor::endVisitField(const Field& field)
     if (field.getSelectionSet())
     {
         // this is object
-        LOG_DEBUG << "Reset builder to the parent";
-        fragmentBuilder->pushFragmentToParent();
-        fragmentBuilder = std::move(fragmentBuilder->getParent());
+        LOG_DEBUG << "Reset selection to the parent";
+        parentSelections.pop_back();
     }
 }
 
-GqlQueryVisitor::~GqlQueryVisitor()
+// SUBSCRIPTION VISITOR
+void GqlSubscriptionVisitor::endVisitField(const Field& field)
 {
-    this->document = fragmentBuilder->getFragment();
-}
-
-const GqlBuildPtr GqlQueryVisitor::getBuilder() const
-{
-    return this->fragmentBuilder;
+    if (field.getSelectionSet() && parentSelections.size() == 1)
+    {
+        auto& selections = parentSelections.back()->selections;
+        auto findCursorIt = std::find_if(
+            selections.begin(), selections.end(),
+            [](const auto& selection) { return selection.isCursor(); });
+        if (findCursorIt == selections.end())
+        {
+            selections.insert(selections.begin(),
+                              GqlSelection{GqlSelection::cursorField,
+                                           GqlSelection::cursorField,
+                                           {},
+                                           {},
+                                           {},
+                                           {},
+                                           {}});
+        }
+    }
+    GqlQueryVisitor::endVisitField(field);
 }
 
 // ROUTER
 
-bool GraphqlRouter::preHandlers(const RequestPtr& request)
+bool GraphqlRouter::isPrettyRequested(const RequestPtr& request)
 {
-    // Hmm, here something bad is happening without a critical section...
-    // I have assume the GraphQL AST parser is not thread-safe
-    static std::mutex parseLockMutex;
-    std::lock_guard<std::mutex> lock(parseLockMutex);
-
-    const char* error;
-
-    const auto postBuffer = request->environment().postBuffer();
-
-    if (postBuffer.empty())
+    const auto& environment = request->environment();
+    if (environment.gets.find(params::prettyQuery) != environment.gets.end())
     {
-        LOG_DEBUG << "No data in POST. Skip parse body";
         return true;
     }
-    LOG_DEBUG << "Buffer length=" << postBuffer.size();
-    LOG_DEBUG << "Content length=" << request->environment().contentLength;
-
-    std::string data(postBuffer.begin(), postBuffer.end());
+    auto findHeaderIt = environment.others.find(params::prettyHeader);
+    return findHeaderIt != environment.others.end() &&
+           findHeaderIt->second != "0" && findHeaderIt->second != "false";
+}
 
-    auto jsonData = json::parse(data.c_str(), nullptr, false);
-    if (jsonData.is_discarded() || !jsonData["query"].is_string())
+json GraphqlRouter::parseGetParameters(const RequestPtr& request)
+{
+    // The GET request carries the GraphQL request fields as the query
+    // parameters, the JSON fields are encoded as the strings.
+    static const std::set<std::string> jsonEncodedFields{
+        requestFieldVariables,
+        requestFieldExtensions,
+    };
+
+    auto result = json::object();
+    for (const auto& [name, value] : request->environment().gets)
     {
-        LOG_ERROR << "Error parsing GQL request in json file.";
-        LOG_DEBUG << "Input Buffer: " << postBuffer.data();
-        return true;
+        if (jsonEncodedFields.count(name) == 0)
+        {
+            result[name] = value;
+            continue;
+        }
+        auto decodedValue = json::parse(value, nullptr, false);
+        if (!decodedValue.is_discarded())
+        {
+            result[name] = std::move(decodedValue);
+        }
     }
+    return std::forward<json>(result);
+}
+
+void GraphqlRouter::reset()
+{
+    // The capacity of the operations is kept for the next request
+    operationRequests.clear();
+    isBatch = false;
+    responseIndent = helpers::writer::JsonWriter::compact;
+}
+
+bool GraphqlRouter::preHandlers(const RequestPtr& request)
+{
+    responseIndent = isPrettyRequested(request)
+                         ? prettyIndent
+                         : helpers::writer::JsonWriter::compact;
 
-    LOG_DEBUG << "GraphQL Schema: " << jsonData.dump(4);
     try
     {
-        auto astData = jsonData["query"].get<const std::string>();
-        gqlNode = facebook::graphql::parseString(astData.c_str(), &error);
-
-        if (!gqlNode)
-        {
-            LOG_ERROR << "Can't parse AST GQL: " << error;
-            free(const_cast<char*>(error)); // NOLINT
-        }
+        parseOperationRequests(request);
     }
-    catch (std::exception& ex)
+    catch (json::exception& ex)
     {
-        LOG_ERROR << "Error parsing GQL request. Reason:" << ex.what();
+        // The malformed request is reported by the run as the empty one
+        LOG_ERROR << "Error parsing GQL request: " << ex.what();
+        operationRequests.clear();
     }
     return true;
 }
 
-void GraphqlRouter::run(const RequestPtr& request, ResponseUni& response)
+void GraphqlRouter::parseOperationRequests(const RequestPtr& request)
 {
-    ObmcGqlVisitor visitor;
-    json result = json::object({});
-
-    LOG_DEBUG << "Run route: " << request->environment().requestUri;
-    try
+    json jsonData;
+    if (request->environment().requestMethod ==
+        Fastcgipp::Http::RequestMethod::GET)
     {
-        if (!gqlNode)
+        jsonData = parseGetParameters(request);
+    }
+    else
+    {
+        const auto& postBuffer = request->environment().postBuffer();
+
+        if (postBuffer.empty())
         {
-            throw exceptions::GqlAstError(
-                "Invalid Grapqh AST. Can't parse comming request");
+            LOG_DEBUG << "No data in POST. Skip parse body";
+            return;
         }
-        gqlNode->accept(&visitor);
-        decltype(auto) payload = graphql_ast_to_json(
-            reinterpret_cast<const struct GraphQLAstNode*>(gqlNode.get()));
+        LOG_DEBUG << "Buffer length=" << postBuffer.size();
+        LOG_DEBUG << "Content length=" << request->environment().contentLength;
 
-        result.push_back({fields::respFieldData, visitor.getResult()});
+        jsonData =
+            parseBody(postBuffer.data(), postBuffer.data() + postBuffer.size());
     }
-    catch (exceptions::GqlException& gqlException)
+
+    if (!jsonData.is_discarded() && jsonData.is_array())
     {
-        LOG_ERROR << "Error handle GQL request:" << gqlException.what();
-        result.push_back({fields::respFieldError, gqlException.whatJson()});
+        // The batch of the operations is served by the single request. The
+        // invalid entries are reported by the results of them.
+        isBatch = true;
+        if (jsonData.size() > maxBatchSize)
+        {
+            // The oversized batch is rejected by the run as the empty one,
+            // the entries of it aren't parsed at all.
+            LOG_ERROR << "The GQL batch is too large: " << jsonData.size();
+            return;
+        }
+        operationRequests.reserve(jsonData.size());
+        for (auto& batchEntry : jsonData)
+        {
+            operationRequests.push_back(parseOperationRequest(batchEntry));
+        }
+        return;
     }
 
-    response->push(result.dump(2));
-    response->setStatus(statuses::Code::OK);
+    if (jsonData.is_discarded() || !jsonData.is_object())
+    {
+        LOG_ERROR << "Error parsing GQL request in json file.";
+        return;
+    }
+    operationRequests.push_back(parseOperationRequest(jsonData));
 }
 
-// BUILDERS
-void GqlObjectBuild::supplement(const std::string& fieldName)
+json GraphqlRouter::parseBody(const char* begin, const char* end)
 {
-    if (!fragment.type_name() || fragment.is_null())
+    // The fields of the operation request which are read by the router. The
+    // rest of the fields are discarded while parsed, not kept in the DOM.
+    static const std::set<std::string, std::less<>> requestFields{
+        requestFieldQuery,
+        requestFieldVariables,
+        requestFieldExtensions,
+        requestFieldOperationName,
+    };
+
+    bool isBatchBody = false;
+    auto keepRequestField = [&isBatchBody](int depth, json::parse_event_t event,
+                                           json& parsed) {
+        if (depth == 0 && event == json::parse_event_t::array_start)
+        {
+            isBatchBody = true;
+        }
+        const int fieldsDepth = isBatchBody ? 2 : 1;
+        return event != json::parse_event_t::key || depth != fieldsDepth ||
+               requestFields.count(parsed.get_ref<const std::string&>()) != 0;
+    };
+    // The body is parsed straight from the FastCGI post buffer
+    return json::parse(begin, end, keepRequestField, false);
+}
+
+GraphqlRouter::OperationRequest
+    GraphqlRouter::parseOperationRequest(json& jsonData)
+{
+    OperationRequest result;
+    if (!jsonData.is_object())
     {
-        LOG_ERROR << "GQL Invalid Structure";
-        throw exceptions::GqlAstError("Invalid Structure");
+        LOG_ERROR << "Error parsing GQL request in json file.";
+        return std::forward<OperationRequest>(result);
     }
 
-    try
+    auto findVariablesIt = jsonData.find(requestFieldVariables);
+    if (findVariablesIt != jsonData.end() && findVariablesIt->is_object())
     {
-        auto member = entityObject->getMember(fieldName);
+        result.variables = std::move(*findVariablesIt);
+    }
 
-        for (auto instance : entityObject->getInstances())
+    auto findOperationNameIt = jsonData.find(requestFieldOperationName);
+    if (findOperationNameIt != jsonData.end() &&
+        findOperationNameIt->is_string())
+    {
+        result.operationName =
+            std::move(findOperationNameIt->get_ref<std::string&>());
+    }
+
+    // The persisted query is requested by the hash, the query text might be
+    // omitted.
+    auto findExtensionsIt = jsonData.find(requestFieldExtensions);
+    if (findExtensionsIt != jsonData.end() && findExtensionsIt->is_object())
+    {
+        auto findPersistedQueryIt =
+            findExtensionsIt->find(requestFieldPersistedQuery);
+        if (findPersistedQueryIt != findExtensionsIt->end())
         {
-            auto& jsonObject = fragment[std::to_string(instance->getHash())];
+            result.persistedQueryHash =
+                GqlPersistedQueries::getRequestedHash(*findPersistedQueryIt);
+        }
+    }
 
-            auto valVisitor = [&jsonObject, fieldName](auto&& value) {
-                jsonObject.push_back({fieldName, value});
-            };
-            std::visit(std::move(valVisitor),
-                       instance->getField(member)->getValue());
+    auto findQueryIt = jsonData.find(requestFieldQuery);
+    if (findQueryIt == jsonData.end() || !findQueryIt->is_string())
+    {
+        if (result.persistedQueryHash.empty())
+        {
+            LOG_ERROR << "Error parsing GQL request in json file.";
         }
+        return std::forward<OperationRequest>(result);
     }
-    catch (entity::exceptions::EntityException& ex)
+
+    // The query text is moved out of the DOM rather than copied
+    result.queryText = std::move(findQueryIt->get_ref<std::string&>());
+    LOG_DEBUG << "GraphQL query length=" << result.queryText.size();
+    return std::forward<OperationRequest>(result);
+}
+
+void GraphqlRouter::resolvePersistedQuery(OperationRequest& operationRequest)
+{
+    auto& persistedQueries = GqlPersistedQueries::getInstance();
+    if (!operationRequest.queryText.empty())
     {
-        LOG_ERROR << "GQL Invalid Argument: " << ex.what();
-        throw exceptions::GqlInvalidArgument(fieldName, "Field not found");
+        persistedQueries.add(operationRequest.persistedQueryHash,
+                             operationRequest.queryText);
+        return;
     }
-    catch (std::out_of_range& ex)
+
+    auto persistedQueryText =
+        persistedQueries.find(operationRequest.persistedQueryHash);
+    if (!persistedQueryText)
     {
-        LOG_ERROR << "Out of range: " << ex.what();
-        throw exceptions::GqlInternalError("Internal GQL logic error");
+        LOG_DEBUG << "Persisted GQL query not found: "
+                  << operationRequest.persistedQueryHash;
+        throw exceptions::PersistedQueryNotFound();
     }
+    operationRequest.queryText = std::move(*persistedQueryText);
 }
 
-void GqlObjectBuild::supplement(const std::string& fieldName,
-                                const json& childJsonNode)
+const std::pair<GqlQueryPlanPtr, GqlQueryCost>
+    GraphqlRouter::preparePlan(OperationRequest& operationRequest)
 {
-    if (this->fragment.is_object())
+    if (!operationRequest.persistedQueryHash.empty())
     {
-        for (auto& item : this->fragment)
-        {
-            item.push_back({fieldName, childJsonNode});
-        }
+        resolvePersistedQuery(operationRequest);
     }
-    else
+    if (operationRequest.queryText.empty())
     {
-        LOG_ERROR << "The internal JSON fragment type is not supproted. Type="
-                  << this->fragment.type_name();
-        throw exceptions::GqlInternalError("A GQL parser implementation error.");
+        throw exceptions::GqlAstError(
+            "Invalid Grapqh AST. Can't parse comming request");
     }
+    auto plan = GqlPlanCache::getInstance().getPlan(operationRequest.queryText);
+    // The cost is estimated by the actual instances counts, hence it is
+    // checked per request rather than once by the plan compilation.
+    const auto cost = plan->checkCost(operationRequest.variables,
+                                      operationRequest.operationName);
+    return {plan, cost};
 }
 
-const json GqlObjectBuild::getFragment() const
+void GraphqlRouter::writeResult(helpers::writer::JsonWriter& writer,
+                                const GqlQueryResultPtr& result,
+                                bool isPartial)
 {
-    json result(json::object({}));
+    writer.beginObject();
+    writer.key(fields::respFieldData);
+    result->write(writer);
+    if (isPartial)
+    {
+        writer.key(fields::respFieldExtensions);
+        writer.beginObject();
+        writer.key(fields::respFieldPartial);
+        writer.value(true);
+        writer.endObject();
+    }
+    writer.endObject();
+}
 
-    try
+void GraphqlRouter::writeError(helpers::writer::JsonWriter& writer,
+                               const json& error)
+{
+    // The error fields are the plain strings, see exceptions::GqlException
+    writer.beginObject();
+    writer.key(fields::respFieldError);
+    writer.beginObject();
+    for (const auto& [name, value] : error.items())
     {
-        if (!entityObject)
+        writer.key(name);
+        if (value.is_string())
         {
-            return std::forward<const json>(fragment.back());
+            writer.value(value.get_ref<const std::string&>());
         }
-        else if (entityObject && entityObject->getInstances().size() == 1)
+        else
         {
-            LOG_DEBUG << "GQL: Fill a singale instanced object";
-            result = fragment.back();
+            writer.value(value.dump());
         }
-        else if (entityObject && entityObject->getInstances().size() > 1)
-        {
-            LOG_DEBUG << "GQL: Fill a list of the instanced objects";
-
-            result = json::array({});
-            for (auto& internalFragmentObject : fragment)
-            {
-                result.push_back(internalFragmentObject);
-            }
-        }
-    }
-    catch (std::out_of_range& ex)
-    {
-        throw exceptions::GqlInternalError(
-            "Internal GQL logic error. Can't setup the Object data: " +
-            this->name);
     }
-    return std::forward<json>(result);
+    writer.endObject();
+    writer.endObject();
 }
 
-void GqlObjectBuild::setAlias(const std::string& alias)
+void GraphqlRouter::subscribe(const GqlQueryPlanPtr& plan,
+                              ResponseUni& response) const
 {
-    this->alias = alias;
-}
+    const auto& operationRequest = operationRequests.front();
+    auto subscription = GqlSubscription::create(
+        plan, operationRequest.variables, operationRequest.operationName);
+    if (!subscription)
+    {
+        response->setStatus(statuses::Code::ServiceUnavailable);
+        response->setHeader(
+            http::headers::retryAfter,
+            std::to_string(GqlSubscription::heartbeatInterval.count()));
+        throw exceptions::NotSupported("Too many subscriptions");
+    }
 
-GqlBuildPtr GqlObjectBuild::getParent() const
-{
-    return parent;
+    response->setContentType(http::content_types::textEventStream);
+    response->setHeader(http::headers::cacheControl, "no-cache");
+    response->setBodyStream(subscription);
 }
 
-const std::string GqlObjectBuild::getFieldName() const
+bool GraphqlRouter::checkReadiness(ResponseUni& response) const
 {
-    return std::forward<const std::string>(alias.has_value() ? *alias : name);
-}
+    static constexpr std::chrono::milliseconds readinessTimeout(
+        BMC_READINESS_TIMEOUT_MS);
+    decltype(auto) brokerManager = application.getBrokerManager();
 
-void GqlObjectBuild::pushFragmentToParent()
-{
-    if (!this->parent)
+    // The entities restored from the snapshot are served immediately as
+    // stale data while the brokers repopulate them.
+    if (!brokerManager.isReady() && application.isWarmStarted())
     {
-        LOG_DEBUG << "The parent builder not specified. Skip pushing the JSON "
-                     "framgent to the parent builder";
-        return;
+        return true;
+    }
+
+#if defined(BMC_READINESS_POLICY_UNAVAILABLE)
+    if (brokerManager.isReady())
+    {
+        return false;
     }
-    this->parent->supplement(getFieldName(), this->getFragment());
+    const auto retryAfter = std::max<std::chrono::seconds::rep>(
+        1, std::chrono::ceil<std::chrono::seconds>(readinessTimeout).count());
+    response->setStatus(statuses::Code::ServiceUnavailable);
+    response->setHeader(http::headers::retryAfter, std::to_string(retryAfter));
+    throw exceptions::NotReady();
+#elif defined(BMC_READINESS_POLICY_PARTIAL)
+    std::ignore = response;
+    return !brokerManager.isReady();
+#else
+    std::ignore = response;
+    return !brokerManager.waitReady(readinessTimeout);
+#endif
 }
 
-const entity::IEntity::InstancePtr& GqlObjectBuild::getCurrentInstance() const
+void GraphqlRouter::run(const RequestPtr& request, ResponseUni& response)
 {
-    return this->currentInstance;
+    LOG_DEBUG << "Run route: " << request->environment().requestUri;
+    response->setStatus(statuses::Code::OK);
+    try
+    {
+        const bool isPartial = checkReadiness(response);
+        if (isPartial)
+        {
+            LOG_DEBUG << "The entities population is in progress. The "
+                         "response is partial";
+        }
+
+        if (isBatch)
+        {
+            runBatch(isPartial, response);
+            return;
+        }
+        if (operationRequests.empty())
+        {
+            throw exceptions::GqlAstError(
+                "Invalid Grapqh AST. Can't parse comming request");
+        }
+        auto& operationRequest = operationRequests.front();
+        auto [plan, cost] = preparePlan(operationRequest);
+        if (plan->isSubscription(operationRequest.operationName))
+        {
+            subscribe(plan, response);
+            return;
+        }
+
+        // The same query over the same entities versions gives the same
+        // result, so the client cache is validated without the execution.
+        auto representation =
+            std::hash<std::string>{}(operationRequest.variables.dump());
+        representation ^= static_cast<std::size_t>(responseIndent + 1) << 1U |
+                          static_cast<std::size_t>(isPartial);
+        const auto& requestHeaders = request->environment().others;
+        auto acceptEncodingIt =
+            requestHeaders.find(params::acceptEncodingHeader);
+        const auto* encoding =
+            acceptEncodingIt == requestHeaders.end()
+                ? http::content_encodings::identity
+                : http::content_encodings::negotiate(acceptEncodingIt->second);
+        const auto entityTag = http::entity_tags::format(
+            plan->getEntityTag(representation, operationRequest.operationName),
+            encoding);
+        auto ifNoneMatchIt = requestHeaders.find(params::ifNoneMatchHeader);
+        if (ifNoneMatchIt != requestHeaders.end() &&
+            http::entity_tags::match(ifNoneMatchIt->second, entityTag))
+        {
+            LOG_DEBUG << "The GQL result is not modified. ETag=" << entityTag;
+            response->setStatus(statuses::Code::NotModified);
+            response->setHeader(http::headers::etag, entityTag);
+            return;
+        }
+
+        // The instances are filtered and paginated before the response
+        // is started, so the invalid arguments are reported as the error.
+        auto result = plan->execute(operationRequest.variables,
+                                    operationRequest.operationName);
+        response->setHeader(http::headers::etag, entityTag);
+
+        // The fields values are read while the response body is written to
+        // the FastCGI stream, so the result is never materialized in memory.
+        response->setBodyWriter([result, isPartial, indent = responseIndent](
+                                    std::ostream& output) {
+            helpers::writer::JsonWriter writer(output, indent);
+            try
+            {
+                writeResult(writer, result, isPartial);
+            }
+            catch (std::exception& ex)
+            {
+                // The headers are already sent, the body is truncated
+                LOG_ERROR << "Can't write GQL response: " << ex.what();
+                throw;
+            }
+        });
+    }
+    catch (exceptions::GqlException& gqlException)
+    {
+        LOG_ERROR << "Error handle GQL request:" << gqlException.what();
+        json result = json::object({});
+        result.push_back({fields::respFieldError, gqlException.whatJson()});
+        response->push(result.dump(responseIndent));
+    }
 }
 
-const entity::EntityPtr& GqlObjectBuild::getEntity() const
+void GraphqlRouter::runBatch(bool isPartial, ResponseUni& response)
 {
-    if (!entityObject)
+    if (operationRequests.empty() || operationRequests.size() > maxBatchSize)
+    {
+        throw exceptions::GqlInvalidArgument(
+            "batch", "The batch must contain from 1 to " +
+                         std::to_string(maxBatchSize) + " operations");
+    }
+
+    // All operations are executed before the response is started, so the
+    // instances of the whole batch are taken at the same moment. The
+    // failed operation doesn't fail the rest of the batch.
+    using BatchResult = std::variant<GqlQueryResultPtr, json>;
+    std::vector<BatchResult> results;
+    results.reserve(operationRequests.size());
+    std::size_t batchOutputBytes = 0;
+    for (auto& operationRequest : operationRequests)
     {
-        LOG_DEBUG << "Attempt to access the empty Entity";
+        try
+        {
+            auto [plan, cost] = preparePlan(operationRequest);
+            if (plan->isSubscription(operationRequest.operationName))
+            {
+                throw exceptions::NotSupported("Subscription in batch");
+            }
+            // The whole batch is written by the single response, hence it
+            // is bounded by the same output budget as the single query.
+            if (cost.outputBytes >
+                GqlQueryCost::maxOutputBytes - batchOutputBytes)
+            {
+                throw exceptions::GqlCostExceeded(
+                    "batchOutputBytes", batchOutputBytes + cost.outputBytes,
+                    GqlQueryCost::maxOutputBytes);
+            }
+            results.emplace_back(plan->execute(
+                operationRequest.variables, operationRequest.operationName));
+            batchOutputBytes += cost.outputBytes;
+        }
+        catch (exceptions::GqlException& gqlException)
+        {
+            LOG_ERROR << "Error handle GQL batch operation:"
+                      << gqlException.what();
+            results.emplace_back(gqlException.whatJson());
+        }
     }
-    return this->entityObject;
+
+    response->setBodyWriter(
+        [results = std::move(results), isPartial,
+         indent = responseIndent](std::ostream& output) {
+            helpers::writer::JsonWriter writer(output, indent);
+            try
+            {
+                writer.beginArray();
+                for (const auto& result : results)
+                {
+                    if (std::holds_alternative<json>(result))
+                    {
+                        writeError(writer, std::get<json>(result));
+                        continue;
+                    }
+                    writeResult(writer, std::get<GqlQueryResultPtr>(result),
+                                isPartial);
+                }
+                writer.endArray();
+            }
+            catch (std::exception& ex)
+            {
+                // The headers are already sent, the body is truncated
+                LOG_ERROR << "Can't write GQL batch response: " << ex.what();
+                throw;
+            }
+        });
 }
 
 // FACTORY
@@ -421,13 +881,14 @@ void VisitorFactory::registerVisitor(const std::string& visitorName)
                   "This is not a GQL visitor");
 
     visitorBuildersDict.emplace(
-        visitorName, [visitorName](nlohmann::json& fragment) -> AstVisitorUni {
-            return std::make_unique<TVisitor>(fragment);
+        visitorName,
+        [visitorName](GqlQueryPlan::Operation& operation) -> AstVisitorUni {
+            return std::make_unique<TVisitor>(operation);
         });
 }
 
 AstVisitorUni VisitorFactory::build(const std::string visitorName,
-                                    nlohmann::json& fragment)
+                                    GqlQueryPlan::Operation& operation)
 {
     auto builder = visitorBuildersDict.find(visitorName);
     if (builder == visitorBuildersDict.end())
@@ -435,12 +896,52 @@ AstVisitorUni VisitorFactory::build(const std::string visitorName,
         return AstVisitorUni();
     }
 
-    return builder->second(fragment);
+    return builder->second(operation);
+}
+
+GqlQueryPlanPtr GqlPlanCache::compile(const std::string& queryText)
+{
+    // The libgraphqlparser is reentrant: the flex scanner state is allocated
+    // per parseString() call and the bison parser is pure. Hence the queries
+    // are parsed concurrently by the FastCGI worker threads.
+    const auto concurrentParses = ++parsesInFlight;
+    auto peakParses = peakParsesInFlight.load();
+    while (concurrentParses > peakParses &&
+           !peakParsesInFlight.compare_exchange_weak(peakParses,
+                                                     concurrentParses))
+    {}
+    if (concurrentParses > 1)
+    {
+        contendedParses++;
+    }
+
+    const char* error = nullptr;
+    auto gqlNode = facebook::graphql::parseString(queryText.c_str(), &error);
+    parsesInFlight--;
+    LOG_DEBUG << "GraphQL parse contention: contended=" << contendedParses
+              << ", peak concurrent=" << peakParsesInFlight;
+
+    if (!gqlNode)
+    {
+        const std::string reason(error ? error : "unknown error");
+        LOG_ERROR << "Can't parse AST GQL: " << reason;
+        free(const_cast<char*>(error)); // NOLINT
+        throw exceptions::GqlAstError(reason);
+    }
+
+    auto plan =
+        std::make_shared<GqlQueryPlan>(std::hash<std::string>{}(queryText));
+    ObmcGqlVisitor visitor(*plan);
+    gqlNode->accept(&visitor);
+
+    return plan;
 }
 
 void VisitorFactory::registerGqlVisitors() noexcept
 {
     registerVisitor<GqlQueryVisitor>(GqlQueryVisitor::visitorName.data());
+    registerVisitor<GqlSubscriptionVisitor>(
+        GqlSubscriptionVisitor::visitorName.data());
     // FIXME(IK) implement GqlMutationVisitor
 }
 
@@ -11,6 +11,7 @@
 
 #include <core/entity/entity.hpp>
 #include <core/exceptions.hpp>
+#include <core/route/handlers/graphql_plan.hpp>
 #include <core/router.hpp>
 #include <logger/logger.hpp>
 #include <nlohmann/json.hpp>
@@ -18,7 +19,9 @@
 #include <exception>
 #include <map>
 #include <optional>
+#include <utility>
 #include <variant>
+#include <vector>
 
 namespace app
 {
@@ -32,8 +35,26 @@ namespace fields
 
 constexpr const char* respFieldData = "data";
 constexpr const char* respFieldError = "error";
+constexpr const char* respFieldExtensions = "extensions";
+constexpr const char* respFieldPartial = "partial";
 
 } // namespace fields
+
+namespace params
+{
+
+// The pretty printed response is requested either by the query parameter
+// or by the 'X-Pretty-Print' header
+constexpr const char* prettyQuery = "pretty";
+constexpr const char* prettyHeader = "HTTP_X_PRETTY_PRINT";
+// The raw 'If-None-Match' header: the quoted tags list isn't parsed by the
+// FastCGI environment.
+constexpr const char* ifNoneMatchHeader = "HTTP_IF_NONE_MATCH";
+// The streamed response is compressed by the coding negotiated by the
+// 'Accept-Encoding' header, each coding has its own entity tag.
+constexpr const char* acceptEncodingHeader = "HTTP_ACCEPT_ENCODING";
+
+} // namespace params
 namespace handlers
 {
 
@@ -44,68 +65,6 @@ using namespace facebook::graphql::ast; // NOLINT
 
 using AstVisitorUni = std::unique_ptr<visitor::AstVisitor>;
 
-class IGqlBuild;
-using GqlBuildPtr = std::shared_ptr<IGqlBuild>;
-
-class IGqlBuild : public std::enable_shared_from_this<IGqlBuild>
-{
-  public:
-    virtual ~IGqlBuild() noexcept = default;
-
-    virtual void setAlias(const std::string&) = 0;
-    virtual void supplement(const std::string&) = 0;
-    virtual void supplement(const std::string&, const json&) = 0;
-
-    virtual void pushFragmentToParent() = 0;
-    virtual const json getFragment() const = 0;
-    virtual GqlBuildPtr getParent() const = 0;
-    virtual const std::string getFieldName() const = 0;
-    virtual const entity::IEntity::InstancePtr& getCurrentInstance() const = 0;
-    virtual const entity::EntityPtr& getEntity() const = 0;
-};
-
-class GqlObjectBuild :
-    public IGqlBuild,
-    public std::enable_shared_from_this<GqlObjectBuild>
-{
-    const std::string name;
-    const entity::EntityPtr entityObject;
-
-    GqlBuildPtr parent;
-    json fragment;
-    std::optional<std::string> alias;
-    entity::IEntity::InstancePtr currentInstance;
-  public:
-    GqlObjectBuild(const std::string& objectName) :
-        name(objectName), parent(GqlBuildPtr()),
-        fragment(json::object({{objectName, json::object({})}}))
-    {}
-
-    GqlObjectBuild(const std::string&, const entity::EntityPtr&, GqlBuildPtr);
-
-    GqlObjectBuild(const GqlObjectBuild&) = delete;
-    GqlObjectBuild(const GqlObjectBuild&&) = delete;
-
-    GqlObjectBuild& operator=(const GqlObjectBuild&) = delete;
-    GqlObjectBuild& operator=(const GqlObjectBuild&&) = delete;
-
-    ~GqlObjectBuild() noexcept override = default;
-
-    void setAlias(const std::string&) override;
-
-    void supplement(const std::string&) override;
-    void supplement(const std::string&, const json&) override;
-
-    const json getFragment() const;
-    GqlBuildPtr getParent() const override;
-    const std::string getFieldName() const override;
-    void pushFragmentToParent() override;
-    const entity::IEntity::InstancePtr& getCurrentInstance() const;
-    const entity::EntityPtr& getEntity() const override;
-  protected:
-    // json& getTargetJson();
-};
-
 namespace exceptions
 {
 class GqlException : public core::exceptions::ObmcAppException
@@ -190,9 +149,69 @@ class GqlAstError : public GqlException
     virtual ~GqlAstError() noexcept = default;
 };
 
+class NotReady : public GqlException
+{
+  public:
+    explicit NotReady() noexcept :
+        GqlException("Service", "The entities population is in progress")
+    {}
+    virtual ~NotReady() noexcept = default;
+};
+
+class PersistedQueryNotFound : public GqlException
+{
+  public:
+    explicit PersistedQueryNotFound() noexcept :
+        GqlException("PersistedQueryNotFound",
+                     "The query is not found by the hash. Send the query "
+                     "text along with the hash")
+    {}
+    virtual ~PersistedQueryNotFound() noexcept = default;
+};
+
+class GqlCostExceeded : public GqlException
+{
+    static constexpr const char* fieldLimit = "Limit";
+    static constexpr const char* fieldEstimated = "Estimated";
+    static constexpr const char* fieldMaximum = "Maximum";
+
+  public:
+    explicit GqlCostExceeded(const std::string& limit, std::size_t estimated,
+                             std::size_t maximum) noexcept :
+        GqlException("Query cost", "The query exceeds the cost limit")
+    {
+        addField(fieldLimit, limit);
+        addField(fieldEstimated, std::to_string(estimated));
+        addField(fieldMaximum, std::to_string(maximum));
+    }
+    virtual ~GqlCostExceeded() noexcept = default;
+};
+
 } // namespace exceptions
 class GraphqlRouter : public IRouteHandler
 {
+    static constexpr int prettyIndent = 2;
+    static constexpr const char* requestFieldQuery = "query";
+    static constexpr const char* requestFieldVariables = "variables";
+    static constexpr const char* requestFieldExtensions = "extensions";
+    static constexpr const char* requestFieldPersistedQuery = "persistedQuery";
+    static constexpr const char* requestFieldOperationName = "operationName";
+    // The limit of the operations served by the single batch request
+    static constexpr size_t maxBatchSize = 16;
+
+    /**
+     * @brief The fields of the single GraphQL operation request
+     */
+    struct OperationRequest
+    {
+        std::string queryText;
+        std::string persistedQueryHash;
+        // The operation to execute, might be omitted for the document of
+        // the single operation
+        std::string operationName;
+        json variables = json::object();
+    };
+
   public:
     explicit GraphqlRouter(const std::string& iPath) : path(iPath)
     {}
@@ -206,23 +225,117 @@ class GraphqlRouter : public IRouteHandler
 
     void run(const RequestPtr& request, ResponseUni& response) override;
     bool preHandlers(const RequestPtr& request) override;
+    void reset() override;
 
     virtual ~GraphqlRouter() = default;
 
+  protected:
+    /**
+     * @brief Apply the configured readiness policy to the request that is
+     *        handled before the entities have been populated.
+     *
+     * @param response - the response to setup if the request is rejected
+     * @return true - the request has to be served with partial data
+     * @throw exceptions::NotReady - the request is rejected
+     */
+    bool checkReadiness(ResponseUni& response) const;
+
+    /**
+     * @brief Check whether the client has requested the pretty printed
+     *        response. The compact JSON is written by default.
+     */
+    static bool isPrettyRequested(const RequestPtr& request);
+
+    /**
+     * @brief Resolve the query text of the persisted query by the hash, or
+     *        register the query text sent along with the hash.
+     *
+     * @throw exceptions::PersistedQueryNotFound - the unknown hash
+     * @throw exceptions::GqlInvalidArgument - the hash doesn't match the text
+     */
+    static void resolvePersistedQuery(OperationRequest& operationRequest);
+
+    /**
+     * @brief Get the compiled plan of the operation request and check the
+     *        estimated cost of it.
+     *
+     * @return the plan and the estimated cost of the plan
+     * @throw exceptions::GqlException - the query is invalid or too costly
+     */
+    static const std::pair<GqlQueryPlanPtr, GqlQueryCost>
+        preparePlan(OperationRequest& operationRequest);
+
+    /**
+     * @brief Execute the batch of the operations. The results are written as
+     *        the array in the order of the operations, the failed operation
+     *        is reported by the error object in place of the result.
+     *
+     * @throw exceptions::GqlInvalidArgument - the batch size is invalid
+     */
+    void runBatch(bool isPartial, ResponseUni& response);
+
+    /**
+     * @brief Start the subscription streamed as the Server-Sent Events by
+     *        the response body.
+     *
+     * @throw exceptions::GqlException - the subscription can't be started
+     */
+    void subscribe(const GqlQueryPlanPtr& plan, ResponseUni& response) const;
+
+    /**
+     * @brief Get the GraphQL request fields of the GET request. It is used
+     *        by the EventSource clients which can't send the body.
+     */
+    static json parseGetParameters(const RequestPtr& request);
+
+    /**
+     * @brief Parse the JSON body of the POST request in place. Only the
+     *        fields of the operation request read by the router are kept.
+     *
+     * @return json - the request object, the array of the request
+     *                      objects of the batch, or the discarded value if
+     *                      the body is invalid
+     */
+    static json parseBody(const char* begin, const char* end);
+    /**
+     * @brief Parse the operation requests of the GET parameters or of the
+     *        POST body.
+     *
+     * @throw json::exception - the request fields are malformed
+     */
+    void parseOperationRequests(const RequestPtr& request);
+
+    /**
+     * @brief Get the operation request fields of the JSON request object.
+     *        The query text and the variables are moved out of the object.
+     */
+    static OperationRequest parseOperationRequest(json& jsonData);
+
+    static void writeResult(helpers::writer::JsonWriter& writer,
+                            const GqlQueryResultPtr& result, bool isPartial);
+    static void writeError(helpers::writer::JsonWriter& writer,
+                           const json& error);
+
   private:
     std::string path;
 
-    std::unique_ptr<ast::Node> gqlNode;
+    std::vector<OperationRequest> operationRequests;
+    bool isBatch = false;
+    int responseIndent = helpers::writer::JsonWriter::compact;
 };
 
 // VISITORS
 
+/**
+ * @brief Compiles the GraphQL document to the execution plan. Each operation
+ *        is compiled by the visitor registered for the operation type.
+ */
 class ObmcGqlVisitor : public visitor::AstVisitor
 {
-    nlohmann::json result;
+    GqlQueryPlan& plan;
 
   public:
-    ObmcGqlVisitor() : result(json::object())
+    explicit ObmcGqlVisitor(GqlQueryPlan& targetPlan) : plan(targetPlan)
     {}
     ~ObmcGqlVisitor() override = default;
 
@@ -230,21 +343,21 @@ class ObmcGqlVisitor : public visitor::AstVisitor
         const OperationDefinition& operationDefinition) override;
     void endVisitOperationDefinition(
         const OperationDefinition& operationDefinition) override;
-
-    const nlohmann::json& getResult() const;
 };
 
 class GqlQueryVisitor : public visitor::AstVisitor
 {
-    GqlBuildPtr fragmentBuilder;
+  protected:
+    GqlQueryPlan::Operation& operation;
+    // The chain of the object selections to the visited field.
+    std::vector<GqlSelection*> parentSelections;
 
   public:
     static constexpr std::string_view visitorName = "query";
 
-    GqlQueryVisitor(nlohmann::json& fragment) : document(fragment)
-    {
-        fragmentBuilder = std::make_shared<GqlObjectBuild>(visitorName.data());
-    }
+    explicit GqlQueryVisitor(GqlQueryPlan::Operation& targetOperation) :
+        operation(targetOperation)
+    {}
 
     GqlQueryVisitor(const GqlQueryVisitor&) = delete;
     GqlQueryVisitor(const GqlQueryVisitor&&) = delete;
@@ -264,18 +377,54 @@ class GqlQueryVisitor : public visitor::AstVisitor
     bool visitField(const Field& field) override;
     void endVisitField(const Field& field) override;
 
-    ~GqlQueryVisitor() override;
+    ~GqlQueryVisitor() override = default;
 
-    const GqlBuildPtr getBuilder() const;
+  protected:
+    /**
+     * @brief Compile the AST value of the argument to the JSON value. The
+     *        variables are bound by the path of the value to substitute.
+     *
+     * @param value    - the AST value
+     * @param path     - the path of the value in the argument
+     * @param argument - the target argument value
+     * @throw exceptions::GqlInvalidArgument
+     */
+    void compileValue(const Value& value, const json::json_pointer& path,
+                      GqlArgumentValue& argument) const;
+    void compileArguments(const Field& field, GqlSelection& selection) const;
+};
 
-  private:
-    nlohmann::json& document;
+/**
+ * @brief Compiles the subscription operation. The subscription is compiled as
+ *        the query, but each root object selects the cursor of the instances
+ *        to identify the changed instances in the events.
+ */
+class GqlSubscriptionVisitor : public GqlQueryVisitor
+{
+  public:
+    static constexpr std::string_view visitorName =
+        GqlQueryPlan::subscriptionOperation;
+
+    explicit GqlSubscriptionVisitor(GqlQueryPlan::Operation& targetOperation) :
+        GqlQueryVisitor(targetOperation)
+    {}
+
+    GqlSubscriptionVisitor(const GqlSubscriptionVisitor&) = delete;
+    GqlSubscriptionVisitor(const GqlSubscriptionVisitor&&) = delete;
+
+    GqlSubscriptionVisitor& operator=(const GqlSubscriptionVisitor&) = delete;
+    GqlSubscriptionVisitor& operator=(const GqlSubscriptionVisitor&&) = delete;
+
+    void endVisitField(const Field& field) override;
+
+    ~GqlSubscriptionVisitor() override = default;
 };
 
 class VisitorFactory final
 {
     using VisitorPurpose = std::string;
-    using VisitorBuilderFn = std::function<AstVisitorUni(nlohmann::json&)>;
+    using VisitorBuilderFn =
+        std::function<AstVisitorUni(GqlQueryPlan::Operation&)>;
     using VisitorDict = std::map<VisitorPurpose, VisitorBuilderFn>;
     static VisitorDict visitorBuildersDict;
 
@@ -291,7 +440,7 @@ class VisitorFactory final
     static void registerGqlVisitors() noexcept;
 
     static AstVisitorUni build(const std::string visitorName,
-                               nlohmann::json& fragment);
+                               GqlQueryPlan::Operation& operation);
 
   private:
     template <class TVisitor>
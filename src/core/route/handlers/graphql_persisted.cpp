@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#include <openssl/sha.h>
+
+#include <core/route/handlers/graphql_handler.hpp>
+#include <core/route/handlers/graphql_persisted.hpp>
+#include <core/route/handlers/graphql_plan.hpp>
+#include <logger/logger.hpp>
+#include <nlohmann/json.hpp>
+
+#include <array>
+#include <fstream>
+
+namespace app
+{
+namespace core
+{
+namespace route
+{
+namespace handlers
+{
+
+size_t GqlPersistedQueries::load(const std::string& path)
+{
+    std::ifstream persistedFile(path);
+    if (!persistedFile.is_open())
+    {
+        LOG_INFO << "No persisted GraphQL queries file: " << path;
+        return 0;
+    }
+
+    auto persistedData = nlohmann::json::parse(persistedFile, nullptr, false);
+    if (persistedData.is_discarded() || !persistedData.is_object())
+    {
+        LOG_ERROR << "Invalid persisted GraphQL queries file: " << path;
+        return 0;
+    }
+
+    size_t loaded = 0;
+    for (const auto& [hash, queryValue] : persistedData.items())
+    {
+        if (!queryValue.is_string() ||
+            hashQuery(queryValue.get_ref<const std::string&>()) != hash)
+        {
+            LOG_ERROR << "Skip the persisted GraphQL query " << hash
+                      << ": the hash doesn't match the query";
+            continue;
+        }
+        const auto& queryText = queryValue.get_ref<const std::string&>();
+        try
+        {
+            // Warm the plans cache to serve the first requests straight from
+            // the compiled plans.
+            GqlPlanCache::getInstance().getPlan(queryText);
+        }
+        catch (exceptions::GqlException& ex)
+        {
+            LOG_ERROR << "Skip the persisted GraphQL query " << hash << ": "
+                      << ex.what();
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(queriesMutex);
+        preloadedQueries.insert_or_assign(hash, queryText);
+        loaded++;
+    }
+    LOG_INFO << "Loaded " << loaded << " persisted GraphQL queries";
+    return loaded;
+}
+
+const std::optional<std::string>
+    GqlPersistedQueries::find(const std::string& hash)
+{
+    std::lock_guard<std::mutex> lock(queriesMutex);
+    auto findPreloadedIt = preloadedQueries.find(hash);
+    if (findPreloadedIt != preloadedQueries.end())
+    {
+        return findPreloadedIt->second;
+    }
+
+    auto findAutomaticIt = automaticIndex.find(hash);
+    if (findAutomaticIt == automaticIndex.end())
+    {
+        return std::nullopt;
+    }
+    automaticQueries.splice(automaticQueries.begin(), automaticQueries,
+                            findAutomaticIt->second);
+    return findAutomaticIt->second->queryText;
+}
+
+void GqlPersistedQueries::add(const std::string& hash,
+                              const std::string& queryText)
+{
+    if (hashQuery(queryText) != hash)
+    {
+        throw exceptions::GqlInvalidArgument(
+            extensionFieldHash, "The hash doesn't match the query");
+    }
+
+    std::lock_guard<std::mutex> lock(queriesMutex);
+    if (preloadedQueries.count(hash) != 0)
+    {
+        return;
+    }
+    auto findAutomaticIt = automaticIndex.find(hash);
+    if (findAutomaticIt != automaticIndex.end())
+    {
+        automaticQueries.splice(automaticQueries.begin(), automaticQueries,
+                                findAutomaticIt->second);
+        return;
+    }
+    if (automaticQueries.size() >= automaticCapacity)
+    {
+        LOG_DEBUG << "Evict the persisted GraphQL query "
+                  << automaticQueries.back().hash;
+        automaticIndex.erase(automaticQueries.back().hash);
+        automaticQueries.pop_back();
+    }
+    automaticQueries.push_front(AutomaticQuery{hash, queryText});
+    automaticIndex.emplace(hash, automaticQueries.begin());
+}
+
+const std::string
+    GqlPersistedQueries::getRequestedHash(const nlohmann::json& persistedQuery)
+{
+    if (!persistedQuery.is_object())
+    {
+        LOG_DEBUG << "The persisted query extension is not an object";
+        return std::string();
+    }
+
+    auto findVersionIt = persistedQuery.find(extensionFieldVersion);
+    if (findVersionIt == persistedQuery.end() ||
+        !findVersionIt->is_number_integer() ||
+        findVersionIt->get<int64_t>() !=
+            static_cast<int64_t>(protocolVersion))
+    {
+        LOG_DEBUG << "Unsupported version of the persisted query extension";
+        return std::string();
+    }
+
+    auto findHashIt = persistedQuery.find(extensionFieldHash);
+    if (findHashIt == persistedQuery.end() || !findHashIt->is_string())
+    {
+        LOG_DEBUG << "No hash of the persisted query";
+        return std::string();
+    }
+    return findHashIt->get<std::string>();
+}
+
+const std::string GqlPersistedQueries::hashQuery(std::string_view queryText)
+{
+    static constexpr std::string_view hexDigits = "0123456789abcdef";
+
+    std::array<unsigned char, SHA256_DIGEST_LENGTH> digest;
+    SHA256(reinterpret_cast<const unsigned char*>(queryText.data()),
+           queryText.size(), digest.data());
+
+    std::string result;
+    result.reserve(digest.size() * 2);
+    for (auto byte : digest)
+    {
+        result.push_back(hexDigits[byte >> 4U]);
+        result.push_back(hexDigits[byte & 0x0FU]);
+    }
+    return std::forward<std::string>(result);
+}
+
+} // namespace handlers
+} // namespace route
+} // namespace core
+} // namespace app
@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#ifndef __GRAPHQL_PERSISTED_H__
+#define __GRAPHQL_PERSISTED_H__
+
+#include <nlohmann/json.hpp>
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace app
+{
+namespace core
+{
+namespace route
+{
+namespace handlers
+{
+
+/**
+ * @brief The store of the persisted GraphQL queries by the SHA-256 of the
+ *        query text. The store is preloaded from the file on startup and is
+ *        supplemented by the clients: the query text is registered once it
+ *        is sent along with the hash (automatic persisted queries).
+ *
+ * The file is the JSON object of the query texts by the hex hashes:
+ *   { "<sha256>": "<query text>", ... }
+ */
+class GqlPersistedQueries final
+{
+    struct AutomaticQuery
+    {
+        std::string hash;
+        std::string queryText;
+    };
+    using AutomaticList = std::list<AutomaticQuery>;
+
+    std::mutex queriesMutex;
+    std::map<std::string, std::string> preloadedQueries;
+    // The queries registered by the clients, the least recently used one is
+    // evicted when the store is full.
+    AutomaticList automaticQueries;
+    std::unordered_map<std::string, AutomaticList::iterator> automaticIndex;
+
+    GqlPersistedQueries() = default;
+
+  public:
+    static constexpr size_t automaticCapacity = 512;
+    static constexpr size_t protocolVersion = 1;
+    static constexpr const char* extensionFieldVersion = "version";
+    static constexpr const char* extensionFieldHash = "sha256Hash";
+
+    GqlPersistedQueries(const GqlPersistedQueries&) = delete;
+    GqlPersistedQueries& operator=(const GqlPersistedQueries&) = delete;
+    GqlPersistedQueries(GqlPersistedQueries&&) = delete;
+    GqlPersistedQueries& operator=(GqlPersistedQueries&&) = delete;
+    ~GqlPersistedQueries() noexcept = default;
+
+    static GqlPersistedQueries& getInstance()
+    {
+        static GqlPersistedQueries persistedQueries;
+        return persistedQueries;
+    }
+
+    /**
+     * @brief Preload the queries from the file and compile the plans of
+     *        them. The invalid entries are skipped.
+     *
+     * @param path - the path of the persisted queries file
+     * @return size_t - the count of the loaded queries
+     */
+    size_t load(const std::string& path);
+
+    /**
+     * @brief Find the query text by the hash. The found query registered by
+     *        the client is kept as the most recently used one.
+     */
+    const std::optional<std::string> find(const std::string& hash);
+
+    /**
+     * @brief Register the query text sent by the client. The least recently
+     *        used query registered by the clients is evicted when the store
+     *        is full, the preloaded queries are never evicted.
+     *
+     * @param hash      - the hash of the query sent by the client
+     * @param queryText - the query text
+     * @throw exceptions::GqlInvalidArgument - the hash doesn't match the text
+     */
+    void add(const std::string& hash, const std::string& queryText);
+
+    /**
+     * @brief Get the hash of the query requested by the 'persistedQuery'
+     *        extension of the operation request.
+     *
+     * @param persistedQuery - the value of the extension
+     * @return std::string - the requested hash, empty if the extension is
+     *                       malformed or of another protocol version
+     */
+    static const std::string
+        getRequestedHash(const nlohmann::json& persistedQuery);
+
+    /**
+     * @brief Get the lowercase hex SHA-256 of the query text
+     */
+    static const std::string hashQuery(std::string_view queryText);
+};
+
+} // namespace handlers
+} // namespace route
+} // namespace core
+} // namespace app
+
+#endif // __GRAPHQL_PERSISTED_H__
@@ -0,0 +1,919 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#include <core/route/handlers/graphql_handler.hpp>
+#include <core/route/handlers/graphql_plan.hpp>
+#include <logger/logger.hpp>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <functional>
+#include <limits>
+#include <random>
+#include <sstream>
+
+namespace app
+{
+namespace core
+{
+namespace route
+{
+namespace handlers
+{
+
+namespace
+{
+
+constexpr std::string_view blockStringQuote = "\"\"\"";
+constexpr std::string_view punctuators = "{}()[]:=!|";
+
+inline bool isIgnored(char symbol)
+{
+    return symbol == ' ' || symbol == '\t' || symbol == '\n' ||
+           symbol == '\r' || symbol == ',';
+}
+
+inline bool isPunctuator(char symbol)
+{
+    return punctuators.find(symbol) != std::string_view::npos;
+}
+
+using helpers::writer::JsonWriter;
+using FieldType = entity::IEntity::IEntityMember::IInstance::FieldType;
+
+constexpr int cursorBase = 16;
+
+std::size_t parseCursor(const nlohmann::json& cursor)
+{
+    std::size_t instanceHash = 0;
+    if (cursor.is_string())
+    {
+        const auto& cursorText = cursor.get_ref<const std::string&>();
+        const auto* end = cursorText.data() + cursorText.size();
+        auto [parsedEnd, error] = std::from_chars(cursorText.data(), end,
+                                                  instanceHash, cursorBase);
+        if (error == std::errc() && parsedEnd == end)
+        {
+            return instanceHash;
+        }
+    }
+    throw exceptions::GqlInvalidArgument(GqlSelectionArguments::after,
+                                         "Invalid cursor");
+}
+
+/**
+ * @brief Match the text by the pattern with the '*' (any sequence) and the
+ *        '?' (any symbol) wildcards.
+ */
+bool matchWildcard(std::string_view pattern, std::string_view text)
+{
+    size_t patternPos = 0;
+    size_t textPos = 0;
+    size_t starPos = std::string_view::npos;
+    size_t starTextPos = 0;
+    while (textPos < text.size())
+    {
+        if (patternPos < pattern.size() &&
+            (pattern[patternPos] == '?' || pattern[patternPos] == text[textPos]))
+        {
+            patternPos++;
+            textPos++;
+        }
+        else if (patternPos < pattern.size() && pattern[patternPos] == '*')
+        {
+            starPos = patternPos++;
+            starTextPos = textPos;
+        }
+        else if (starPos != std::string_view::npos)
+        {
+            patternPos = starPos + 1;
+            textPos = ++starTextPos;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while (patternPos < pattern.size() && pattern[patternPos] == '*')
+    {
+        patternPos++;
+    }
+    return patternPos == pattern.size();
+}
+
+bool matchFieldValue(const FieldType& fieldValue, const FieldType& expected)
+{
+    return std::visit(
+        [](auto&& actual, auto&& wanted) -> bool {
+            using TActual = std::decay_t<decltype(actual)>;
+            using TWanted = std::decay_t<decltype(wanted)>;
+            if constexpr (std::is_same_v<TActual, std::string> &&
+                          std::is_same_v<TWanted, std::string>)
+            {
+                if (wanted.find_first_of("*?") == std::string::npos)
+                {
+                    return actual == wanted;
+                }
+                return matchWildcard(wanted, actual);
+            }
+            else if constexpr (std::is_same_v<TActual, bool> ||
+                               std::is_same_v<TWanted, bool>)
+            {
+                if constexpr (std::is_same_v<TActual, TWanted>)
+                {
+                    return actual == wanted;
+                }
+                return false;
+            }
+            else if constexpr (std::is_arithmetic_v<TActual> &&
+                               std::is_arithmetic_v<TWanted>)
+            {
+                return static_cast<double>(actual) ==
+                       static_cast<double>(wanted);
+            }
+            return false;
+        },
+        fieldValue, expected);
+}
+
+const FieldType toFieldType(const std::string& memberName,
+                            const nlohmann::json& value)
+{
+    switch (value.type())
+    {
+        case nlohmann::json::value_t::string:
+            return value.get<std::string>();
+        case nlohmann::json::value_t::boolean:
+            return value.get<bool>();
+        case nlohmann::json::value_t::number_integer:
+            return value.get<int64_t>();
+        case nlohmann::json::value_t::number_unsigned:
+            return value.get<uint64_t>();
+        case nlohmann::json::value_t::number_float:
+            return value.get<double>();
+        default:
+            break;
+    }
+    throw exceptions::GqlInvalidArgument(memberName,
+                                         "Unsupported filter value");
+}
+
+/**
+ * @brief Build the entity condition by the filter argument. The condition is
+ *        checked by the entity while the instances are retrieved, so the
+ *        rejected instances are never visited by the result writing.
+ */
+entity::IEntity::ConditionPtr buildCondition(const GqlSelection& selection,
+                                             const nlohmann::json& filter)
+{
+    if (!filter.is_object())
+    {
+        throw exceptions::GqlInvalidArgument(GqlSelectionArguments::filter,
+                                             "The filter must be an object");
+    }
+
+    auto condition = std::make_shared<entity::Entity::Condition>();
+    for (const auto& [memberName, value] : filter.items())
+    {
+        try
+        {
+            selection.entity->getMember(memberName)->markDemanded();
+        }
+        catch (entity::exceptions::EntityException&)
+        {
+            throw exceptions::GqlInvalidArgument(memberName, "Field not found");
+        }
+
+        std::vector<FieldType> alternatives;
+        if (value.is_array())
+        {
+            for (const auto& alternative : value)
+            {
+                alternatives.push_back(toFieldType(memberName, alternative));
+            }
+        }
+        else
+        {
+            alternatives.push_back(toFieldType(memberName, value));
+        }
+        if (alternatives.empty())
+        {
+            throw exceptions::GqlInvalidArgument(memberName,
+                                                 "Empty list of values");
+        }
+
+        // The list of values is matched by any of them, hence the rule
+        // keeps the alternatives by itself.
+        condition->addRule(
+            memberName, alternatives.front(),
+            [alternatives](
+                const entity::IEntity::IEntityMember::InstancePtr& memberInstance,
+                const FieldType&) {
+                return memberInstance &&
+                       std::any_of(alternatives.begin(), alternatives.end(),
+                                   [&memberInstance](const auto& expected) {
+                                       return matchFieldValue(
+                                           memberInstance->getValue(),
+                                           expected);
+                                   });
+            });
+    }
+    return condition;
+}
+
+/**
+ * @brief Validate the pagination arguments
+ */
+const GqlResolvedSelection::Page parsePage(const nlohmann::json& first,
+                                           const nlohmann::json& after)
+{
+    GqlResolvedSelection::Page page;
+    if (!first.is_null())
+    {
+        if (!first.is_number_integer() || first.get<int64_t>() < 0)
+        {
+            throw exceptions::GqlInvalidArgument(
+                GqlSelectionArguments::first,
+                "Must be a non-negative integer");
+        }
+        page.first = first.get<uint64_t>();
+    }
+    if (!after.is_null())
+    {
+        page.after = parseCursor(after);
+    }
+    return page;
+}
+
+/**
+ * @brief Order the instances by the stable cursors
+ */
+void sortByCursor(std::vector<entity::IEntity::InstancePtr>& instances)
+{
+    std::sort(instances.begin(), instances.end(),
+              [](const auto& left, const auto& right) {
+                  return left->getHash() < right->getHash();
+              });
+}
+
+/**
+ * @brief Take the requested page of the instances ordered by the cursors
+ */
+void takePage(std::vector<entity::IEntity::InstancePtr>& instances,
+              const GqlResolvedSelection::Page& page)
+{
+    if (page.after)
+    {
+        instances.erase(
+            instances.begin(),
+            std::upper_bound(instances.begin(), instances.end(), *page.after,
+                             [](std::size_t hash, const auto& instance) {
+                                 return hash < instance->getHash();
+                             }));
+    }
+    if (page.first && *page.first < instances.size())
+    {
+        instances.resize(*page.first);
+    }
+}
+
+/**
+ * @brief Multiply the estimation without the overflow of the pathological
+ *        query.
+ */
+inline std::size_t saturatingMultiply(std::size_t left, std::size_t right)
+{
+    if (left != 0 && right > std::numeric_limits<std::size_t>::max() / left)
+    {
+        return std::numeric_limits<std::size_t>::max();
+    }
+    return left * right;
+}
+
+inline std::size_t saturatingAdd(std::size_t left, std::size_t right)
+{
+    return right > std::numeric_limits<std::size_t>::max() - left
+               ? std::numeric_limits<std::size_t>::max()
+               : left + right;
+}
+
+/**
+ * @brief Estimate the count of the instances written by the object selection:
+ *        the stored instances count bounded by the 'first' argument. The
+ *        filter and the relation are not evaluated, hence the estimation is
+ *        the upper bound.
+ */
+std::size_t estimateInstances(const GqlSelection& selection,
+                              const nlohmann::json& variables)
+{
+    const auto count = selection.entity->getInstancesCount();
+    if (selection.relation)
+    {
+        // The page is taken per the parent instance
+        return count;
+    }
+    auto findFirstIt =
+        selection.arguments.values.find(GqlSelectionArguments::first);
+    if (findFirstIt == selection.arguments.values.end())
+    {
+        return count;
+    }
+    const auto first = findFirstIt->second.resolve(variables);
+    if (!first.is_number_integer() || first.get<int64_t>() < 0)
+    {
+        return count;
+    }
+    return std::min<std::size_t>(count, first.get<uint64_t>());
+}
+
+/**
+ * @brief Accumulate the cost of the object selection into the query cost.
+ *        The unrelated nested selection is written into each parent
+ *        instance, the instances of the related one are split between the
+ *        parent instances.
+ *
+ * @return std::size_t - the estimated output bytes of the selection written
+ *                       once
+ */
+std::size_t estimateSelection(const GqlSelection& selection,
+                              const nlohmann::json& variables,
+                              std::size_t depth, GqlQueryCost& cost)
+{
+    // The average length of the scalar value: the most of the DBus values
+    // are the short strings and the numbers.
+    static constexpr std::size_t scalarValueBytes = 24;
+    // The quotes and the colon of the key, the comma of the member.
+    static constexpr std::size_t memberOverheadBytes = 4;
+    // The brackets of the object or of the array.
+    static constexpr std::size_t bracketsBytes = 2;
+
+    cost.depth = std::max(cost.depth, depth);
+    std::size_t instanceBytes = bracketsBytes;
+    std::size_t relatedBytes = 0;
+    for (const auto& childSelection : selection.selections)
+    {
+        cost.nodes++;
+        instanceBytes = saturatingAdd(
+            instanceBytes,
+            childSelection.responseName.size() + memberOverheadBytes);
+        if (!childSelection.isObject())
+        {
+            instanceBytes = saturatingAdd(instanceBytes, scalarValueBytes);
+            continue;
+        }
+        const auto childBytes =
+            estimateSelection(childSelection, variables, depth + 1, cost);
+        if (childSelection.relation)
+        {
+            instanceBytes = saturatingAdd(instanceBytes, bracketsBytes);
+            relatedBytes = saturatingAdd(relatedBytes, childBytes);
+            continue;
+        }
+        instanceBytes = saturatingAdd(instanceBytes, childBytes);
+    }
+    return saturatingAdd(
+        saturatingAdd(bracketsBytes, relatedBytes),
+        saturatingMultiply(estimateInstances(selection, variables),
+                           instanceBytes));
+}
+
+inline void hashCombine(std::size_t& seed, std::size_t value)
+{
+    seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6U) + (seed >> 2U);
+}
+
+} // namespace
+
+const std::string GqlSelection::formatCursor(std::size_t instanceHash)
+{
+    std::array<char, sizeof(std::size_t) * 2> buffer;
+    auto [end, _] = std::to_chars(buffer.begin(), buffer.end(), instanceHash,
+                                  cursorBase);
+    return std::string(buffer.data(), end);
+}
+
+GqlResolvedSelection
+    GqlResolvedSelection::resolve(
+        const GqlSelection& selection, const nlohmann::json& variables,
+        const std::optional<std::set<std::size_t>>& storedHashes)
+{
+    auto getArgument = [&selection, &variables](const char* name) {
+        const auto& values = selection.arguments.values;
+        auto findArgumentIt = values.find(name);
+        return findArgumentIt == values.end()
+                   ? nlohmann::json()
+                   : findArgumentIt->second.resolve(variables);
+    };
+
+    entity::IEntity::ConditionPtr condition;
+    const auto filter = getArgument(GqlSelectionArguments::filter);
+    if (!filter.is_null())
+    {
+        condition = buildCondition(selection, filter);
+    }
+
+    // The members read by the query are kept fetched by the brokers, the
+    // supplement providers of them are kept applied by the entity.
+    if (selection.relation)
+    {
+        selection.relation->markDemanded();
+    }
+    for (const auto& childSelection : selection.selections)
+    {
+        if (childSelection.member)
+        {
+            childSelection.member->markDemanded();
+        }
+    }
+
+    GqlResolvedSelection resolved{
+        selection,
+        storedHashes ? selection.entity->getInstances(condition, *storedHashes)
+                     : selection.entity->getInstances(condition),
+        {},
+        parsePage(getArgument(GqlSelectionArguments::first),
+                  getArgument(GqlSelectionArguments::after)),
+        {}};
+    if (!resolved.page.empty())
+    {
+        sortByCursor(resolved.instances);
+    }
+    // The related instances are joined to each parent instance while the
+    // result is written, hence the page is taken per the parent.
+    if (!selection.relation)
+    {
+        takePage(resolved.instances, resolved.page);
+    }
+
+    // The candidates of the nested objects do not depend on the instance of
+    // the parent object, hence they are resolved once per the selection set.
+    for (const auto& childSelection : selection.selections)
+    {
+        if (childSelection.isObject())
+        {
+            resolved.nestedObjects.push_back(
+                resolve(childSelection, variables));
+        }
+    }
+    return resolved;
+}
+
+void GqlResolvedSelection::write(JsonWriter& writer) const
+{
+    writeInstances(writer, instances);
+}
+
+void GqlResolvedSelection::writeInstances(
+    JsonWriter& writer,
+    const std::vector<entity::IEntity::InstancePtr>& instancesList) const
+{
+    if (instancesList.empty())
+    {
+        writer.beginObject();
+        writer.endObject();
+        return;
+    }
+
+    const bool isList = instancesList.size() > 1;
+    if (isList)
+    {
+        writer.beginArray();
+    }
+    for (const auto& instance : instancesList)
+    {
+        writeInstance(writer, instance);
+    }
+    if (isList)
+    {
+        writer.endArray();
+    }
+}
+
+void GqlResolvedSelection::writeNested(
+    JsonWriter& writer, const entity::IEntity::InstancePtr& parent) const
+{
+    // The unrelated nested selection is the same for each parent
+    const auto* rendered = &instances;
+    std::vector<entity::IEntity::InstancePtr> related;
+    // The rendering is indented by the depth of the writer
+    RenderingKey renderingKey{writer.getDepth(), {}};
+    if (selection.relation)
+    {
+        related = getRelated(parent);
+        rendered = &related;
+        auto& instanceHashes = renderingKey.second;
+        instanceHashes.reserve(related.size());
+        for (const auto& instance : related)
+        {
+            instanceHashes.push_back(instance->getHash());
+        }
+        std::sort(instanceHashes.begin(), instanceHashes.end());
+    }
+
+    auto findRenderingIt = renderings.find(renderingKey);
+    if (findRenderingIt == renderings.end())
+    {
+        std::ostringstream rendering;
+        JsonWriter renderingWriter(rendering, writer.getIndent(),
+                                   writer.getDepth());
+        writeInstances(renderingWriter, *rendered);
+        findRenderingIt = renderings
+                              .emplace(std::move(renderingKey),
+                                       std::move(rendering).str())
+                              .first;
+    }
+    writer.rawValue(findRenderingIt->second);
+}
+
+const std::vector<entity::IEntity::InstancePtr>
+    GqlResolvedSelection::getRelated(
+        const entity::IEntity::InstancePtr& parent) const
+{
+    if (!selection.relation)
+    {
+        return instances;
+    }
+
+    std::vector<entity::IEntity::InstancePtr> related;
+    for (const auto& instance : instances)
+    {
+        if (selection.relation->isRelated(parent, instance))
+        {
+            related.push_back(instance);
+        }
+    }
+    takePage(related, page);
+    return std::forward<std::vector<entity::IEntity::InstancePtr>>(related);
+}
+
+void GqlResolvedSelection::writeInstance(
+    JsonWriter& writer, const entity::IEntity::InstancePtr& instance) const
+{
+    writer.beginObject();
+    auto nestedObjectIt = nestedObjects.begin();
+    for (const auto& childSelection : selection.selections)
+    {
+        writer.key(childSelection.responseName);
+        if (childSelection.isObject())
+        {
+            (nestedObjectIt++)->writeNested(writer, instance);
+            continue;
+        }
+        if (childSelection.isCursor())
+        {
+            writer.value(GqlSelection::formatCursor(instance->getHash()));
+            continue;
+        }
+        writer.value(instance->getField(childSelection.member)->getValue());
+    }
+    writer.endObject();
+}
+
+std::size_t GqlResolvedSelection::hashInstance(
+    const entity::IEntity::InstancePtr& instance) const
+{
+    std::size_t seed = instance->getHash();
+    auto nestedObjectIt = nestedObjects.begin();
+    for (const auto& childSelection : selection.selections)
+    {
+        if (childSelection.isObject())
+        {
+            for (const auto& nestedInstance :
+                 nestedObjectIt->getRelated(instance))
+            {
+                hashCombine(seed, nestedObjectIt->hashInstance(nestedInstance));
+            }
+            nestedObjectIt++;
+        }
+        else if (childSelection.member)
+        {
+            hashCombine(seed, std::hash<FieldType>{}(
+                                  instance->getField(childSelection.member)
+                                      ->getValue()));
+        }
+    }
+    return seed;
+}
+
+GqlQueryPlan::Operation&
+    GqlQueryPlan::addOperation(const std::string& name,
+                               const std::string& operationName)
+{
+    return operations.emplace_back(Operation{name, {}, {}, operationName});
+}
+
+const std::vector<GqlQueryPlan::Operation>&
+    GqlQueryPlan::getOperations() const
+{
+    return operations;
+}
+
+const GqlQueryPlan::Operation&
+    GqlQueryPlan::getOperation(const std::string& operationName) const
+{
+    if (operationName.empty())
+    {
+        if (operations.size() != 1)
+        {
+            throw exceptions::GqlInvalidArgument(
+                operationNameField,
+                "The operation name is required by the document of several "
+                "operations");
+        }
+        return operations.front();
+    }
+
+    auto findOperationIt = std::find_if(
+        operations.begin(), operations.end(),
+        [&operationName](const auto& operation) {
+            return operation.operationName == operationName;
+        });
+    if (findOperationIt == operations.end())
+    {
+        throw exceptions::GqlInvalidArgument(operationNameField,
+                                             "Unknown operation");
+    }
+    return *findOperationIt;
+}
+
+const std::string
+    GqlQueryPlan::getEntityTag(std::size_t representation,
+                               const std::string& operationName) const
+{
+    static constexpr int entityTagBase = 16;
+    // The entities versions are restarted by the process restart. Hence the
+    // tags of the previous process run must not match the actual tags.
+    static const std::size_t processEpoch = std::random_device{}();
+
+    std::size_t seed = processEpoch;
+    hashCombine(seed, queryHash);
+    hashCombine(seed, representation);
+    const auto& operation = getOperation(operationName);
+    hashCombine(seed, std::hash<std::string>{}(operation.operationName));
+    for (const auto& selection : operation.selections)
+    {
+        hashCombine(seed, getVersionsHash(selection));
+    }
+
+    std::array<char, sizeof(std::size_t) * 2> buffer;
+    auto [end, _] =
+        std::to_chars(buffer.begin(), buffer.end(), seed, entityTagBase);
+    return std::string(buffer.data(), end);
+}
+
+std::size_t GqlQueryPlan::getVersionsHash(const GqlSelection& selection)
+{
+    std::size_t seed = selection.entity->getVersion();
+    for (const auto& childSelection : selection.selections)
+    {
+        if (childSelection.isObject())
+        {
+            hashCombine(seed, getVersionsHash(childSelection));
+        }
+    }
+    return seed;
+}
+
+std::size_t GqlQueryPlan::getStructureHash(const GqlSelection& selection)
+{
+    std::size_t seed = selection.entity->getStructureVersion();
+    for (const auto& childSelection : selection.selections)
+    {
+        if (childSelection.isObject())
+        {
+            hashCombine(seed, getVersionsHash(childSelection));
+        }
+    }
+    return seed;
+}
+
+bool GqlQueryPlan::isSubscription(const std::string& operationName) const
+{
+    return getOperation(operationName).name == subscriptionOperation;
+}
+
+const nlohmann::json
+    GqlQueryPlan::getOperationVariables(const Operation& operation,
+                                        const nlohmann::json& variables)
+{
+    // The undefined variables are ignored, the missed ones take the default
+    // value.
+    auto result = nlohmann::json::object();
+    for (const auto& [name, defaultValue] : operation.variables)
+    {
+        auto findVariableIt = variables.find(name);
+        result[name] =
+            findVariableIt != variables.end() ? *findVariableIt : defaultValue;
+    }
+    return std::forward<nlohmann::json>(result);
+}
+
+GqlQueryResultPtr
+    GqlQueryPlan::execute(const nlohmann::json& variables,
+                          const std::string& operationName) const
+{
+    const auto& operation = getOperation(operationName);
+    auto result = std::make_shared<GqlQueryResult>(shared_from_this());
+    const auto operationVariables = getOperationVariables(operation, variables);
+    auto& operationResult = result->addOperation(operation.name);
+    // The root selections are always objects, it is checked by the plan
+    // compilation.
+    for (const auto& selection : operation.selections)
+    {
+        operationResult.second.push_back(
+            GqlResolvedSelection::resolve(selection, operationVariables));
+    }
+    return result;
+}
+
+GqlQueryCost
+    GqlQueryPlan::estimateCost(const nlohmann::json& variables,
+                               const std::string& operationName) const
+{
+    const auto& operation = getOperation(operationName);
+    const auto operationVariables = getOperationVariables(operation, variables);
+    GqlQueryCost cost;
+    for (const auto& selection : operation.selections)
+    {
+        cost.nodes++;
+        cost.outputBytes = saturatingAdd(
+            cost.outputBytes,
+            estimateSelection(selection, operationVariables, 1, cost));
+    }
+    return cost;
+}
+
+GqlQueryCost GqlQueryPlan::checkCost(const nlohmann::json& variables,
+                                     const std::string& operationName) const
+{
+    const auto cost = estimateCost(variables, operationName);
+    LOG_DEBUG << "GraphQL query cost: depth=" << cost.depth
+              << ", nodes=" << cost.nodes
+              << ", output bytes=" << cost.outputBytes;
+    if (cost.depth > GqlQueryCost::maxDepth)
+    {
+        throw exceptions::GqlCostExceeded("depth", cost.depth,
+                                          GqlQueryCost::maxDepth);
+    }
+    if (cost.nodes > GqlQueryCost::maxNodes)
+    {
+        throw exceptions::GqlCostExceeded("nodes", cost.nodes,
+                                          GqlQueryCost::maxNodes);
+    }
+    if (cost.outputBytes > GqlQueryCost::maxOutputBytes)
+    {
+        throw exceptions::GqlCostExceeded("outputBytes", cost.outputBytes,
+                                          GqlQueryCost::maxOutputBytes);
+    }
+    return cost;
+}
+
+const nlohmann::json
+    GqlArgumentValue::resolve(const nlohmann::json& requestVariables) const
+{
+    auto result = literal;
+    for (const auto& [pointer, name] : variables)
+    {
+        auto findVariableIt = requestVariables.find(name);
+        result[pointer] = findVariableIt != requestVariables.end()
+                              ? *findVariableIt
+                              : nlohmann::json();
+    }
+    return std::forward<nlohmann::json>(result);
+}
+
+GqlQueryResult::OperationResult&
+    GqlQueryResult::addOperation(const std::string& name)
+{
+    return operations.emplace_back(OperationResult{name, {}});
+}
+
+void GqlQueryResult::write(JsonWriter& writer) const
+{
+    writer.beginObject();
+    for (const auto& [name, selections] : operations)
+    {
+        writer.key(name);
+        writer.beginObject();
+        for (const auto& resolved : selections)
+        {
+            writer.key(resolved.selection.responseName);
+            resolved.write(writer);
+        }
+        writer.endObject();
+    }
+    writer.endObject();
+}
+
+GqlQueryPlanPtr GqlPlanCache::getPlan(const std::string& queryText)
+{
+    const auto normalizedText = normalize(queryText);
+    const auto hash = std::hash<std::string>{}(normalizedText);
+
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto findEntryIt = entriesIndex.find(hash);
+        if (findEntryIt != entriesIndex.end() &&
+            findEntryIt->second->queryText == normalizedText)
+        {
+            entries.splice(entries.begin(), entries, findEntryIt->second);
+            hits++;
+            return findEntryIt->second->plan;
+        }
+    }
+    misses++;
+
+    LOG_DEBUG << "GraphQL plan cache miss. Compile the query";
+    auto plan = compile(normalizedText);
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto findEntryIt = entriesIndex.find(hash);
+    if (findEntryIt != entriesIndex.end())
+    {
+        entries.erase(findEntryIt->second);
+        entriesIndex.erase(findEntryIt);
+    }
+    if (entries.size() >= capacity)
+    {
+        entriesIndex.erase(entries.back().hash);
+        entries.pop_back();
+    }
+    entries.push_front(CacheEntry{hash, normalizedText, plan});
+    entriesIndex.emplace(hash, entries.begin());
+
+    return plan;
+}
+
+const std::string GqlPlanCache::normalize(std::string_view queryText)
+{
+    std::string result;
+    result.reserve(queryText.size());
+
+    bool pendingSpace = false;
+    auto appendToken = [&result, &pendingSpace](std::string_view token) {
+        if (pendingSpace && !result.empty() && !isPunctuator(result.back()) &&
+            !isPunctuator(token.front()))
+        {
+            result.push_back(' ');
+        }
+        pendingSpace = false;
+        result.append(token);
+    };
+
+    size_t position = 0;
+    while (position < queryText.size())
+    {
+        const char symbol = queryText[position];
+        if (isIgnored(symbol))
+        {
+            pendingSpace = true;
+            position++;
+        }
+        else if (symbol == '#')
+        {
+            position = queryText.find_first_of("\r\n", position);
+            position =
+                position == std::string_view::npos ? queryText.size() : position;
+            pendingSpace = true;
+        }
+        else if (queryText.substr(position, blockStringQuote.size()) ==
+                 blockStringQuote)
+        {
+            auto end = position + blockStringQuote.size();
+            while ((end = queryText.find(blockStringQuote, end)) !=
+                       std::string_view::npos &&
+                   queryText[end - 1] == '\\')
+            {
+                end++;
+            }
+            end = end == std::string_view::npos
+                      ? queryText.size()
+                      : end + blockStringQuote.size();
+            appendToken(queryText.substr(position, end - position));
+            position = end;
+        }
+        else if (symbol == '"')
+        {
+            auto end = position + 1;
+            while (end < queryText.size() && queryText[end] != '"')
+            {
+                end += queryText[end] == '\\' ? 2 : 1;
+            }
+            end = std::min(end + 1, queryText.size());
+            appendToken(queryText.substr(position, end - position));
+            position = end;
+        }
+        else
+        {
+            appendToken(queryText.substr(position, 1));
+            position++;
+        }
+    }
+    return std::forward<std::string>(result);
+}
+
+} // namespace handlers
+} // namespace route
+} // namespace core
+} // namespace app
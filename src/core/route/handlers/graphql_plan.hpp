@@ -0,0 +1,475 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#ifndef __GRAPHQL_PLAN_H__
+#define __GRAPHQL_PLAN_H__
+
+#include <config.h>
+
+#include <core/entity/entity.hpp>
+#include <core/helpers/json_writer.hpp>
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace app
+{
+namespace core
+{
+namespace route
+{
+namespace handlers
+{
+
+class GqlQueryPlan;
+
+using GqlQueryPlanPtr = std::shared_ptr<const GqlQueryPlan>;
+
+/**
+ * @brief The compiled GraphQL argument value. The literal parts are kept as
+ *        is, the variables are substituted by the values of the request.
+ */
+struct GqlArgumentValue
+{
+    using VariableBinding = std::pair<nlohmann::json::json_pointer, std::string>;
+
+    nlohmann::json literal;
+    std::vector<VariableBinding> variables;
+
+    const nlohmann::json resolve(const nlohmann::json& requestVariables) const;
+};
+
+/**
+ * @brief The arguments of the object selection:
+ *        filter - the object of the members values to match. The string
+ *                 value might contain '*' and '?' wildcards, the list value
+ *                 matches any of the listed values.
+ *        first  - the maximum count of the instances to return.
+ *        after  - the cursor of the instance to return the instances after.
+ */
+struct GqlSelectionArguments
+{
+    static constexpr const char* filter = "filter";
+    static constexpr const char* first = "first";
+    static constexpr const char* after = "after";
+
+    std::map<std::string, GqlArgumentValue> values;
+
+    bool empty() const
+    {
+        return values.empty();
+    }
+};
+
+/**
+ * @brief The compiled GraphQL field selection. The object selections keep the
+ *        resolved entity, the scalar selections keep the resolved member of
+ *        the entity of the parent selection. The scalar selection without
+ *        the member is the cursor of the instance. The nested object
+ *        selection keeps the relation of the parent entity to the selected
+ *        one, if the entities are related.
+ */
+struct GqlSelection
+{
+    static constexpr const char* cursorField = "_cursor";
+
+    std::string fieldName;
+    std::string responseName;
+    entity::EntityPtr entity;
+    entity::IEntity::EntityMemberPtr member;
+    std::vector<GqlSelection> selections;
+    GqlSelectionArguments arguments;
+    entity::IEntity::RelationPtr relation;
+
+    bool isObject() const
+    {
+        return static_cast<bool>(entity);
+    }
+
+    bool isCursor() const
+    {
+        return !entity && !member;
+    }
+
+    /**
+     * @brief Get the cursor of the instance by the instance hash
+     */
+    static const std::string formatCursor(std::size_t instanceHash);
+};
+
+/**
+ * @brief The object selection bound to the entity instances which match the
+ *        selection arguments. The instances of the related nested selection
+ *        are the candidates which are joined to each parent instance by the
+ *        relation, the page is taken per the parent instance.
+ */
+struct GqlResolvedSelection
+{
+    struct Page
+    {
+        std::optional<std::size_t> first;
+        std::optional<std::size_t> after;
+
+        bool empty() const
+        {
+            return !first && !after;
+        }
+    };
+
+    const GqlSelection& selection;
+    std::vector<entity::IEntity::InstancePtr> instances;
+    std::vector<GqlResolvedSelection> nestedObjects;
+    Page page;
+    // The rendered nested selection by the depth of the writer and the
+    // sorted hashes of the rendered instances. The same children of the
+    // several parents are rendered once.
+    using RenderingKey = std::pair<std::size_t, std::vector<std::size_t>>;
+    mutable std::map<RenderingKey, std::string> renderings;
+
+    /**
+     * @brief Retrieve the instances of the object selection and of the
+     *        nested object selections.
+     *
+     * @param selection    - the object selection
+     * @param variables    - the variables of the operation
+     * @param storedHashes - if set, only the instances expanded from the
+     *                       stored instances of the hashes are retrieved for
+     *                       the selection itself
+     * @throw exceptions::GqlException - the arguments are invalid
+     */
+    static GqlResolvedSelection resolve(
+        const GqlSelection& selection, const nlohmann::json& variables,
+        const std::optional<std::set<std::size_t>>& storedHashes =
+            std::nullopt);
+
+    /**
+     * @brief Write the selection: the single instance is written as the
+     *        object, the few instances are written as the array.
+     */
+    void write(helpers::writer::JsonWriter& writer) const;
+    /**
+     * @brief Write the nested selection of the parent instance. The
+     *        rendering is reused for the parents of the same children.
+     */
+    void writeNested(helpers::writer::JsonWriter& writer,
+                     const entity::IEntity::InstancePtr& parent) const;
+    /**
+     * @brief Get the instances of the nested selection which are related to
+     *        the parent instance.
+     */
+    const std::vector<entity::IEntity::InstancePtr>
+        getRelated(const entity::IEntity::InstancePtr& parent) const;
+    /**
+     * @brief Write the object of the selected fields of the instance
+     */
+    void writeInstance(helpers::writer::JsonWriter& writer,
+                       const entity::IEntity::InstancePtr& instance) const;
+    /**
+     * @brief Get the hash of the written representation of the instance,
+     *        including the nested objects.
+     */
+    std::size_t hashInstance(const entity::IEntity::InstancePtr& instance) const;
+
+  protected:
+    void writeInstances(
+        helpers::writer::JsonWriter& writer,
+        const std::vector<entity::IEntity::InstancePtr>& instancesList) const;
+};
+
+/**
+ * @brief The result of the plan execution. The instances of each selection
+ *        set are retrieved by the execution, the fields values are read
+ *        only while the result is written.
+ */
+class GqlQueryResult final
+{
+  public:
+    using OperationResult =
+        std::pair<std::string, std::vector<GqlResolvedSelection>>;
+
+    GqlQueryResult(const GqlQueryResult&) = delete;
+    GqlQueryResult& operator=(const GqlQueryResult&) = delete;
+    GqlQueryResult(GqlQueryResult&&) = delete;
+    GqlQueryResult& operator=(GqlQueryResult&&) = delete;
+
+    explicit GqlQueryResult(const GqlQueryPlanPtr& sourcePlan) :
+        plan(sourcePlan)
+    {}
+    ~GqlQueryResult() noexcept = default;
+
+    OperationResult& addOperation(const std::string&);
+
+    /**
+     * @brief Stream the result object by the operations into the writer.
+     *
+     * @param writer - the JSON writer to stream the result
+     */
+    void write(helpers::writer::JsonWriter& writer) const;
+
+  private:
+    // The resolved selections refer to the plan, hence it is kept alive.
+    const GqlQueryPlanPtr plan;
+    std::vector<OperationResult> operations;
+};
+
+using GqlQueryResultPtr = std::shared_ptr<const GqlQueryResult>;
+
+/**
+ * @brief The estimated cost of the GraphQL plan execution. The nested object
+ *        selection is written into each instance of the parent selection,
+ *        hence the estimated output is multiplied through the nesting.
+ */
+struct GqlQueryCost
+{
+    static constexpr std::size_t maxDepth = BMC_GQL_MAX_DEPTH;
+    static constexpr std::size_t maxNodes = BMC_GQL_MAX_NODES;
+    static constexpr std::size_t maxOutputBytes =
+        static_cast<std::size_t>(BMC_GQL_MAX_OUTPUT_KB) * 1024;
+
+    // The maximum nesting of the object selections
+    std::size_t depth = 0;
+    // The count of the selected fields of all selection sets
+    std::size_t nodes = 0;
+    // The estimated size of the compact JSON result
+    std::size_t outputBytes = 0;
+};
+
+/**
+ * @brief The validated execution plan of the GraphQL document. The plan does
+ *        not depend on the entities instances, hence it might be reused by
+ *        any request of the same query text.
+ */
+class GqlQueryPlan final : public std::enable_shared_from_this<GqlQueryPlan>
+{
+  public:
+    static constexpr const char* subscriptionOperation = "subscription";
+    static constexpr const char* operationNameField = "operationName";
+
+    struct Operation
+    {
+        // The type of the operation, e.g. 'query'
+        std::string name;
+        std::vector<GqlSelection> selections;
+        // The default values of the defined variables, null if no default.
+        std::map<std::string, nlohmann::json> variables;
+        // The name of the operation in the document, empty if anonymous
+        std::string operationName;
+    };
+
+    GqlQueryPlan(const GqlQueryPlan&) = delete;
+    GqlQueryPlan& operator=(const GqlQueryPlan&) = delete;
+    GqlQueryPlan(GqlQueryPlan&&) = delete;
+    GqlQueryPlan& operator=(GqlQueryPlan&&) = delete;
+
+    explicit GqlQueryPlan(std::size_t normalizedQueryHash) noexcept :
+        queryHash(normalizedQueryHash)
+    {}
+    ~GqlQueryPlan() noexcept = default;
+
+    Operation& addOperation(const std::string& name,
+                            const std::string& operationName);
+    const std::vector<Operation>& getOperations() const;
+
+    /**
+     * @brief Get the operation requested to execute. The document of the
+     *        single operation might be executed without the name.
+     *
+     * @param operationName - the requested operation name, might be empty
+     * @return const Operation& - the operation to execute
+     * @throw exceptions::GqlInvalidArgument - the name is unknown, or it is
+     *                                         omitted for the document of
+     *                                         several operations
+     */
+    const Operation& getOperation(const std::string& operationName) const;
+
+    /**
+     * @brief Get the entity tag of the plan result. The tag is derived from
+     *        the query and the versions of the entities read by the plan,
+     *        hence it is changed once any of the read entities is changed.
+     *
+     * @param representation - the hash of the result representation, e.g.
+     *                         the output indentation
+     * @param operationName  - the name of the executed operation
+     * @return const std::string - the opaque tag, the hex of the whole hash
+     */
+    const std::string getEntityTag(std::size_t representation,
+                                   const std::string& operationName) const;
+
+    /**
+     * @brief Whether the requested operation is the subscription.
+     */
+    bool isSubscription(const std::string& operationName) const;
+
+    /**
+     * @brief Get the variables of the operation: the request variables which
+     *        are defined by the operation, or the default values of them.
+     */
+    static const nlohmann::json
+        getOperationVariables(const Operation& operation,
+                              const nlohmann::json& variables);
+
+    /**
+     * @brief Get the hash of the data versions of the entities read by the
+     *        object selection and the nested selections.
+     */
+    static std::size_t getVersionsHash(const GqlSelection& selection);
+    /**
+     * @brief Get the hash of the data versions like getVersionsHash() does,
+     *        but the instances of the selection entity changed in place are
+     *        not counted.
+     */
+    static std::size_t getStructureHash(const GqlSelection& selection);
+
+    /**
+     * @brief Execute the plan against the actual entities instances: the
+     *        instances are filtered and paginated by the selections
+     *        arguments.
+     *
+     * @param variables     - the variables of the request
+     * @param operationName - the name of the operation to execute
+     * @return GqlQueryResultPtr - the result to write
+     * @throw exceptions::GqlException - the arguments are invalid
+     */
+    GqlQueryResultPtr execute(const nlohmann::json& variables,
+                              const std::string& operationName) const;
+
+    /**
+     * @brief Estimate the cost of the plan execution by the actual count of
+     *        the entities instances and the selection sets sizes. The
+     *        instances are not retrieved.
+     *
+     * @param variables     - the variables of the request
+     * @param operationName - the name of the operation to execute
+     * @return GqlQueryCost - the estimated cost
+     */
+    GqlQueryCost estimateCost(const nlohmann::json& variables,
+                              const std::string& operationName) const;
+
+    /**
+     * @brief Reject the plan before the execution if the estimated cost
+     *        exceeds any of the configured limits.
+     *
+     * @param variables     - the variables of the request
+     * @param operationName - the name of the operation to execute
+     * @return GqlQueryCost - the estimated cost
+     * @throw exceptions::GqlCostExceeded - the cost limit is exceeded
+     */
+    GqlQueryCost checkCost(const nlohmann::json& variables,
+                           const std::string& operationName) const;
+
+  private:
+    const std::size_t queryHash;
+    std::vector<Operation> operations;
+};
+
+/**
+ * @brief The bounded LRU cache of the compiled GraphQL plans by the
+ *        normalized query text.
+ */
+class GqlPlanCache final
+{
+    static constexpr size_t capacity = 64;
+
+    struct CacheEntry
+    {
+        std::size_t hash;
+        std::string queryText;
+        GqlQueryPlanPtr plan;
+    };
+    using CacheList = std::list<CacheEntry>;
+
+    std::mutex cacheMutex;
+    CacheList entries;
+    std::unordered_map<std::size_t, CacheList::iterator> entriesIndex;
+
+    GqlPlanCache() = default;
+
+  public:
+    GqlPlanCache(const GqlPlanCache&) = delete;
+    GqlPlanCache& operator=(const GqlPlanCache&) = delete;
+    GqlPlanCache(GqlPlanCache&&) = delete;
+    GqlPlanCache& operator=(GqlPlanCache&&) = delete;
+    ~GqlPlanCache() noexcept = default;
+
+    static GqlPlanCache& getInstance()
+    {
+        static GqlPlanCache planCache;
+        return planCache;
+    }
+
+    /**
+     * @brief Get the compiled plan of the query. The query is parsed and
+     *        compiled on the cache miss.
+     *
+     * @param queryText - the GraphQL document text
+     * @return GqlQueryPlanPtr - the compiled plan
+     * @throw exceptions::GqlException - the query is invalid
+     */
+    GqlQueryPlanPtr getPlan(const std::string& queryText);
+
+    /**
+     * @brief The count of the queries parsed while another query was being
+     *        parsed by a concurrent thread.
+     */
+    static size_t getContendedParses()
+    {
+        return contendedParses;
+    }
+
+    /**
+     * @brief The maximum count of the queries parsed concurrently.
+     */
+    static size_t getPeakParsesInFlight()
+    {
+        return peakParsesInFlight;
+    }
+
+    static size_t getHits()
+    {
+        return hits;
+    }
+
+    static size_t getMisses()
+    {
+        return misses;
+    }
+
+    /**
+     * @brief Normalize the query text: drop the comments, the insignificant
+     *        commas and whitespaces, keeping the strings as is.
+     */
+    static const std::string normalize(std::string_view queryText);
+
+  protected:
+    /**
+     * @brief Parse the query and build the plan of it. The plan is built by
+     *        the visitor of the GraphQL router, hence it's defined along with
+     *        the visitor.
+     */
+    static GqlQueryPlanPtr compile(const std::string& queryText);
+
+  private:
+    static inline std::atomic_size_t parsesInFlight{0};
+    static inline std::atomic_size_t peakParsesInFlight{0};
+    static inline std::atomic_size_t contendedParses{0};
+    static inline std::atomic_size_t hits{0};
+    static inline std::atomic_size_t misses{0};
+};
+
+} // namespace handlers
+} // namespace route
+} // namespace core
+} // namespace app
+
+#endif // __GRAPHQL_PLAN_H__
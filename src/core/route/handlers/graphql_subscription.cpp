@@ -0,0 +1,380 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#include <core/entity/entity.hpp>
+#include <core/helpers/json_writer.hpp>
+#include <core/route/handlers/graphql_handler.hpp>
+#include <core/route/handlers/graphql_subscription.hpp>
+#include <logger/logger.hpp>
+
+#include <algorithm>
+#include <thread>
+
+namespace app
+{
+namespace core
+{
+namespace route
+{
+namespace handlers
+{
+
+using helpers::writer::JsonWriter;
+
+GqlSubscription::~GqlSubscription() noexcept
+{
+    activeSubscriptions--;
+}
+
+GqlSubscriptionPtr GqlSubscription::create(const GqlQueryPlanPtr& plan,
+                                           const nlohmann::json& variables,
+                                           const std::string& operationName)
+{
+    const auto& operation = plan->getOperation(operationName);
+
+    if (++activeSubscriptions > maxSubscriptions)
+    {
+        activeSubscriptions--;
+        LOG_WARNING << "The limit of the GraphQL subscriptions is reached";
+        return nullptr;
+    }
+
+    GqlSubscriptionPtr subscription(new GqlSubscription(
+        plan, operation,
+        GqlQueryPlan::getOperationVariables(operation, variables)));
+    subscription->states.resize(operation.selections.size());
+    // The changes made while the initial result is resolved are collected
+    // by the next event.
+    subscription->seenGeneration =
+        entity::EntityChangeNotifier::getInstance().getGeneration();
+    subscription->initialChanges = subscription->collectChanges(true);
+    return subscription;
+}
+
+void GqlSubscription::start(Wakeup streamWakeup)
+{
+    wakeup = std::move(streamWakeup);
+    GqlSubscriptionDispatcher::getInstance().add(shared_from_this());
+}
+
+bool GqlSubscription::writeNext(std::ostream& output)
+{
+    const auto now = std::chrono::steady_clock::now();
+    try
+    {
+        if (!isStarted)
+        {
+            isStarted = true;
+            writeEvent(output, initialChanges, true);
+            initialChanges.clear();
+            return !output.good();
+        }
+        if (now >= deadline)
+        {
+            LOG_DEBUG << "GraphQL subscription is completed";
+            return true;
+        }
+
+        const auto generation =
+            entity::EntityChangeNotifier::getInstance().getGeneration();
+        if (generation != seenGeneration)
+        {
+            seenGeneration = generation;
+            const auto changes = collectChanges(false);
+            if (!changes.empty())
+            {
+                writeEvent(output, changes, false);
+                heartbeatTime = now + heartbeatInterval;
+            }
+        }
+        if (now >= heartbeatTime.load())
+        {
+            // The comment line keeps the idle connection alive
+            output << ":\n\n";
+            heartbeatTime = now + heartbeatInterval;
+        }
+    }
+    catch (std::exception& ex)
+    {
+        LOG_ERROR << "GraphQL subscription is aborted: " << ex.what();
+        return true;
+    }
+    return !output.good();
+}
+
+bool GqlSubscription::isDue(std::chrono::steady_clock::time_point now) const
+{
+    return now >= deadline || now >= heartbeatTime.load();
+}
+
+GqlSubscription::Changes GqlSubscription::collectChanges(bool isInitial)
+{
+    Changes changes;
+    const auto& selections = operation.selections;
+    for (size_t index = 0; index < selections.size(); index++)
+    {
+        const auto& selection = selections[index];
+        auto& state = states[index];
+
+        // The log is read after the versions: the change made in between is
+        // collected twice at most, but it is never lost.
+        const auto versionsHash = GqlQueryPlan::getVersionsHash(selection);
+        const auto structureHash = GqlQueryPlan::getStructureHash(selection);
+        const auto changedInstances =
+            selection.entity->getChangedInstances(state.changesPosition);
+        if (!isInitial && versionsHash == state.versionsHash)
+        {
+            continue;
+        }
+
+        // The page is taken from all the instances, hence it can't be
+        // updated by the changed ones.
+        const auto& arguments = selection.arguments.values;
+        const bool isPaged =
+            arguments.count(GqlSelectionArguments::first) != 0 ||
+            arguments.count(GqlSelectionArguments::after) != 0;
+        const bool isInPlace = !isInitial && changedInstances &&
+                               !state.hasComplex && !isPaged &&
+                               structureHash == state.structureHash;
+        state.versionsHash = versionsHash;
+        state.structureHash = structureHash;
+
+        auto selectionChanges =
+            isInPlace
+                ? collectInstancesChanges(selection, state, *changedInstances)
+                : collectSelectionChanges(selection, state);
+        if (isInitial || !selectionChanges.changed.empty() ||
+            !selectionChanges.removed.empty())
+        {
+            changes.push_back(std::move(selectionChanges));
+        }
+    }
+    return changes;
+}
+
+GqlSubscription::SelectionChanges
+    GqlSubscription::collectSelectionChanges(const GqlSelection& selection,
+                                             SelectionState& state) const
+{
+    SelectionChanges selectionChanges{
+        GqlResolvedSelection::resolve(selection, variables), {}, {}};
+    std::map<std::size_t, std::size_t> fingerprints;
+    state.hasComplex = false;
+    for (const auto& instance : selectionChanges.resolved.instances)
+    {
+        const auto fingerprint =
+            selectionChanges.resolved.hashInstance(instance);
+        fingerprints.emplace(instance->getHash(), fingerprint);
+        if (!selection.entity->getInstance(instance->getHash()))
+        {
+            state.hasComplex = true;
+        }
+
+        auto findFingerprintIt = state.fingerprints.find(instance->getHash());
+        if (findFingerprintIt == state.fingerprints.end() ||
+            findFingerprintIt->second != fingerprint)
+        {
+            selectionChanges.changed.push_back(instance);
+        }
+    }
+    for (const auto& [instanceHash, _] : state.fingerprints)
+    {
+        if (fingerprints.count(instanceHash) == 0)
+        {
+            selectionChanges.removed.push_back(instanceHash);
+        }
+    }
+    state.fingerprints.swap(fingerprints);
+    return selectionChanges;
+}
+
+GqlSubscription::SelectionChanges GqlSubscription::collectInstancesChanges(
+    const GqlSelection& selection, SelectionState& state,
+    const std::set<std::size_t>& instances) const
+{
+    SelectionChanges selectionChanges{
+        GqlResolvedSelection::resolve(selection, variables, instances), {},
+        {}};
+    const auto& resolvedInstances = selectionChanges.resolved.instances;
+    const bool hasComplex =
+        std::any_of(resolvedInstances.begin(), resolvedInstances.end(),
+                    [&instances](const auto& instance) {
+                        return instances.count(instance->getHash()) == 0;
+                    });
+    if (hasComplex)
+    {
+        return collectSelectionChanges(selection, state);
+    }
+
+    std::set<std::size_t> resolvedHashes;
+    for (const auto& instance : resolvedInstances)
+    {
+        const auto fingerprint =
+            selectionChanges.resolved.hashInstance(instance);
+        resolvedHashes.insert(instance->getHash());
+
+        auto [fingerprintIt, isAdded] =
+            state.fingerprints.emplace(instance->getHash(), fingerprint);
+        if (isAdded || fingerprintIt->second != fingerprint)
+        {
+            fingerprintIt->second = fingerprint;
+            selectionChanges.changed.push_back(instance);
+        }
+    }
+    // The changed instance which doesn't match the filter anymore is removed
+    for (auto instanceHash : instances)
+    {
+        if (resolvedHashes.count(instanceHash) == 0 &&
+            state.fingerprints.erase(instanceHash) != 0)
+        {
+            selectionChanges.removed.push_back(instanceHash);
+        }
+    }
+    return selectionChanges;
+}
+
+void GqlSubscription::writeEvent(std::ostream& output, const Changes& changes,
+                                 bool isInitial) const
+{
+    if (changes.empty())
+    {
+        return;
+    }
+
+    // The compact JSON has no line breaks, hence the event data is a single
+    // line.
+    output << "event: " << eventNext << "\ndata: ";
+    JsonWriter writer(output);
+    writer.beginObject();
+    writer.key(fields::respFieldData);
+    writer.beginObject();
+    writer.key(operation.name);
+    writer.beginObject();
+    for (const auto& selectionChanges : changes)
+    {
+        const auto& resolved = selectionChanges.resolved;
+        writer.key(resolved.selection.responseName);
+        if (isInitial)
+        {
+            resolved.write(writer);
+            continue;
+        }
+        writer.beginArray();
+        for (const auto& instance : selectionChanges.changed)
+        {
+            resolved.writeInstance(writer, instance);
+        }
+        writer.endArray();
+    }
+    writer.endObject();
+    writer.endObject();
+
+    const bool hasRemoved =
+        std::any_of(changes.begin(), changes.end(), [](const auto& change) {
+            return !change.removed.empty();
+        });
+    if (hasRemoved)
+    {
+        writer.key(fields::respFieldExtensions);
+        writer.beginObject();
+        writer.key(fieldRemoved);
+        writer.beginObject();
+        for (const auto& selectionChanges : changes)
+        {
+            if (selectionChanges.removed.empty())
+            {
+                continue;
+            }
+            writer.key(selectionChanges.resolved.selection.responseName);
+            writer.beginArray();
+            for (auto instanceHash : selectionChanges.removed)
+            {
+                writer.value(GqlSelection::formatCursor(instanceHash));
+            }
+            writer.endArray();
+        }
+        writer.endObject();
+        writer.endObject();
+    }
+    writer.endObject();
+    output << "\n\n";
+}
+
+GqlSubscriptionDispatcher::GqlSubscriptionDispatcher() : isStopped(false)
+{
+    // The notifier is waited by the dispatcher thread until it is joined,
+    // hence the notifier is created first to be destroyed last.
+    entity::EntityChangeNotifier::getInstance();
+}
+
+GqlSubscriptionDispatcher::~GqlSubscriptionDispatcher() noexcept
+{
+    isStopped = true;
+    if (dispatchThread.joinable())
+    {
+        dispatchThread.join();
+    }
+}
+
+GqlSubscriptionDispatcher& GqlSubscriptionDispatcher::getInstance()
+{
+    static GqlSubscriptionDispatcher dispatcher;
+    return dispatcher;
+}
+
+void GqlSubscriptionDispatcher::add(const GqlSubscriptionPtr& subscription)
+{
+    std::lock_guard<std::mutex> lock(subscriptionsMutex);
+    subscriptions.push_back(subscription);
+    if (!dispatchThread.joinable())
+    {
+        dispatchThread =
+            std::thread(&GqlSubscriptionDispatcher::doDispatch, this);
+    }
+}
+
+void GqlSubscriptionDispatcher::doDispatch()
+{
+    auto& changeNotifier = entity::EntityChangeNotifier::getInstance();
+    auto seenGeneration = changeNotifier.getGeneration();
+    while (!isStopped)
+    {
+        const bool isChanged =
+            changeNotifier.waitChanges(seenGeneration, dispatchInterval);
+        if (isChanged)
+        {
+            std::this_thread::sleep_for(GqlSubscription::coalesceInterval);
+            seenGeneration = changeNotifier.getGeneration();
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        std::vector<GqlSubscriptionPtr> wokenSubscriptions;
+        {
+            std::lock_guard<std::mutex> lock(subscriptionsMutex);
+            subscriptions.erase(
+                std::remove_if(subscriptions.begin(), subscriptions.end(),
+                               [](const auto& subscription) {
+                                   return subscription.expired();
+                               }),
+                subscriptions.end());
+            for (const auto& weakSubscription : subscriptions)
+            {
+                auto subscription = weakSubscription.lock();
+                if (subscription && (isChanged || subscription->isDue(now)))
+                {
+                    wokenSubscriptions.push_back(std::move(subscription));
+                }
+            }
+        }
+        // The subscription writes the event by the FastCGI worker thread
+        for (const auto& subscription : wokenSubscriptions)
+        {
+            subscription->wakeup();
+        }
+    }
+}
+
+} // namespace handlers
+} // namespace route
+} // namespace core
+} // namespace app
@@ -0,0 +1,214 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#ifndef __GRAPHQL_SUBSCRIPTION_H__
+#define __GRAPHQL_SUBSCRIPTION_H__
+
+#include <config.h>
+
+#include <core/response.hpp>
+#include <core/route/handlers/graphql_plan.hpp>
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace app
+{
+namespace core
+{
+namespace route
+{
+namespace handlers
+{
+
+class GqlSubscription;
+
+using GqlSubscriptionPtr = std::shared_ptr<GqlSubscription>;
+
+/**
+ * @brief The GraphQL subscription streamed as the Server-Sent Events. The
+ *        first event carries the full result, the next events carry only the
+ *        changed instances of the root selections and the cursors of the
+ *        removed ones. The events are driven by the entities changes
+ *        notifications: the root selection is resolved again only once the
+ *        version of an entity read by the selection is changed. If only the
+ *        instances of the root entity are changed in place, only those
+ *        instances are resolved again.
+ *
+ * The subscription is the body stream of the response: the FastCGI worker
+ * thread writes an event once the dispatcher wakes the subscription up and
+ * is free in between.
+ */
+class GqlSubscription final :
+    public IBodyStream,
+    public std::enable_shared_from_this<GqlSubscription>
+{
+    struct SelectionState
+    {
+        std::size_t versionsHash = 0;
+        std::size_t structureHash = 0;
+        // The position of the log of the root entity changes
+        uint64_t changesPosition = 0;
+        // The complex instances are expanded from the stored ones, hence the
+        // changes of them are tracked by resolving the selection fully.
+        bool hasComplex = false;
+        // The hash of the written instance by the instance hash
+        std::map<std::size_t, std::size_t> fingerprints;
+    };
+
+    struct SelectionChanges
+    {
+        GqlResolvedSelection resolved;
+        std::vector<entity::IEntity::InstancePtr> changed;
+        std::vector<std::size_t> removed;
+    };
+
+    using Changes = std::vector<SelectionChanges>;
+
+  public:
+    static constexpr size_t maxSubscriptions = BMC_GQL_MAX_SUBSCRIPTIONS;
+    static constexpr std::chrono::seconds heartbeatInterval{15};
+    static constexpr std::chrono::minutes lifetime{10};
+    // The changes are coalesced to not emit an event per DBus signal
+    static constexpr std::chrono::milliseconds coalesceInterval{250};
+    static constexpr const char* eventNext = "next";
+    static constexpr const char* fieldRemoved = "removed";
+
+    GqlSubscription(const GqlSubscription&) = delete;
+    GqlSubscription& operator=(const GqlSubscription&) = delete;
+    GqlSubscription(GqlSubscription&&) = delete;
+    GqlSubscription& operator=(GqlSubscription&&) = delete;
+    ~GqlSubscription() noexcept override;
+
+    /**
+     * @brief Create the subscription and resolve the initial result.
+     *
+     * @param plan          - the plan of the subscription operation
+     * @param variables     - the variables of the request
+     * @param operationName - the name of the subscription operation
+     * @return GqlSubscriptionPtr - the subscription, or nullptr if the limit
+     *                              of the concurrent subscriptions is reached
+     * @throw exceptions::GqlException - the arguments are invalid
+     */
+    static GqlSubscriptionPtr create(const GqlQueryPlanPtr& plan,
+                                     const nlohmann::json& variables,
+                                     const std::string& operationName);
+
+    /**
+     * @brief Register the subscription to be woken up by the dispatcher.
+     */
+    void start(Wakeup) override;
+    /**
+     * @brief Write the initial result, then the changes or the heartbeat
+     *        comment if any of them is due.
+     *
+     * @param output - the output stream of the response body
+     * @return true - the lifetime is over or the output stream is failed
+     */
+    bool writeNext(std::ostream& output) override;
+
+    static size_t getActiveSubscriptions()
+    {
+        return activeSubscriptions;
+    }
+
+  protected:
+    explicit GqlSubscription(const GqlQueryPlanPtr& subscriptionPlan,
+                             const GqlQueryPlan::Operation& planOperation,
+                             const nlohmann::json& operationVariables) :
+        plan(subscriptionPlan),
+        operation(planOperation), variables(operationVariables),
+        deadline(std::chrono::steady_clock::now() + lifetime),
+        heartbeatTime(std::chrono::steady_clock::now() + heartbeatInterval),
+        seenGeneration(0), isStarted(false)
+    {}
+
+    /**
+     * @brief Whether the heartbeat is due or the lifetime is over
+     */
+    bool isDue(std::chrono::steady_clock::time_point now) const;
+
+    Changes collectChanges(bool isInitial);
+    SelectionChanges collectSelectionChanges(const GqlSelection& selection,
+                                             SelectionState& state) const;
+    /**
+     * @brief Collect the changes of the stored instances changed in place.
+     *        The selection is resolved fully if any of them is complex.
+     */
+    SelectionChanges
+        collectInstancesChanges(const GqlSelection& selection,
+                                SelectionState& state,
+                                const std::set<std::size_t>& instances) const;
+    void writeEvent(std::ostream& output, const Changes& changes,
+                    bool isInitial) const;
+
+  private:
+    const GqlQueryPlanPtr plan;
+    // The operation is owned by the plan
+    const GqlQueryPlan::Operation& operation;
+    const nlohmann::json variables;
+    std::vector<SelectionState> states;
+    Changes initialChanges;
+    const std::chrono::steady_clock::time_point deadline;
+    // Read by the dispatcher thread
+    std::atomic<std::chrono::steady_clock::time_point> heartbeatTime;
+    uint64_t seenGeneration;
+    bool isStarted;
+    Wakeup wakeup;
+
+    static inline std::atomic_size_t activeSubscriptions{0};
+
+    friend class GqlSubscriptionDispatcher;
+};
+
+/**
+ * @brief Wakes the subscriptions up once the entities are changed, the
+ *        heartbeat is due or the lifetime is over. The single thread waits
+ *        for all the subscriptions, hence the count of them doesn't depend
+ *        on the FastCGI worker threads.
+ */
+class GqlSubscriptionDispatcher final
+{
+  public:
+    // The precision of the heartbeats and of the lifetime
+    static constexpr std::chrono::seconds dispatchInterval{1};
+
+    GqlSubscriptionDispatcher(const GqlSubscriptionDispatcher&) = delete;
+    GqlSubscriptionDispatcher&
+        operator=(const GqlSubscriptionDispatcher&) = delete;
+    GqlSubscriptionDispatcher(GqlSubscriptionDispatcher&&) = delete;
+    GqlSubscriptionDispatcher& operator=(GqlSubscriptionDispatcher&&) = delete;
+    ~GqlSubscriptionDispatcher() noexcept;
+
+    static GqlSubscriptionDispatcher& getInstance();
+
+    /**
+     * @brief Wake the subscription up until it is destroyed. The dispatcher
+     *        thread is started by the first subscription.
+     */
+    void add(const GqlSubscriptionPtr&);
+
+  private:
+    GqlSubscriptionDispatcher();
+    void doDispatch();
+
+    std::mutex subscriptionsMutex;
+    std::vector<std::weak_ptr<GqlSubscription>> subscriptions;
+    std::atomic_bool isStopped;
+    std::thread dispatchThread;
+};
+
+} // namespace handlers
+} // namespace route
+} // namespace core
+} // namespace app
+
+#endif // __GRAPHQL_SUBSCRIPTION_H__
@@ -0,0 +1,447 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#include <core/application.hpp>
+#include <core/broker/dbus_broker.hpp>
+#include <core/broker/signal_throttle.hpp>
+#include <core/compression.hpp>
+#include <core/connect/dbus_statistics.hpp>
+#include <core/connection.hpp>
+#include <core/request_metrics.hpp>
+#include <core/route/handlers/graphql_plan.hpp>
+#include <core/route/handlers/graphql_subscription.hpp>
+#include <core/route/handlers/metrics_handler.hpp>
+#include <http/headers.hpp>
+#include <logger/logger.hpp>
+#include <service/session.hpp>
+
+#include <array>
+#include <charconv>
+#include <chrono>
+
+namespace app
+{
+namespace core
+{
+namespace route
+{
+namespace handlers
+{
+
+namespace
+{
+constexpr const char* metricsPrefix = "obmc_webapp_";
+// The scraped body is about a few tens of KB
+constexpr size_t initialBodyCapacity = 32 * 1024;
+// The histogram buckets are exported at the powers of two only: the upper
+// bound of each power of two is the exact bound of the latency histogram
+// bucket. The range is 16us..33.5s.
+constexpr size_t firstExportedPower = LatencyHistogram::subBucketBits + 1;
+constexpr size_t lastExportedPower = 25;
+
+constexpr double microsecondsPerSecond = 1e6;
+constexpr size_t numberBufferSize = 32;
+
+/**
+ * @brief Format the number into the buffer in the shortest form
+ */
+template <typename TValue>
+std::string_view formatNumber(std::array<char, numberBufferSize>& buffer,
+                              TValue value)
+{
+    const auto numberEnd =
+        std::to_chars(buffer.begin(), buffer.end(), value).ptr;
+    return std::string_view(buffer.data(),
+                            static_cast<size_t>(numberEnd - buffer.begin()));
+}
+
+uint64_t getElapsedMicroseconds(std::chrono::steady_clock::time_point since)
+{
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - since);
+    return static_cast<uint64_t>(std::max<std::chrono::microseconds::rep>(
+        elapsed.count(), 0));
+}
+} // namespace
+
+void MetricsRouter::run(const RequestPtr& request, ResponseUni& response)
+{
+    LOG_DEBUG << "Run route: " << request->environment().requestUri;
+
+    if (request->environment().requestMethod !=
+        Fastcgipp::Http::RequestMethod::GET)
+    {
+        response->setStatus(statuses::Code::MethodNotAllowed);
+        response->setHeader(http::headers::allow, "GET");
+        return;
+    }
+
+    body.clear();
+    if (body.capacity() < initialBodyCapacity)
+    {
+        body.reserve(initialBodyCapacity);
+    }
+    writeRequestMetrics();
+    writeServerMetrics();
+    writeBrokerMetrics();
+    writeDBusMetrics();
+    writeCacheMetrics();
+
+    response->setStatus(statuses::Code::OK);
+    response->setContentType(http::content_types::textPlainMetrics);
+    response->setHeader(http::headers::cacheControl, "no-cache");
+    response->push(body);
+}
+
+bool MetricsRouter::preHandlers(const RequestPtr&)
+{
+    return true;
+}
+
+void MetricsRouter::reset()
+{
+    body.clear();
+}
+
+void MetricsRouter::writeRequestMetrics()
+{
+    const auto snapshot = RequestMetrics::getInstance().collect();
+
+    writeFamily("request_duration_seconds", "histogram",
+                "The latency of the request handling phases");
+    for (size_t phaseIndex = 0;
+         phaseIndex < static_cast<size_t>(RequestPhase::count); phaseIndex++)
+    {
+        const auto phase = static_cast<RequestPhase>(phaseIndex);
+        const auto& histogram = snapshot.getPhase(phase);
+        const auto phaseLabel =
+            label("phase", RequestMetrics::getPhaseName(phase));
+
+        uint64_t cumulativeCount = 0;
+        size_t bucketIndex = 0;
+        for (size_t power = firstExportedPower; power <= lastExportedPower;
+             power++)
+        {
+            const uint64_t upperBound = uint64_t(1) << power;
+            while (bucketIndex < LatencyHistogram::bucketsCount &&
+                   LatencyHistogram::getBucketUpperBound(bucketIndex) <=
+                       upperBound)
+            {
+                cumulativeCount += histogram.buckets[bucketIndex++];
+            }
+
+            std::array<char, numberBufferSize> boundBuffer{};
+            writeSample(
+                "request_duration_seconds_bucket",
+                phaseLabel + "," +
+                    label("le", formatNumber(boundBuffer,
+                                             static_cast<double>(upperBound) /
+                                                 microsecondsPerSecond)),
+                cumulativeCount);
+        }
+        // The buckets are recorded concurrently with the count, hence the
+        // '+Inf' bucket and the count are both the sum of all buckets to
+        // keep the histogram monotonic.
+        while (bucketIndex < LatencyHistogram::bucketsCount)
+        {
+            cumulativeCount += histogram.buckets[bucketIndex++];
+        }
+        writeSample("request_duration_seconds_bucket",
+                    phaseLabel + "," + label("le", "+Inf"), cumulativeCount);
+        writeSeconds("request_duration_seconds_sum", phaseLabel,
+                     histogram.sumMicroseconds);
+        writeSample("request_duration_seconds_count", phaseLabel,
+                    cumulativeCount);
+    }
+
+    writeFamily("requests_total", "counter", "The count of served requests");
+    writeSample("requests_total", "", snapshot.requests);
+    writeFamily("request_errors_total", "counter",
+                "The count of the requests failed by the status class");
+    writeSample("request_errors_total", label("class", "client"),
+                snapshot.clientErrors);
+    writeSample("request_errors_total", label("class", "server"),
+                snapshot.serverErrors);
+}
+
+void MetricsRouter::writeServerMetrics()
+{
+    writeFamily("fastcgi_worker_threads", "gauge",
+                "The count of the FastCGI worker threads");
+    writeSample("fastcgi_worker_threads", "",
+                static_cast<uint64_t>(application.getWorkerThreads()));
+    writeFamily("fastcgi_queued_requests", "gauge",
+                "The count of the requests being received or waiting for the "
+                "worker thread");
+    writeSample("fastcgi_queued_requests", "",
+                static_cast<uint64_t>(Connection::getQueuedRequests()));
+    writeFamily("fastcgi_active_requests", "gauge",
+                "The count of the requests being responded");
+    writeSample("fastcgi_active_requests", "",
+                static_cast<uint64_t>(Connection::getActiveRequests()));
+
+    writeFamily("sessions", "gauge", "The count of the user sessions");
+    decltype(auto) sessionStore =
+        service::session::SessionStore::getInstance();
+    writeSample("sessions", "",
+                static_cast<uint64_t>(sessionStore.getSessionsCount()));
+
+    writeFamily("graphql_active_subscriptions", "gauge",
+                "The count of the active GraphQL subscriptions");
+    writeSample(
+        "graphql_active_subscriptions", "",
+        static_cast<uint64_t>(GqlSubscription::getActiveSubscriptions()));
+}
+
+void MetricsRouter::writeBrokerMetrics()
+{
+    decltype(auto) brokerManager = application.getBrokerManager();
+    writeFamily("brokers_ready", "gauge",
+                "Whether all entities have been populated at least once");
+    writeSample("brokers_ready", "",
+                static_cast<uint64_t>(brokerManager.isReady()));
+
+    std::vector<std::pair<std::string, const broker::EntityDbusBroker*>>
+        entityBrokers;
+    for (const auto& broker : brokerManager.getBrokers())
+    {
+        auto entityBroker =
+            dynamic_cast<const broker::EntityDbusBroker*>(broker.get());
+        if (entityBroker)
+        {
+            entityBrokers.emplace_back(
+                label("entity", entityBroker->getEntity()->getName()),
+                entityBroker);
+        }
+    }
+
+    writeFamily("broker_refreshes_total", "counter",
+                "The count of the succeeded entity refreshes");
+    for (const auto& [entityLabel, entityBroker] : entityBrokers)
+    {
+        writeSample("broker_refreshes_total", entityLabel,
+                    entityBroker->getRefreshes());
+    }
+    writeFamily("broker_refresh_errors_total", "counter",
+                "The count of the failed entity refreshes");
+    for (const auto& [entityLabel, entityBroker] : entityBrokers)
+    {
+        writeSample("broker_refresh_errors_total", entityLabel,
+                    entityBroker->getRefreshErrors());
+    }
+    writeFamily("broker_refresh_duration_seconds_total", "counter",
+                "The total duration of the succeeded entity refreshes");
+    for (const auto& [entityLabel, entityBroker] : entityBrokers)
+    {
+        writeSeconds("broker_refresh_duration_seconds_total", entityLabel,
+                     entityBroker->getTotalRefreshMicroseconds());
+    }
+    writeFamily("broker_last_refresh_duration_seconds", "gauge",
+                "The duration of the last succeeded entity refresh");
+    for (const auto& [entityLabel, entityBroker] : entityBrokers)
+    {
+        writeSeconds("broker_last_refresh_duration_seconds", entityLabel,
+                     entityBroker->getLastRefreshMicroseconds());
+    }
+    writeFamily("entity_instances", "gauge",
+                "The count of the entity instances set by the last refresh");
+    for (const auto& [entityLabel, entityBroker] : entityBrokers)
+    {
+        writeSample("entity_instances", entityLabel,
+                    static_cast<uint64_t>(entityBroker->getInstancesCount()));
+    }
+    writeFamily("entity_age_seconds", "gauge",
+                "The time since the last succeeded entity refresh");
+    for (const auto& [entityLabel, entityBroker] : entityBrokers)
+    {
+        const auto lastRefreshTime = entityBroker->getLastRefreshTime();
+        if (lastRefreshTime)
+        {
+            writeSeconds("entity_age_seconds", entityLabel,
+                         getElapsedMicroseconds(*lastRefreshTime));
+        }
+    }
+
+    const auto* entitySnapshot = application.getEntitySnapshot();
+    writeFamily("snapshot_loaded", "gauge",
+                "Whether the entities have been restored from the snapshot");
+    writeSample("snapshot_loaded", "",
+                static_cast<uint64_t>(application.isWarmStarted()));
+    if (entitySnapshot)
+    {
+        const auto lastSaveTime = entitySnapshot->getLastSaveTime();
+        if (lastSaveTime)
+        {
+            writeFamily("snapshot_age_seconds", "gauge",
+                        "The time since the last saved entities snapshot");
+            writeSeconds("snapshot_age_seconds", "",
+                         getElapsedMicroseconds(*lastSaveTime));
+        }
+    }
+}
+
+void MetricsRouter::writeDBusMetrics()
+{
+    const auto callCounters =
+        app::connect::DBusCallStatistics::getInstance().getCounters();
+    writeFamily("dbus_calls_total", "counter",
+                "The count of the DBus method calls by the service");
+    for (const auto& counter : callCounters)
+    {
+        writeSample("dbus_calls_total", label("service", counter->getService()),
+                    counter->getCalls());
+    }
+    writeFamily("dbus_call_errors_total", "counter",
+                "The count of the failed DBus method calls by the service");
+    for (const auto& counter : callCounters)
+    {
+        writeSample("dbus_call_errors_total",
+                    label("service", counter->getService()),
+                    counter->getErrors());
+    }
+
+    // The signals rates are derived by the Prometheus from the counters
+    const auto limiters = broker::SignalThrottle::getInstance().getLimiters();
+    writeFamily("dbus_signals_accepted_total", "counter",
+                "The count of the processed DBus signals by the service");
+    for (const auto& limiter : limiters)
+    {
+        writeSample("dbus_signals_accepted_total",
+                    label("service", limiter->getService()),
+                    limiter->getAccepted());
+    }
+    writeFamily("dbus_signals_dropped_total", "counter",
+                "The count of the DBus signals dropped by the rate limits");
+    for (const auto& limiter : limiters)
+    {
+        writeSample("dbus_signals_dropped_total",
+                    label("service", limiter->getService()),
+                    limiter->getDropped());
+    }
+    writeFamily("dbus_signals_throttled", "gauge",
+                "Whether the DBus signals of the service are throttled");
+    for (const auto& limiter : limiters)
+    {
+        writeSample("dbus_signals_throttled",
+                    label("service", limiter->getService()),
+                    static_cast<uint64_t>(limiter->isThrottled()));
+    }
+}
+
+void MetricsRouter::writeCacheMetrics()
+{
+    const std::array<std::tuple<std::string, uint64_t, uint64_t>, 2> caches{{
+        {label("cache", "graphql_plan"), GqlPlanCache::getHits(),
+         GqlPlanCache::getMisses()},
+        {label("cache", "compressed_response"),
+         CompressedResponseCache::getHits(),
+         CompressedResponseCache::getMisses()},
+    }};
+
+    writeFamily("cache_hits_total", "counter", "The count of the cache hits");
+    for (const auto& [cacheLabel, hits, _] : caches)
+    {
+        writeSample("cache_hits_total", cacheLabel, hits);
+    }
+    writeFamily("cache_misses_total", "counter",
+                "The count of the cache misses");
+    for (const auto& [cacheLabel, _, misses] : caches)
+    {
+        writeSample("cache_misses_total", cacheLabel, misses);
+    }
+    writeFamily("cache_hit_ratio", "gauge",
+                "The ratio of the cache hits since the start");
+    for (const auto& [cacheLabel, hits, misses] : caches)
+    {
+        const auto lookups = hits + misses;
+        writeSample("cache_hit_ratio", cacheLabel,
+                    lookups == 0 ? 0.0
+                                 : static_cast<double>(hits) /
+                                       static_cast<double>(lookups));
+    }
+
+    writeFamily("graphql_contended_parses_total", "counter",
+                "The count of the queries parsed while another query was "
+                "being parsed");
+    writeSample("graphql_contended_parses_total", "",
+                static_cast<uint64_t>(GqlPlanCache::getContendedParses()));
+    writeFamily("graphql_peak_parses_in_flight", "gauge",
+                "The maximum count of the queries parsed concurrently");
+    writeSample("graphql_peak_parses_in_flight", "",
+                static_cast<uint64_t>(GqlPlanCache::getPeakParsesInFlight()));
+}
+
+void MetricsRouter::writeFamily(std::string_view name, std::string_view type,
+                                std::string_view help)
+{
+    body.append("# HELP ").append(metricsPrefix).append(name);
+    body.append(" ").append(help).append("\n");
+    body.append("# TYPE ").append(metricsPrefix).append(name);
+    body.append(" ").append(type).append("\n");
+}
+
+void MetricsRouter::writeSample(std::string_view name, std::string_view labels,
+                                uint64_t value)
+{
+    std::array<char, numberBufferSize> valueBuffer{};
+    writeLine(name, labels, formatNumber(valueBuffer, value));
+}
+
+void MetricsRouter::writeSample(std::string_view name, std::string_view labels,
+                                double value)
+{
+    std::array<char, numberBufferSize> valueBuffer{};
+    writeLine(name, labels, formatNumber(valueBuffer, value));
+}
+
+void MetricsRouter::writeLine(std::string_view name, std::string_view labels,
+                              std::string_view value)
+{
+    body.append(metricsPrefix).append(name);
+    if (!labels.empty())
+    {
+        body.append("{").append(labels).append("}");
+    }
+    body.append(" ").append(value).append("\n");
+}
+
+void MetricsRouter::writeSeconds(std::string_view name,
+                                 std::string_view labels,
+                                 uint64_t microseconds)
+{
+    writeSample(name, labels,
+                static_cast<double>(microseconds) / microsecondsPerSecond);
+}
+
+const std::string MetricsRouter::label(std::string_view name,
+                                       std::string_view value)
+{
+    std::string result(name);
+    result.reserve(name.size() + value.size() + 3);
+    result.append("=\"");
+    for (const char symbol : value)
+    {
+        switch (symbol)
+        {
+            case '\\':
+                result.append("\\\\");
+                break;
+            case '"':
+                result.append("\\\"");
+                break;
+            case '\n':
+                result.append("\\n");
+                break;
+            default:
+                result.push_back(symbol);
+                break;
+        }
+    }
+    result.push_back('"');
+    return result;
+}
+
+} // namespace handlers
+} // namespace route
+} // namespace core
+} // namespace app
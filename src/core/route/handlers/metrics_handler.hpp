@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#ifndef __METRICS_HANDLER_H__
+#define __METRICS_HANDLER_H__
+
+#include <core/router.hpp>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace app
+{
+namespace core
+{
+namespace route
+{
+namespace handlers
+{
+
+/**
+ * @brief The route of the service metrics in the Prometheus text format.
+ *
+ * The metrics are rendered from the atomic counters and the per-thread
+ * histograms only, hence the scraping doesn't contend with the request
+ * handling nor with the DBus brokers.
+ */
+class MetricsRouter : public IRouteHandler
+{
+  public:
+    explicit MetricsRouter(const std::string& iPath) : path(iPath)
+    {}
+
+    MetricsRouter() = delete;
+    MetricsRouter(const MetricsRouter&) = delete;
+    MetricsRouter(const MetricsRouter&&) = delete;
+
+    MetricsRouter& operator=(const MetricsRouter&) = delete;
+    MetricsRouter& operator=(const MetricsRouter&&) = delete;
+
+    void run(const RequestPtr& request, ResponseUni& response) override;
+    bool preHandlers(const RequestPtr& request) override;
+    void reset() override;
+
+    virtual ~MetricsRouter() = default;
+
+  protected:
+    void writeRequestMetrics();
+    void writeServerMetrics();
+    void writeBrokerMetrics();
+    void writeDBusMetrics();
+    void writeCacheMetrics();
+
+    void writeFamily(std::string_view name, std::string_view type,
+                     std::string_view help);
+    void writeSample(std::string_view name, std::string_view labels,
+                     uint64_t value);
+    void writeSample(std::string_view name, std::string_view labels,
+                     double value);
+    void writeLine(std::string_view name, std::string_view labels,
+                   std::string_view value);
+    /**
+     * @brief Write the sample of the duration in seconds
+     */
+    void writeSeconds(std::string_view name, std::string_view labels,
+                      uint64_t microseconds);
+
+    /**
+     * @brief Build the label pair escaping the label value
+     */
+    static const std::string label(std::string_view name,
+                                   std::string_view value);
+
+  private:
+    const std::string path;
+    // The rendered metrics. The capacity is kept for the next scrape.
+    std::string body;
+};
+
+} // namespace handlers
+} // namespace route
+} // namespace core
+} // namespace app
+
+#endif // __METRICS_HANDLER_H__
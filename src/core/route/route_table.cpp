@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#include <core/route/route_table.hpp>
+
+#include <stdexcept>
+
+namespace app
+{
+namespace core
+{
+namespace route
+{
+
+void RouteTable::add(const std::string& pattern, HandlerBuilderFn builder)
+{
+    const size_t routeIndex = routes.size();
+    size_t nodeIndex = 0;
+    size_t parametersCount = 0;
+
+    std::string_view rest(pattern);
+    while (!rest.empty())
+    {
+        const auto segment = nextSegment(rest);
+        if (segment.empty())
+        {
+            continue;
+        }
+        if (segment == "*")
+        {
+            if (!rest.empty() || nodes[nodeIndex].prefixRoute)
+            {
+                throw std::invalid_argument(
+                    "Invalid or duplicated route pattern: " + pattern);
+            }
+            nodes[nodeIndex].prefixRoute = routeIndex;
+            routes.push_back(Route{pattern, std::move(builder)});
+            return;
+        }
+
+        std::optional<size_t> nextNode;
+        if (segment.front() == '{' && segment.back() == '}')
+        {
+            if (++parametersCount > maxParameters)
+            {
+                throw std::invalid_argument(
+                    "Too many parameters of the route pattern: " + pattern);
+            }
+            nextNode = nodes[nodeIndex].parameter;
+            if (!nextNode)
+            {
+                nextNode = nodes.size();
+                nodes[nodeIndex].parameter = nextNode;
+                nodes.emplace_back();
+            }
+        }
+        else
+        {
+            auto findLiteralIt = nodes[nodeIndex].literals.find(segment);
+            if (findLiteralIt != nodes[nodeIndex].literals.end())
+            {
+                nextNode = findLiteralIt->second;
+            }
+            else
+            {
+                nextNode = nodes.size();
+                nodes[nodeIndex].literals.emplace(segment, *nextNode);
+                nodes.emplace_back();
+            }
+        }
+        nodeIndex = *nextNode;
+    }
+
+    if (nodes[nodeIndex].route)
+    {
+        throw std::invalid_argument("Duplicated route pattern: " + pattern);
+    }
+    nodes[nodeIndex].route = routeIndex;
+    routes.push_back(Route{pattern, std::move(builder)});
+}
+
+RouteTable::Match RouteTable::match(std::string_view path) const
+{
+    Match result;
+    matchNode(0, path, result);
+    return result;
+}
+
+bool RouteTable::matchNode(size_t nodeIndex, std::string_view path,
+                           Match& match) const
+{
+    const auto& node = nodes[nodeIndex];
+    std::string_view segment;
+    while (segment.empty() && !path.empty())
+    {
+        segment = nextSegment(path);
+    }
+    if (segment.empty())
+    {
+        if (node.route)
+        {
+            match.routeIndex = node.route;
+            return true;
+        }
+        if (node.prefixRoute)
+        {
+            match.routeIndex = node.prefixRoute;
+            return true;
+        }
+        return false;
+    }
+
+    auto findLiteralIt = node.literals.find(segment);
+    if (findLiteralIt != node.literals.end() &&
+        matchNode(findLiteralIt->second, path, match))
+    {
+        return true;
+    }
+    if (node.parameter)
+    {
+        const auto parameterIndex = match.parametersCount++;
+        match.parameters[parameterIndex] = segment;
+        if (matchNode(*node.parameter, path, match))
+        {
+            return true;
+        }
+        match.parametersCount = parameterIndex;
+    }
+    if (node.prefixRoute)
+    {
+        match.routeIndex = node.prefixRoute;
+        return true;
+    }
+    return false;
+}
+
+std::string_view RouteTable::nextSegment(std::string_view& path)
+{
+    const auto segmentEnd = path.find('/');
+    const auto segment = path.substr(0, segmentEnd);
+    path.remove_prefix(segmentEnd == std::string_view::npos ? path.size()
+                                                            : segmentEnd + 1);
+    return segment;
+}
+
+} // namespace route
+} // namespace core
+} // namespace app
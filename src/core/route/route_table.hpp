@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright (C) 2021 YADRO
+
+#ifndef __ROUTE_TABLE_H__
+#define __ROUTE_TABLE_H__
+
+#include <array>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace app
+{
+namespace core
+{
+
+class IRouteHandler;
+
+using RouteHandlerUni = std::unique_ptr<IRouteHandler>;
+
+namespace route
+{
+
+/**
+ * @brief The table of the routes compiled into the trie of the path
+ *        segments on the startup. The pattern segment might be:
+ *          - the literal, e.g. 'graphql';
+ *          - the parameter, e.g. '{id}', which matches any single segment;
+ *          - the trailing '*', which matches the rest of the path.
+ *        The literal segment is preferred to the parameter, the full match is
+ *        preferred to the prefix one. The lookup doesn't allocate.
+ */
+class RouteTable final
+{
+  public:
+    static constexpr size_t maxParameters = 4;
+
+    using HandlerBuilderFn = std::function<RouteHandlerUni()>;
+
+    struct Route
+    {
+        std::string pattern;
+        HandlerBuilderFn builder;
+    };
+
+    struct Match
+    {
+        // The index of the matched route, nullopt if the route is not found
+        std::optional<size_t> routeIndex;
+        // The values of the parameter segments in the order of the pattern
+        std::array<std::string_view, maxParameters> parameters;
+        size_t parametersCount = 0;
+
+        explicit operator bool() const
+        {
+            return routeIndex.has_value();
+        }
+    };
+
+    RouteTable(const RouteTable&) = delete;
+    RouteTable& operator=(const RouteTable&) = delete;
+    RouteTable(RouteTable&&) = delete;
+    RouteTable& operator=(RouteTable&&) = delete;
+
+    RouteTable() : nodes(1)
+    {}
+    ~RouteTable() noexcept = default;
+
+    /**
+     * @brief Add the route to the table. The routes are added before the
+     *        requests are served, hence the table isn't guarded.
+     *
+     * @param pattern - the route pattern
+     * @param builder - the builder of the route handler
+     * @throw std::invalid_argument - the pattern is invalid or duplicated
+     */
+    void add(const std::string& pattern, HandlerBuilderFn builder);
+
+    /**
+     * @brief Find the route of the path. The parameters refer to the path.
+     *
+     * @param path - the path of the request URI without the query string
+     * @return Match - the matched route and the values of the parameters
+     */
+    Match match(std::string_view path) const;
+
+    const Route& getRoute(size_t routeIndex) const
+    {
+        return routes.at(routeIndex);
+    }
+
+    size_t size() const
+    {
+        return routes.size();
+    }
+
+  protected:
+    struct Node
+    {
+        std::map<std::string, size_t, std::less<>> literals;
+        std::optional<size_t> parameter;
+        std::optional<size_t> route;
+        std::optional<size_t> prefixRoute;
+    };
+
+    bool matchNode(size_t nodeIndex, std::string_view path, Match& match) const;
+
+    static std::string_view nextSegment(std::string_view& path);
+
+  private:
+    std::vector<Node> nodes;
+    std::vector<Route> routes;
+};
+
+} // namespace route
+} // namespace core
+} // namespace app
+
+#endif // __ROUTE_TABLE_H__
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: Apache-2.0
 // Copyright (C) 2021 YADRO
 
+#include <core/request_metrics.hpp>
 #include <core/router.hpp>
 
 #include <logger/logger.hpp>
@@ -16,56 +17,132 @@ namespace app
 namespace core
 {
 
-Router::RouteMap Router::routerHandlers;
+route::RouteTable Router::routeTable;
+thread_local std::vector<std::vector<RouteHandlerUni>> Router::handlersPool;
 
 Router::Router(const RequestPtr& request) :
     requestObject(request),
     responseObject(std::make_unique<app::core::Response>())
 {}
 
+Router::~Router()
+{
+    releaseHandler();
+}
+
 const ResponseUni& Router::process()
 {
     // Actual session sharing architecture between BMCWEB and WEBAPP processes,
     // in fact, working via filesystem synchronization. Hence, we need to
     // re-read config file for a each one new connection.
-    service::config::getConfig().readData();
-    if (!app::service::authorization::authenticate(getRequest(), getResponse()))
+    {
+        PhaseTimer sessionTimer(RequestPhase::session);
+        service::config::getConfig().readData();
+    }
+    bool isAuthenticated = false;
+    {
+        PhaseTimer authenticationTimer(RequestPhase::authentication);
+        isAuthenticated = app::service::authorization::authenticate(
+            getRequest(), getResponse());
+    }
+    if (!isAuthenticated)
     {
         LOG_INFO << "Unauthorized access from "
                  << getRequest()->environment().remoteAddress;
         return getResponse();
     }
 
-    if (!this->handler) {
-        auto builder = routerHandlers.find(getRequest()->environment().requestUri);
-        if (builder == routerHandlers.end())
-        {
-            return getResponse();
-        }
-        this->handler = builder->second(builder->first);
+    if (!this->handler && !acquireHandler())
+    {
+        return getResponse();
     }
 
+    PhaseTimer executionTimer(RequestPhase::execution);
     handler->run(getRequest(), getResponse());
 
     return getResponse();
 }
 
-bool Router::preHandler()
+std::string_view Router::getRoutePath() const
+{
+    std::string_view requestUri(getRequest()->environment().requestUri);
+    return requestUri.substr(0, requestUri.find('?'));
+}
+
+const std::vector<std::string_view> Router::getRouteParameters() const
+{
+    return std::vector<std::string_view>(
+        routeMatch.parameters.begin(),
+        routeMatch.parameters.begin() +
+            static_cast<std::ptrdiff_t>(routeMatch.parametersCount));
+}
+
+bool Router::acquireHandler()
+{
+    routeMatch = routeTable.match(getRoutePath());
+    if (!routeMatch)
+    {
+        return false;
+    }
+
+    const auto routeIndex = *routeMatch.routeIndex;
+    if (handlersPool.size() < routeTable.size())
+    {
+        handlersPool.resize(routeTable.size());
+    }
+    auto& idleHandlers = handlersPool[routeIndex];
+    if (idleHandlers.empty())
+    {
+        handler = routeTable.getRoute(routeIndex).builder();
+        return true;
+    }
+    handler = std::move(idleHandlers.back());
+    idleHandlers.pop_back();
+    return true;
+}
+
+void Router::releaseHandler() noexcept
 {
-    if (!this->handler)
+    if (!handler)
+    {
+        return;
+    }
+    try
     {
-        auto builder =
-            routerHandlers.find(getRequest()->environment().requestUri);
-        if (builder == routerHandlers.end())
+        if (handlersPool.size() < routeTable.size())
         {
-            // Route no found. Immediate exit, but give the chanse to handle
-            // that for the process()
-            LOG_DEBUG << "Route no found. Pass throught";
-            return true;
+            handlersPool.resize(routeTable.size());
         }
-        this->handler = builder->second(builder->first);
+        auto& idleHandlers = handlersPool[*routeMatch.routeIndex];
+        if (idleHandlers.size() < handlersPoolSize)
+        {
+            handler->reset();
+            if (idleHandlers.capacity() == 0)
+            {
+                idleHandlers.reserve(handlersPoolSize);
+            }
+            idleHandlers.push_back(std::move(handler));
+        }
+    }
+    catch (std::exception& ex)
+    {
+        LOG_ERROR << "Can't return the route handler to the pool: "
+                  << ex.what();
+    }
+    handler.reset();
+}
+
+bool Router::preHandler()
+{
+    if (!this->handler && !acquireHandler())
+    {
+        // Route no found. Immediate exit, but give the chanse to handle
+        // that for the process()
+        LOG_DEBUG << "Route no found. Pass throught";
+        return true;
     }
 
+    PhaseTimer parsingTimer(RequestPhase::parsing);
     return handler->preHandlers(getRequest());
 }
 
@@ -6,9 +6,12 @@
 
 #include <core/request.hpp>
 #include <core/response.hpp>
+#include <core/route/route_table.hpp>
 
 #include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace app
 {
@@ -20,17 +23,19 @@ class IRouteHandler
   public:
     virtual void run(const RequestPtr& request, ResponseUni& response) = 0;
     virtual bool preHandlers(const RequestPtr& request) = 0;
+    /**
+     * @brief Drop the state of the served request. The handler is reused
+     *        by the next requests of the same route.
+     */
+    virtual void reset() = 0;
 
     virtual ~IRouteHandler() = default;
 };
 
-using RouteHandlerPtr = std::shared_ptr<IRouteHandler>;
-
 class Router
 {
-    using RoutePattern = std::string;
-    using RouteHandlerBuilderFn = std::function<RouteHandlerPtr(const std::string&)>;
-    using RouteMap = std::map<RoutePattern, RouteHandlerBuilderFn>;
+    // The count of the idle handlers kept per route by each thread
+    static constexpr size_t handlersPoolSize = 4;
 
   public:
     explicit Router(const RequestPtr& request);
@@ -42,7 +47,7 @@ class Router
     Router& operator=(const Router&) = delete;
     Router& operator=(const Router&&) = delete;
 
-    virtual ~Router() = default;
+    virtual ~Router();
 
     const ResponseUni& getResponse() const
     {
@@ -52,18 +57,47 @@ class Router
     const ResponseUni& process();
     bool preHandler();
 
+    /**
+     * @brief Register the handler of the route pattern, see
+     *        route::RouteTable. The routes are registered on the startup
+     *        before the requests are served.
+     *
+     * @param pattern - the route pattern
+     * @param args    - the arguments of the handler besides the pattern
+     * @throw std::invalid_argument - the pattern is invalid or duplicated
+     */
     template <class THandler, typename... TArg>
     static void registerUri(const std::string pattern, TArg... args)
     {
         static_assert(std::is_base_of_v<IRouteHandler, THandler>,
                       "Unexpected URI handler");
-        Router::routerHandlers.emplace(
-            pattern, [&](const std::string pattern) -> RouteHandlerPtr {
-                return std::make_shared<THandler>(pattern, args...);
-            });
+        Router::routeTable.add(pattern, [pattern, args...]() -> RouteHandlerUni {
+            return std::make_unique<THandler>(pattern, args...);
+        });
     }
 
+    /**
+     * @brief Get the values of the parameter segments of the matched route.
+     *        The values refer to the request URI.
+     */
+    const std::vector<std::string_view> getRouteParameters() const;
+
   protected:
+    /**
+     * @brief Get the path of the requested URI to find the route handler.
+     *        The query string is not a part of the route.
+     */
+    std::string_view getRoutePath() const;
+
+    /**
+     * @brief Find the route of the request and take the handler of it from
+     *        the pool of the current thread.
+     *
+     * @return bool - whether the route is found
+     */
+    bool acquireHandler();
+    void releaseHandler() noexcept;
+
     const RequestPtr& getRequest() const
     {
         return requestObject;
@@ -82,10 +116,13 @@ class Router
   private:
     RequestPtr requestObject;
     ResponseUni responseObject;
+    route::RouteTable::Match routeMatch;
+    RouteHandlerUni handler;
 
-    static RouteMap routerHandlers;
-
-    RouteHandlerPtr handler;
+    static route::RouteTable routeTable;
+    // The idle handlers by the route index. The handler is returned to the
+    // pool of the thread which has completed the request.
+    static thread_local std::vector<std::vector<RouteHandlerUni>> handlersPool;
 };
 
 using RouteUni = std::unique_ptr<Router>;
@@ -30,6 +30,8 @@ constexpr const char* fieldPartNumber = "PartNumber";
 
 constexpr const char* metaObjectPath = "__meta_field__object_path";
 constexpr const char* metaObjectService = "__meta_field__object_service";
+// The object path of the chassis which the object is associated with
+constexpr const char* metaChassisPath = "__meta_field__chassis_path";
 
 constexpr const char* metaRelation = "__meta_relations__";
 
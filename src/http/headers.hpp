@@ -4,7 +4,10 @@
 #ifndef BMC_HEADERS_HPP
 #define BMC_HEADERS_HPP
 
+#include <algorithm>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <iostream>
 
 namespace app
@@ -14,11 +17,18 @@ namespace http
 namespace headers
 {
 constexpr const char* http = "HTTP/1.1";
+constexpr const char* allow = "Allow";
+constexpr const char* cacheControl = "Cache-Control";
+constexpr const char* contentEncoding = "Content-Encoding";
 constexpr const char* contentType = "Content-Type";
 constexpr const char* contentLength = "Content-Length";
 constexpr const char* date = "Date";
+constexpr const char* etag = "ETag";
 constexpr const char* location = "Location";
+constexpr const char* retryAfter = "Retry-After";
+constexpr const char* vary = "Vary";
 constexpr const char* wwwAuthenticate = "WWW-Authenticate";
+constexpr const char* acceptEncoding = "Accept-Encoding";
 } // namespace headers
 
 namespace statuses
@@ -322,9 +332,9 @@ inline bool isError(Code code)
 /*! Returns the standard HTTP reason phrase for a HTTP status code.
  * \param code An HTTP status code.
  * \return The standard HTTP reason phrase for the given \p code or an empty \c
- * std::string() if no standard phrase for the given \p code is known.
+ * std::string_view() if no standard phrase for the given \p code is known.
  */
-inline std::string reasonPhrase(int code)
+inline std::string_view reasonPhrase(int code)
 {
     switch (code)
     {
@@ -460,7 +470,7 @@ inline std::string reasonPhrase(int code)
             return "Network Authentication Required";
 
         default:
-            return std::string();
+            return std::string_view();
     }
 }
 
@@ -468,9 +478,9 @@ inline std::string reasonPhrase(int code)
  *
  * \param code An HttpStatus::Code.
  * \return The standard HTTP reason phrase for the given \p code or an empty \c
- * std::string() if no standard phrase for the given \p code is known.
+ * std::string_view() if no standard phrase for the given \p code is known.
  */
-inline std::string reasonPhrase(Code code)
+inline std::string_view reasonPhrase(Code code)
 {
     return reasonPhrase(static_cast<int>(code));
 }
@@ -480,8 +490,176 @@ inline std::string reasonPhrase(Code code)
 namespace content_types
 {
 constexpr const char* applicationJson = "application/json; charset=UTF-8";
+constexpr const char* textEventStream = "text/event-stream; charset=UTF-8";
+// The Prometheus text exposition format
+constexpr const char* textPlainMetrics =
+    "text/plain; version=0.0.4; charset=UTF-8";
 }
 
+namespace content_encodings
+{
+constexpr const char* identity = "identity";
+constexpr const char* gzip = "gzip";
+constexpr const char* deflate = "deflate";
+
+/**
+ * @brief Choose the content coding of the response by the 'Accept-Encoding'
+ *        request header. The gzip is preferred to the deflate when both are
+ *        acceptable, the coding of the zero quality is not acceptable.
+ *
+ * @param acceptEncoding - the value of the 'Accept-Encoding' header
+ * @return const char* - the gzip, the deflate or the identity coding
+ */
+inline const char* negotiate(std::string_view acceptEncoding)
+{
+    constexpr std::string_view whitespaces = " \t";
+    auto trim = [whitespaces](std::string_view value) {
+        value.remove_prefix(
+            std::min(value.find_first_not_of(whitespaces), value.size()));
+        return value.substr(0, value.find_last_not_of(whitespaces) + 1);
+    };
+
+    // The acceptance of the gzip, the deflate and the '*' codings: the
+    // unlisted coding is nullopt.
+    std::optional<bool> gzipAccepted;
+    std::optional<bool> deflateAccepted;
+    std::optional<bool> anyAccepted;
+    while (!acceptEncoding.empty())
+    {
+        const auto codingEnd = acceptEncoding.find(',');
+        auto coding = acceptEncoding.substr(0, codingEnd);
+        acceptEncoding.remove_prefix(codingEnd == std::string_view::npos
+                                         ? acceptEncoding.size()
+                                         : codingEnd + 1);
+
+        bool isAccepted = true;
+        const auto paramsBegin = coding.find(';');
+        if (paramsBegin != std::string_view::npos)
+        {
+            auto params = trim(coding.substr(paramsBegin + 1));
+            coding = coding.substr(0, paramsBegin);
+            if (params.starts_with("q="))
+            {
+                // The zero quality is '0', '0.', '0.0', '0.00' or '0.000'
+                auto quality = trim(params.substr(2));
+                isAccepted = quality.empty() || quality.front() != '0' ||
+                             quality.find_first_not_of("0.") !=
+                                 std::string_view::npos;
+            }
+        }
+
+        coding = trim(coding);
+        if (coding == gzip)
+        {
+            gzipAccepted = isAccepted;
+        }
+        else if (coding == deflate)
+        {
+            deflateAccepted = isAccepted;
+        }
+        else if (coding == "*")
+        {
+            anyAccepted = isAccepted;
+        }
+    }
+
+    if (gzipAccepted.value_or(anyAccepted.value_or(false)))
+    {
+        return gzip;
+    }
+    if (deflateAccepted.value_or(anyAccepted.value_or(false)))
+    {
+        return deflate;
+    }
+    return identity;
+}
+} // namespace content_encodings
+
+namespace entity_tags
+{
+
+/**
+ * @brief Format the strong entity tag of the opaque value, i.e. quote it.
+ *        The compressed representation differs from the identity one, hence
+ *        the content coding is appended to the tag of it.
+ *
+ * @param opaqueTag - the value of the tag
+ * @param encoding  - the content coding of the representation
+ * @return const std::string - the value of the 'ETag' header
+ */
+inline const std::string
+    format(std::string_view opaqueTag,
+           std::string_view encoding = content_encodings::identity)
+{
+    const bool isEncoded = encoding != content_encodings::identity;
+    std::string entityTag;
+    entityTag.reserve(opaqueTag.size() + encoding.size() + 3);
+    entityTag.append(1, '"').append(opaqueTag);
+    if (isEncoded)
+    {
+        entityTag.append(1, '-').append(encoding);
+    }
+    entityTag.append(1, '"');
+    return entityTag;
+}
+
+/**
+ * @brief Evaluate the 'If-None-Match' request header against the current
+ *        entity tag. The tags are compared by the weak comparison, i.e. the
+ *        'W/' prefix is ignored, the '*' matches any tag. The malformed list
+ *        member doesn't match.
+ *
+ * @param ifNoneMatch - the value of the 'If-None-Match' header
+ * @param entityTag   - the current entity tag, quoted
+ * @return bool - true if the representation is not modified
+ */
+inline bool match(std::string_view ifNoneMatch, std::string_view entityTag)
+{
+    constexpr std::string_view weakPrefix = "W/";
+    constexpr std::string_view separators = " \t,";
+    if (entityTag.starts_with(weakPrefix))
+    {
+        entityTag.remove_prefix(weakPrefix.size());
+    }
+
+    while (!ifNoneMatch.empty())
+    {
+        ifNoneMatch.remove_prefix(std::min(
+            ifNoneMatch.find_first_not_of(separators), ifNoneMatch.size()));
+        if (ifNoneMatch.starts_with('*'))
+        {
+            return true;
+        }
+        if (ifNoneMatch.starts_with(weakPrefix))
+        {
+            ifNoneMatch.remove_prefix(weakPrefix.size());
+        }
+
+        std::string_view::size_type tagEnd = std::string_view::npos;
+        if (ifNoneMatch.starts_with('"'))
+        {
+            tagEnd = ifNoneMatch.find('"', 1);
+        }
+        if (tagEnd == std::string_view::npos)
+        {
+            // Skip the malformed member up to the next one
+            const auto memberEnd = ifNoneMatch.find(',');
+            ifNoneMatch.remove_prefix(memberEnd == std::string_view::npos
+                                          ? ifNoneMatch.size()
+                                          : memberEnd + 1);
+            continue;
+        }
+        if (ifNoneMatch.substr(0, tagEnd + 1) == entityTag)
+        {
+            return true;
+        }
+        ifNoneMatch.remove_prefix(tagEnd + 1);
+    }
+    return false;
+}
+
+} // namespace entity_tags
+
 inline const std::string header(const std::string& name, const std::string& value)
 {
     return std::move(name + ": " + value);
@@ -489,9 +667,25 @@ inline const std::string header(const std::string& name, const std::string& valu
 
 inline const std::string headerStatus(statuses::Code code)
 {
-    return std::string(headers::http) + " " +
-           std::to_string(static_cast<int>(code)) + " " +
-           statuses::reasonPhrase(code);
+    std::string status(headers::http);
+    status.append(" ")
+        .append(std::to_string(static_cast<int>(code)))
+        .append(" ")
+        .append(statuses::reasonPhrase(code));
+    return status;
+}
+
+/**
+ * @brief Write the status line straight into the output without the
+ *        intermediate buffers.
+ *
+ * @param output - the stream of the response head
+ * @param code   - the HTTP status code
+ */
+inline void writeHeaderStatus(std::ostream& output, statuses::Code code)
+{
+    output << headers::http << ' ' << static_cast<int>(code) << ' '
+           << statuses::reasonPhrase(code) << "\r\n";
 }
 
 } // namespace http
@@ -9,9 +9,12 @@
 
 #include <core/entity/dbus_query.hpp>
 #include <core/entity/entity.hpp>
+#include <core/helpers/compares.hpp>
 
 #include <definitions.hpp>
 
+#include <string_view>
+
 namespace app
 {
 namespace query
@@ -57,18 +60,65 @@ class Relation final : public dbus::IntrospectServiceDBusQuery
 
 namespace general_relations
 {
-static const IEntity::IRelation::RelationRulesList&
+/**
+ * @brief The relation of the instances which the member of the source one is
+ *        equal to the member of the destination one.
+ */
+static const IEntity::IRelation::RelationRulesList
     relationFieldsEqual(const MemberName& sourceMember,
                         const MemberName& destMember)
 {
     using namespace std::placeholders;
-    using namespace app::entity::obmc::definitions;
 
-    static const IEntity::IRelation::RelationRulesList relations{
+    return {
         {sourceMember, destMember,
          std::bind(&helpers::compares::relationCompareEqual, _1, _2)},
     };
-    return relations;
+}
+
+/**
+ * @brief Supply the object path of the chassis to the target instance by the
+ *        'chassis' association of it: the association object is
+ *        '<target object path>/chassis', the endpoint of the association is
+ *        the object path of the chassis.
+ */
+static void linkChassis(const IEntity::InstancePtr& supplementing,
+                        const IEntity::InstancePtr& target)
+{
+    using namespace app::entity::obmc::definitions;
+    using namespace app::entity::obmc::definitions::supplement_providers;
+
+    static constexpr std::string_view chassisAssociation = "/chassis";
+
+    // Each endpoint of the association is the own complex instance, the
+    // association object itself has no endpoint.
+    if (!supplementing->hasField(relations::fieldEndpoint))
+    {
+        return;
+    }
+
+    try
+    {
+        const std::string_view associationPath =
+            supplementing->getField(metaObjectPath)->getStringValue();
+        const auto& targetPath =
+            target->getField(metaObjectPath)->getStringValue();
+        if (associationPath.size() !=
+                targetPath.size() + chassisAssociation.size() ||
+            !associationPath.starts_with(targetPath) ||
+            !associationPath.ends_with(chassisAssociation))
+        {
+            return;
+        }
+
+        target->supplementOrUpdate(
+            metaChassisPath,
+            supplementing->getField(relations::fieldEndpoint)->getValue());
+    }
+    catch (std::bad_variant_access& ex)
+    {
+        LOG_ERROR << "Invalid type of the association field: " << ex.what();
+    }
 }
 
 } // namespace general_relations
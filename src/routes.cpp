@@ -4,6 +4,7 @@
 
 #include <core/application.hpp>
 #include <core/route/handlers/graphql_handler.hpp>
+#include <core/route/handlers/metrics_handler.hpp>
 
 namespace app
 {
@@ -13,6 +14,7 @@ namespace core
 void Application::registerAllRoutes()
 {
     Router::registerUri<route::handlers::GraphqlRouter>("/api/graphql");
+    Router::registerUri<route::handlers::MetricsRouter>("/metrics");
 }
 
 } // namespace core
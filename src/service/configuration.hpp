@@ -149,6 +149,8 @@ class ConfigFile
                             session::SessionStore::getInstance().authTokens.emplace(
                                 newSession->sessionToken, newSession);
                         }
+                        session::SessionStore::getInstance()
+                            .updateSessionsCount();
                     }
                     else if (item.key() == keyTimeout)
                     {
@@ -11,6 +11,7 @@
 
 #include <nlohmann/json.hpp>
 
+#include <atomic>
 #include <memory>
 
 namespace app
@@ -321,6 +322,21 @@ class SessionStore
                 }
             }
         }
+        updateSessionsCount();
+    }
+
+    /**
+     * @brief Publish the count of the sessions to the readers which don't
+     *        own the store, e.g. the metrics exporter.
+     */
+    void updateSessionsCount()
+    {
+        sessionsCount.store(authTokens.size(), std::memory_order_relaxed);
+    }
+
+    size_t getSessionsCount() const
+    {
+        return sessionsCount.load(std::memory_order_relaxed);
     }
 
     SessionStore(const SessionStore&) = delete;
@@ -336,6 +352,8 @@ class SessionStore
     AuthConfigMethods authMethodsConfig;
 
   private:
+    std::atomic_size_t sessionsCount{0};
+
     SessionStore() : timeoutInSeconds(3600)
     {}
 };
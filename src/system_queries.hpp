@@ -218,29 +218,23 @@ class Chassis final : public dbus::FindObjectDBusQuery
         return criteria;
     }
 
-    static const DbusVariantType formatChassisType(const PropertyName&,
-                                                   const DbusVariantType& value)
+    static const FieldType formatChassisType(const PropertyName&,
+                                             const FieldType& value)
     {
-        auto formattedValue = std::visit(
-            [](auto&& chassisType) -> const DbusVariantType {
-                using TChassisType = std::decay_t<decltype(chassisType)>;
-
-                if constexpr (std::is_same_v<TChassisType, std::string>)
-                {
-                    auto findTypeIt = chassisTypesNames.find(chassisType);
-                    if (findTypeIt == chassisTypesNames.end())
-                    {
-                        return DbusVariantType(std::string(chassisTypeOther));
-                    }
+        auto chassisType = std::get_if<std::string>(&value);
+        if (chassisType == nullptr)
+        {
+            throw std::invalid_argument(
+                "Invalid value type of ChassisType property");
+        }
 
-                    return DbusVariantType(findTypeIt->second);
-                }
+        auto findTypeIt = chassisTypesNames.find(*chassisType);
+        if (findTypeIt == chassisTypesNames.end())
+        {
+            return FieldType(std::string(chassisTypeOther));
+        }
 
-                throw std::invalid_argument(
-                    "Invalid value type of ChassisType property");
-            },
-            value);
-        return formattedValue;
+        return FieldType(findTypeIt->second);
     }
 
     const FieldsFormattingMap& getFormatters() const override
@@ -503,29 +497,23 @@ class Sensors final : public dbus::FindObjectDBusQuery
             app::helpers::utils::getNameFromLastSegmentObjectPath(objectPath));
     }
 
-    static const DbusVariantType formatSensorUnit(const PropertyName&,
-                                                  const DbusVariantType& value)
+    static const FieldType formatSensorUnit(const PropertyName&,
+                                            const FieldType& value)
     {
-        auto formattedValue = std::visit(
-            [](auto&& chassisType) -> const DbusVariantType {
-                using TChassisType = std::decay_t<decltype(chassisType)>;
-
-                if constexpr (std::is_same_v<TChassisType, std::string>)
-                {
-                    auto findTypeIt = sensorUnitsMap.find(chassisType);
-                    if (findTypeIt == sensorUnitsMap.end())
-                    {
-                        return DbusVariantType(std::string(defaultUnitLabel));
-                    }
+        auto sensorUnit = std::get_if<std::string>(&value);
+        if (sensorUnit == nullptr)
+        {
+            throw std::invalid_argument(
+                "Invalid value type of Sensor Unit property");
+        }
 
-                    return DbusVariantType(findTypeIt->second);
-                }
+        auto findTypeIt = sensorUnitsMap.find(*sensorUnit);
+        if (findTypeIt == sensorUnitsMap.end())
+        {
+            return FieldType(std::string(defaultUnitLabel));
+        }
 
-                throw std::invalid_argument(
-                    "Invalid value type of Sensor Unit property");
-            },
-            value);
-        return formattedValue;
+        return FieldType(findTypeIt->second);
     }
 
     const FieldsFormattingMap& getFormatters() const override
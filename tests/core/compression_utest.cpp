@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <array>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <core/compression.hpp>
+#include <http/headers.hpp>
+
+using namespace app::core;
+using namespace app::http;
+
+// The zlib window bits to inflate both the gzip and the zlib formats
+static constexpr int autoDetectWindowBits = 15 + 32;
+
+static const std::string inflateData(const std::string& compressed)
+{
+    z_stream stream{};
+    EXPECT_EQ(Z_OK, inflateInit2(&stream, autoDetectWindowBits));
+    stream.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+    stream.avail_in = static_cast<uInt>(compressed.size());
+
+    std::string result;
+    std::array<char, 4096> buffer;
+    int status = Z_OK;
+    while (status == Z_OK)
+    {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer.data());
+        stream.avail_out = static_cast<uInt>(buffer.size());
+        status = inflate(&stream, Z_NO_FLUSH);
+        result.append(buffer.data(), buffer.size() - stream.avail_out);
+    }
+    EXPECT_EQ(Z_STREAM_END, status);
+    inflateEnd(&stream);
+    return result;
+}
+
+static const std::string makeRandomData(size_t size)
+{
+    std::mt19937 generator(size);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    std::string data(size, '\0');
+    for (auto& symbol : data)
+    {
+        symbol = static_cast<char>(distribution(generator));
+    }
+    return data;
+}
+
+TEST(compression, testRoundTrip)
+{
+    std::string data;
+    for (int index = 0; index < 10000; index++)
+    {
+        data += "{\"Name\":\"sensor" + std::to_string(index) + "\"},";
+    }
+
+    const auto gzipped =
+        DeflateStreamBuffer::compress(data, content_encodings::gzip);
+    ASSERT_GT(gzipped.size(), 2U);
+    EXPECT_EQ('\x1f', gzipped[0]);
+    EXPECT_EQ('\x8b', gzipped[1]);
+    EXPECT_LT(gzipped.size(), data.size());
+    EXPECT_EQ(data, inflateData(gzipped));
+
+    // The deflate coding is the zlib format
+    const auto deflated =
+        DeflateStreamBuffer::compress(data, content_encodings::deflate);
+    ASSERT_GT(deflated.size(), 2U);
+    EXPECT_EQ('\x78', deflated[0]);
+    EXPECT_EQ(data, inflateData(deflated));
+
+    EXPECT_EQ("", inflateData(DeflateStreamBuffer::compress(
+                      "", content_encodings::gzip)));
+}
+
+TEST(compression, testStreamWrite)
+{
+    const auto data = makeRandomData(100000);
+    std::ostringstream output;
+    DeflateStreamBuffer compressor(output, content_encodings::gzip,
+                                   CompressedResponseCache::maxEntryBytes);
+    std::ostream stream(&compressor);
+    for (size_t offset = 0; offset < data.size(); offset += 1000)
+    {
+        stream.write(data.data() + offset, 1000);
+        stream.flush();
+    }
+    EXPECT_EQ(nullptr, compressor.getCaptured());
+    ASSERT_TRUE(compressor.finish());
+
+    EXPECT_EQ(data, inflateData(output.str()));
+    ASSERT_NE(nullptr, compressor.getCaptured());
+    EXPECT_EQ(output.str(), *compressor.getCaptured());
+
+    // Nothing is written after the finish
+    EXPECT_FALSE(stream.write("tail", 4).flush().good());
+    EXPECT_EQ(data, inflateData(output.str()));
+}
+
+TEST(compression, testCaptureLimit)
+{
+    // The random data isn't compressed, hence it exceeds the limit
+    const auto data = makeRandomData(64 * 1024);
+    std::ostringstream output;
+    DeflateStreamBuffer compressor(output, content_encodings::gzip,
+                                   data.size() / 2);
+    compressor.sputn(data.data(), static_cast<std::streamsize>(data.size()));
+    ASSERT_TRUE(compressor.finish());
+    EXPECT_EQ(nullptr, compressor.getCaptured());
+    EXPECT_EQ(data, inflateData(output.str()));
+
+    // The capturing is disabled by the zero limit
+    std::ostringstream uncapturedOutput;
+    DeflateStreamBuffer uncaptured(uncapturedOutput, content_encodings::gzip);
+    uncaptured.sputn("data", 4);
+    ASSERT_TRUE(uncaptured.finish());
+    EXPECT_EQ(nullptr, uncaptured.getCaptured());
+}
+
+static std::shared_ptr<const std::string> makeBody(size_t size, char symbol)
+{
+    return std::make_shared<const std::string>(size, symbol);
+}
+
+TEST(compression, testCacheEviction)
+{
+    // The capacity of the cache holds four entries of the maximum size
+    static constexpr size_t entryBytes = CompressedResponseCache::maxEntryBytes;
+    auto& cache = CompressedResponseCache::getInstance();
+    for (char tag = '0'; tag < '4'; tag++)
+    {
+        cache.store(std::string("\"lru-") + tag + "\"", content_encodings::gzip,
+                    makeBody(entryBytes, tag));
+    }
+    for (char tag = '0'; tag < '4'; tag++)
+    {
+        EXPECT_TRUE(cache.find(std::string("\"lru-") + tag + "\"",
+                               content_encodings::gzip));
+    }
+
+    // The least recently used entry is evicted by the bytes
+    ASSERT_TRUE(cache.find("\"lru-0\"", content_encodings::gzip));
+    cache.store("\"lru-4\"", content_encodings::gzip, makeBody(1, '4'));
+    EXPECT_FALSE(cache.find("\"lru-1\"", content_encodings::gzip));
+    EXPECT_TRUE(cache.find("\"lru-0\"", content_encodings::gzip));
+    EXPECT_TRUE(cache.find("\"lru-2\"", content_encodings::gzip));
+    EXPECT_TRUE(cache.find("\"lru-4\"", content_encodings::gzip));
+
+    // The replaced entry is accounted once
+    cache.store("\"lru-4\"", content_encodings::gzip, makeBody(2, '4'));
+    EXPECT_EQ(2U, cache.find("\"lru-4\"", content_encodings::gzip)->size());
+    EXPECT_TRUE(cache.find("\"lru-3\"", content_encodings::gzip));
+}
+
+TEST(compression, testCacheEntryLimit)
+{
+    auto& cache = CompressedResponseCache::getInstance();
+    cache.store("\"big\"", content_encodings::gzip,
+                makeBody(CompressedResponseCache::maxEntryBytes + 1, 'b'));
+    EXPECT_FALSE(cache.find("\"big\"", content_encodings::gzip));
+
+    cache.store("\"null\"", content_encodings::gzip, nullptr);
+    EXPECT_FALSE(cache.find("\"null\"", content_encodings::gzip));
+
+    const auto hits = CompressedResponseCache::getHits();
+    const auto misses = CompressedResponseCache::getMisses();
+    cache.store("\"max\"", content_encodings::gzip,
+                makeBody(CompressedResponseCache::maxEntryBytes, 'm'));
+    EXPECT_TRUE(cache.find("\"max\"", content_encodings::gzip));
+    EXPECT_FALSE(cache.find("\"absent\"", content_encodings::gzip));
+    EXPECT_EQ(hits + 1, CompressedResponseCache::getHits());
+    EXPECT_EQ(misses + 1, CompressedResponseCache::getMisses());
+}
+
+TEST(compression, testCacheKeyPerEncoding)
+{
+    auto& cache = CompressedResponseCache::getInstance();
+    cache.store("\"coding\"", content_encodings::gzip, makeBody(1, 'g'));
+    EXPECT_FALSE(cache.find("\"coding\"", content_encodings::deflate));
+
+    cache.store("\"coding\"", content_encodings::deflate, makeBody(1, 'd'));
+    EXPECT_EQ("g", *cache.find("\"coding\"", content_encodings::gzip));
+    EXPECT_EQ("d", *cache.find("\"coding\"", content_encodings::deflate));
+}
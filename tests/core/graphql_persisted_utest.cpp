@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <core/route/handlers/graphql_handler.hpp>
+#include <core/route/handlers/graphql_persisted.hpp>
+#include <core/route/handlers/graphql_plan.hpp>
+
+using namespace app::core::route::handlers;
+
+namespace app
+{
+namespace core
+{
+namespace route
+{
+namespace handlers
+{
+
+// The plans aren't compiled by the test: the queries containing 'invalid'
+// are rejected as the compilation failure.
+GqlQueryPlanPtr GqlPlanCache::getPlan(const std::string& queryText)
+{
+    if (queryText.find("invalid") != std::string::npos)
+    {
+        throw exceptions::GqlAstError("invalid query");
+    }
+    return GqlQueryPlanPtr();
+}
+
+} // namespace handlers
+} // namespace route
+} // namespace core
+} // namespace app
+
+static const std::string sampleHash =
+    "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+
+static const std::string writeQueriesFile(const std::string& content)
+{
+    const std::string path =
+        testing::TempDir() + "graphql_persisted_utest.json";
+    std::ofstream(path) << content;
+    return path;
+}
+
+TEST(graphqlPersisted, testHashQuery)
+{
+    EXPECT_EQ(
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+        GqlPersistedQueries::hashQuery(""));
+    EXPECT_EQ(sampleHash, GqlPersistedQueries::hashQuery("abc"));
+    EXPECT_EQ(
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+        GqlPersistedQueries::hashQuery(
+            "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"));
+}
+
+TEST(graphqlPersisted, testAddQuery)
+{
+    auto& persistedQueries = GqlPersistedQueries::getInstance();
+    const std::string queryText = "{ Sensors { Name } }";
+    const auto hash = GqlPersistedQueries::hashQuery(queryText);
+
+    EXPECT_FALSE(persistedQueries.find(hash));
+    persistedQueries.add(hash, queryText);
+    EXPECT_EQ(queryText, persistedQueries.find(hash));
+}
+
+TEST(graphqlPersisted, testHashMismatch)
+{
+    auto& persistedQueries = GqlPersistedQueries::getInstance();
+
+    EXPECT_THROW(persistedQueries.add(sampleHash, "{ Server { Name } }"),
+                 exceptions::GqlInvalidArgument);
+    EXPECT_FALSE(persistedQueries.find(sampleHash));
+}
+
+TEST(graphqlPersisted, testEvictLeastRecentlyUsed)
+{
+    auto& persistedQueries = GqlPersistedQueries::getInstance();
+    auto addQuery = [&persistedQueries](size_t index) {
+        const auto queryText = "{ Sensors(first: " + std::to_string(index) +
+                               ") { Name } }";
+        const auto hash = GqlPersistedQueries::hashQuery(queryText);
+        persistedQueries.add(hash, queryText);
+        return hash;
+    };
+
+    std::vector<std::string> hashes;
+    for (size_t index = 0; index < GqlPersistedQueries::automaticCapacity;
+         index++)
+    {
+        hashes.push_back(addQuery(index));
+    }
+    EXPECT_TRUE(persistedQueries.find(hashes.front()));
+
+    const auto lastHash = addQuery(GqlPersistedQueries::automaticCapacity);
+    EXPECT_TRUE(persistedQueries.find(lastHash));
+    EXPECT_TRUE(persistedQueries.find(hashes.front()));
+    EXPECT_FALSE(persistedQueries.find(hashes[1]));
+    EXPECT_TRUE(persistedQueries.find(hashes[2]));
+}
+
+TEST(graphqlPersisted, testLoadInvalidFile)
+{
+    auto& persistedQueries = GqlPersistedQueries::getInstance();
+
+    EXPECT_EQ(0U, persistedQueries.load(testing::TempDir() + "not_exists"));
+    EXPECT_EQ(0U, persistedQueries.load(writeQueriesFile("{ invalid")));
+    EXPECT_EQ(0U, persistedQueries.load(writeQueriesFile("[\"abc\"]")));
+}
+
+TEST(graphqlPersisted, testLoadSkipInvalidQueries)
+{
+    auto& persistedQueries = GqlPersistedQueries::getInstance();
+    const std::string validQuery = "{ Chassis { Type } }";
+    const std::string invalidQuery = "{ invalid }";
+    const std::string mismatchedQuery = "{ Baseboard { Name } }";
+    const auto validHash = GqlPersistedQueries::hashQuery(validQuery);
+    const auto invalidHash = GqlPersistedQueries::hashQuery(invalidQuery);
+    const auto mismatchedHash =
+        GqlPersistedQueries::hashQuery(mismatchedQuery + " ");
+    const auto notStringHash = GqlPersistedQueries::hashQuery("1");
+
+    const nlohmann::json content{
+        {validHash, validQuery},
+        {invalidHash, invalidQuery},
+        {mismatchedHash, mismatchedQuery},
+        {notStringHash, 1},
+    };
+    EXPECT_EQ(1U, persistedQueries.load(writeQueriesFile(content.dump())));
+    EXPECT_EQ(validQuery, persistedQueries.find(validHash));
+    EXPECT_FALSE(persistedQueries.find(invalidHash));
+    EXPECT_FALSE(persistedQueries.find(mismatchedHash));
+    EXPECT_FALSE(persistedQueries.find(notStringHash));
+}
+
+TEST(graphqlPersisted, testRequestedHash)
+{
+    EXPECT_EQ(sampleHash, GqlPersistedQueries::getRequestedHash(
+                              {{"version", 1}, {"sha256Hash", sampleHash}}));
+}
+
+TEST(graphqlPersisted, testMalformedExtension)
+{
+    using nlohmann::json;
+
+    EXPECT_TRUE(GqlPersistedQueries::getRequestedHash(json()).empty());
+    EXPECT_TRUE(GqlPersistedQueries::getRequestedHash("1").empty());
+    EXPECT_TRUE(GqlPersistedQueries::getRequestedHash(json::array()).empty());
+    EXPECT_TRUE(GqlPersistedQueries::getRequestedHash(
+                    {{"sha256Hash", sampleHash}})
+                    .empty());
+    EXPECT_TRUE(GqlPersistedQueries::getRequestedHash(
+                    {{"version", "1"}, {"sha256Hash", sampleHash}})
+                    .empty());
+    EXPECT_TRUE(GqlPersistedQueries::getRequestedHash(
+                    {{"version", -1}, {"sha256Hash", sampleHash}})
+                    .empty());
+    EXPECT_TRUE(GqlPersistedQueries::getRequestedHash(
+                    {{"version", 1.5}, {"sha256Hash", sampleHash}})
+                    .empty());
+    EXPECT_TRUE(GqlPersistedQueries::getRequestedHash(
+                    {{"version", 2}, {"sha256Hash", sampleHash}})
+                    .empty());
+    EXPECT_TRUE(
+        GqlPersistedQueries::getRequestedHash({{"version", 1}}).empty());
+    EXPECT_TRUE(GqlPersistedQueries::getRequestedHash(
+                    {{"version", 1}, {"sha256Hash", json::object()}})
+                    .empty());
+}
@@ -0,0 +1,644 @@
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <core/entity/entity.hpp>
+#include <core/entity/snapshot.hpp>
+#include <core/helpers/json_writer.hpp>
+#include <core/route/handlers/graphql_handler.hpp>
+#include <core/route/handlers/graphql_plan.hpp>
+#include <definitions.hpp>
+#include <relation_provider.hpp>
+
+using namespace app::entity;
+using namespace app::entity::obmc::definitions;
+using namespace app::core::route::handlers;
+using namespace app::query::obmc;
+using app::core::route::handlers::exceptions::GqlInvalidArgument;
+
+namespace app
+{
+namespace core
+{
+namespace route
+{
+namespace handlers
+{
+
+// The plans are built by the test straight from the selections
+GqlQueryPlanPtr GqlPlanCache::compile(const std::string&)
+{
+    throw exceptions::GqlAstError("The plans aren't compiled by the test");
+}
+
+} // namespace handlers
+} // namespace route
+} // namespace core
+} // namespace app
+
+static const IEntity::InstancePtr
+    makeInstance(const std::map<std::string, std::string>& fields)
+{
+    auto instance = std::make_shared<SnapshotInstance>(
+        std::hash<std::string>{}(fields.at(metaObjectPath)));
+    for (const auto& [memberName, value] : fields)
+    {
+        instance->supplement(memberName, value);
+    }
+    return instance;
+}
+
+static const EntityPtr makeEntity(const std::string& name,
+                                  const std::vector<std::string>& members)
+{
+    auto entity = std::make_shared<Entity>(name);
+    for (const auto& memberName : members)
+    {
+        entity->addMember(std::make_shared<Entity::EntityMember>(memberName));
+    }
+    return entity;
+}
+
+TEST(graphqlPlan, testLinkChassis)
+{
+    using namespace supplement_providers;
+
+    auto sensor = makeInstance({{metaObjectPath, "/sensors/cpu0"}});
+    general_relations::linkChassis(
+        makeInstance({{metaObjectPath, "/sensors/cpu0/chassis"}}), sensor);
+    EXPECT_FALSE(sensor->hasField(metaChassisPath));
+
+    general_relations::linkChassis(
+        makeInstance({{metaObjectPath, "/sensors/cpu01/chassis"},
+                      {relations::fieldEndpoint, "/chassis1"}}),
+        sensor);
+    general_relations::linkChassis(
+        makeInstance({{metaObjectPath, "/sensors/cpu0/inventory"},
+                      {relations::fieldEndpoint, "/chassis2"}}),
+        sensor);
+    EXPECT_FALSE(sensor->hasField(metaChassisPath));
+
+    general_relations::linkChassis(
+        makeInstance({{metaObjectPath, "/sensors/cpu0/chassis"},
+                      {relations::fieldEndpoint, "/chassis0"}}),
+        sensor);
+    EXPECT_EQ("/chassis0",
+              sensor->getField(metaChassisPath)->getStringValue());
+}
+
+/**
+ * @brief Build the selection of the servers with the related sensors:
+ *        server0 - cpu0, cpu1; server1 - psu0; server2 - no sensors.
+ */
+static const GqlSelection makeServerSelection()
+{
+    using namespace supplement_providers;
+    using namespace std::placeholders;
+
+    auto associations = std::make_shared<EntitySupplementProvider>(
+        relations::providerRelations);
+    associations->addMember(
+        std::make_shared<Entity::EntityMember>(relations::fieldEndpoint));
+    associations->setInstances({
+        makeInstance({{metaObjectPath, "/sensors/cpu0/chassis"}}),
+        makeInstance({{metaObjectPath, "/sensors/cpu0/chassis"},
+                      {relations::fieldEndpoint, "/chassis0"}}),
+        makeInstance({{metaObjectPath, "/sensors/cpu1/chassis"},
+                      {relations::fieldEndpoint, "/chassis0"}}),
+        makeInstance({{metaObjectPath, "/sensors/psu0/chassis"},
+                      {relations::fieldEndpoint, "/chassis1"}}),
+    });
+
+    auto server = makeEntity(entityServer, {metaObjectPath, fieldName});
+    auto sensors =
+        makeEntity(entitySensors, {metaObjectPath, metaChassisPath, fieldName});
+    sensors->linkSupplementProvider(
+        associations, std::bind(&general_relations::linkChassis, _1, _2),
+        {metaChassisPath});
+    auto relation = std::make_shared<Entity::Relation>(server, sensors);
+    relation->addConditionBuildRules(general_relations::relationFieldsEqual(
+        metaObjectPath, metaChassisPath));
+    server->addRelation(relation);
+
+    server->setInstances({
+        makeInstance({{metaObjectPath, "/chassis0"}, {fieldName, "server0"}}),
+        makeInstance({{metaObjectPath, "/chassis1"}, {fieldName, "server1"}}),
+        makeInstance({{metaObjectPath, "/chassis2"}, {fieldName, "server2"}}),
+    });
+    sensors->setInstances({
+        makeInstance({{metaObjectPath, "/sensors/cpu0"}, {fieldName, "cpu0"}}),
+        makeInstance({{metaObjectPath, "/sensors/cpu1"}, {fieldName, "cpu1"}}),
+        makeInstance({{metaObjectPath, "/sensors/psu0"}, {fieldName, "psu0"}}),
+        makeInstance({{metaObjectPath, "/sensors/fan0"}, {fieldName, "fan0"}}),
+    });
+
+    GqlSelection sensorsSelection{
+        entitySensors, entitySensors, sensors, {}, {}, {}, relation};
+    sensorsSelection.selections.push_back(GqlSelection{
+        fieldName, fieldName, {}, sensors->getMember(fieldName), {}, {}, {}});
+    GqlSelection serverSelection{
+        entityServer, entityServer, server, {}, {}, {}, {}};
+    serverSelection.selections.push_back(GqlSelection{
+        fieldName, fieldName, {}, server->getMember(fieldName), {}, {}, {}});
+    serverSelection.selections.push_back(sensorsSelection);
+    return serverSelection;
+}
+
+TEST(graphqlPlan, testRelatedChildrenPerParent)
+{
+    const auto serverSelection = makeServerSelection();
+    auto resolved =
+        GqlResolvedSelection::resolve(serverSelection, nlohmann::json());
+    std::ostringstream output;
+    app::helpers::writer::JsonWriter writer(output, 2);
+    resolved.write(writer);
+    const auto result = nlohmann::json::parse(output.str());
+
+    std::map<std::string, std::set<std::string>> sensorsByServer;
+    ASSERT_TRUE(result.is_array());
+    for (const auto& serverResult : result)
+    {
+        auto& serverSensors = sensorsByServer[serverResult[fieldName]];
+        const auto& sensorsResult = serverResult[entitySensors];
+        if (sensorsResult.is_object())
+        {
+            if (sensorsResult.contains(fieldName))
+            {
+                serverSensors.insert(sensorsResult[fieldName]);
+            }
+            continue;
+        }
+        for (const auto& sensorResult : sensorsResult)
+        {
+            serverSensors.insert(sensorResult[fieldName]);
+        }
+    }
+
+    const std::map<std::string, std::set<std::string>> expected{
+        {"server0", {"cpu0", "cpu1"}},
+        {"server1", {"psu0"}},
+        {"server2", {}},
+    };
+    EXPECT_EQ(expected, sensorsByServer);
+}
+
+TEST(graphqlPlan, testRenderingByDepth)
+{
+    const auto serverSelection = makeServerSelection();
+    auto resolved =
+        GqlResolvedSelection::resolve(serverSelection, nlohmann::json());
+
+    std::ostringstream output;
+    app::helpers::writer::JsonWriter writer(output, 2);
+    resolved.write(writer);
+    EXPECT_EQ(nlohmann::json::parse(output.str()).dump(2), output.str());
+
+    // The nested selections are rendered again at the deeper level
+    std::ostringstream nestedOutput;
+    app::helpers::writer::JsonWriter nestedWriter(nestedOutput, 2);
+    nestedWriter.beginObject();
+    nestedWriter.key("data");
+    resolved.write(nestedWriter);
+    nestedWriter.endObject();
+    EXPECT_EQ(nlohmann::json::parse(nestedOutput.str()).dump(2),
+              nestedOutput.str());
+}
+
+TEST(graphqlPlan, testOperationName)
+{
+    auto plan = std::make_shared<GqlQueryPlan>(0);
+    plan->addOperation("query", "").selections.push_back(makeServerSelection());
+
+    // The document of the single operation is executed without the name
+    EXPECT_EQ("query", plan->getOperation("").name);
+    EXPECT_FALSE(plan->isSubscription(""));
+    EXPECT_THROW(plan->getOperation("Servers"), GqlInvalidArgument);
+
+    plan->addOperation("subscription", "Watch");
+    EXPECT_THROW(plan->getOperation(""), GqlInvalidArgument);
+    EXPECT_THROW(plan->execute(nlohmann::json::object(), ""),
+                 GqlInvalidArgument);
+    EXPECT_TRUE(plan->isSubscription("Watch"));
+
+    // Only the selected operation is estimated and executed
+    EXPECT_EQ(0U, plan->estimateCost(nlohmann::json::object(), "Watch").nodes);
+    auto result = plan->execute(nlohmann::json::object(), "Watch");
+    std::ostringstream output;
+    app::helpers::writer::JsonWriter writer(output);
+    result->write(writer);
+    EXPECT_EQ(nlohmann::json::parse(R"({"subscription":{}})"),
+              nlohmann::json::parse(output.str()));
+    EXPECT_THROW(plan->getEntityTag(0, "Unknown"), GqlInvalidArgument);
+
+    // The tag is the hex of the whole hash, it depends on the operation
+    const auto entityTag = plan->getEntityTag(0, "Watch");
+    EXPECT_FALSE(entityTag.empty());
+    EXPECT_LE(entityTag.size(), sizeof(std::size_t) * 2);
+    EXPECT_EQ(std::string::npos,
+              entityTag.find_first_not_of("0123456789abcdef"));
+    EXPECT_EQ(entityTag, plan->getEntityTag(0, "Watch"));
+    EXPECT_NE(entityTag, plan->getEntityTag(1, "Watch"));
+}
+
+using FieldType = IEntity::IEntityMember::IInstance::FieldType;
+
+static constexpr const char* fieldValue = "Value";
+
+/**
+ * @brief Build the selection of the sensors names. The instances hashes are
+ *        the positions of the names starting from 1, hence the cursors are
+ *        predictable.
+ */
+static const GqlSelection
+    makeSensorsSelection(const std::vector<std::string>& names,
+                         const std::vector<FieldType>& values = {})
+{
+    auto sensors = makeEntity(entitySensors, {fieldName, fieldValue});
+    std::vector<IEntity::InstancePtr> instances;
+    // The instances are stored in the reverse order of the cursors
+    for (std::size_t index = names.size(); index > 0; index--)
+    {
+        auto instance = std::make_shared<SnapshotInstance>(index);
+        instance->supplement(fieldName, names[index - 1]);
+        if (index <= values.size())
+        {
+            instance->supplement(fieldValue, values[index - 1]);
+        }
+        instances.push_back(instance);
+    }
+    sensors->setInstances(instances);
+
+    GqlSelection selection{
+        entitySensors, entitySensors, sensors, {}, {}, {}, {}};
+    selection.selections.push_back(GqlSelection{
+        fieldName, fieldName, {}, sensors->getMember(fieldName), {}, {}, {}});
+    return selection;
+}
+
+static const std::vector<std::string>
+    resolveNames(GqlSelection selection, const nlohmann::json& arguments)
+{
+    for (const auto& [name, value] : arguments.items())
+    {
+        selection.arguments.values.emplace(name, GqlArgumentValue{value, {}});
+    }
+    std::vector<std::string> names;
+    const auto resolved =
+        GqlResolvedSelection::resolve(selection, nlohmann::json::object());
+    for (const auto& instance : resolved.instances)
+    {
+        names.push_back(instance->getField(fieldName)->getStringValue());
+    }
+    return names;
+}
+
+static const std::vector<std::string> filterNames(const GqlSelection& selection,
+                                                  const nlohmann::json& filter)
+{
+    auto names = resolveNames(selection, {{"filter", filter}});
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+TEST(graphqlPlan, testFilterWildcard)
+{
+    using Names = std::vector<std::string>;
+    const auto selection = makeSensorsSelection(
+        {"cpu0", "cpu10", "cpu1_temp", "psu0", "abcabd", "aaab"});
+
+    EXPECT_EQ((Names{"cpu0"}), filterNames(selection, {{fieldName, "cpu0"}}));
+    EXPECT_EQ((Names{"cpu0", "cpu10", "cpu1_temp"}),
+              filterNames(selection, {{fieldName, "cpu*"}}));
+    EXPECT_EQ((Names{"cpu0", "cpu10", "psu0"}),
+              filterNames(selection, {{fieldName, "*0"}}));
+    EXPECT_EQ((Names{"cpu0"}), filterNames(selection, {{fieldName, "cpu?"}}));
+    EXPECT_EQ((Names{"cpu0", "psu0"}),
+              filterNames(selection, {{fieldName, "??u?"}}));
+    EXPECT_EQ(Names{}, filterNames(selection, {{fieldName, "cpu"}}));
+    EXPECT_EQ(Names{}, filterNames(selection, {{fieldName, "cpu0?"}}));
+
+    // The star is expanded again once the rest of the pattern fails
+    EXPECT_EQ((Names{"abcabd"}), filterNames(selection, {{fieldName, "a*bd"}}));
+    EXPECT_EQ((Names{"aaab"}), filterNames(selection, {{fieldName, "*ab"}}));
+    EXPECT_EQ((Names{"aaab", "abcabd"}),
+              filterNames(selection, {{fieldName, "a*a*b*"}}));
+    EXPECT_EQ((Names{"cpu1_temp"}),
+              filterNames(selection, {{fieldName, "*p*_*p"}}));
+    EXPECT_EQ(6U, filterNames(selection, {{fieldName, "**"}}).size());
+
+    // The list of values matches any of them
+    EXPECT_EQ((Names{"cpu10", "psu0"}),
+              filterNames(selection, {{fieldName, {"psu*", "cpu10", "fan0"}}}));
+}
+
+TEST(graphqlPlan, testFilterValues)
+{
+    using Names = std::vector<std::string>;
+    const auto selection = makeSensorsSelection(
+        {"int", "double", "bool", "text"},
+        {int64_t(42), 42.0, true, std::string("42")});
+
+    // The numbers are compared by the value, not by the type
+    EXPECT_EQ((Names{"double", "int"}),
+              filterNames(selection, {{fieldValue, 42}}));
+    EXPECT_EQ((Names{"double", "int"}),
+              filterNames(selection, {{fieldValue, 42.0}}));
+    EXPECT_EQ(Names{}, filterNames(selection, {{fieldValue, 42.5}}));
+    EXPECT_EQ((Names{"bool"}), filterNames(selection, {{fieldValue, true}}));
+    EXPECT_EQ(Names{}, filterNames(selection, {{fieldValue, 1}}));
+    EXPECT_EQ((Names{"text"}), filterNames(selection, {{fieldValue, "42"}}));
+    EXPECT_EQ((Names{"text"}), filterNames(selection, {{fieldValue, "4?"}}));
+
+    EXPECT_THROW(filterNames(selection, nlohmann::json::array()),
+                 GqlInvalidArgument);
+    EXPECT_THROW(filterNames(selection, {{"Unknown", 1}}), GqlInvalidArgument);
+    EXPECT_THROW(
+        filterNames(selection, {{fieldValue, nlohmann::json::array()}}),
+        GqlInvalidArgument);
+    EXPECT_THROW(
+        filterNames(selection, {{fieldValue, nlohmann::json::object()}}),
+        GqlInvalidArgument);
+    EXPECT_THROW(filterNames(selection, {{fieldValue, nullptr}}),
+                 GqlInvalidArgument);
+}
+
+TEST(graphqlPlan, testPagination)
+{
+    using Names = std::vector<std::string>;
+    const auto selection =
+        makeSensorsSelection({"s1", "s2", "s3", "s4", "s5"});
+    auto cursor = [](std::size_t hash) {
+        return GqlSelection::formatCursor(hash);
+    };
+
+    // The page is ordered by the cursors
+    EXPECT_EQ((Names{"s1", "s2"}), resolveNames(selection, {{"first", 2}}));
+    EXPECT_EQ((Names{"s1", "s2", "s3", "s4", "s5"}),
+              resolveNames(selection, {{"first", 10}}));
+    EXPECT_EQ(Names{}, resolveNames(selection, {{"first", 0}}));
+    EXPECT_EQ((Names{"s3", "s4"}),
+              resolveNames(selection, {{"first", 2}, {"after", cursor(2)}}));
+    EXPECT_EQ((Names{"s1", "s2", "s3", "s4", "s5"}),
+              resolveNames(selection, {{"after", cursor(0)}}));
+    EXPECT_EQ(Names{}, resolveNames(selection, {{"after", cursor(5)}}));
+    EXPECT_EQ(Names{}, resolveNames(selection, {{"after", cursor(100)}}));
+    EXPECT_EQ(Names{},
+              resolveNames(selection, {{"first", 0}, {"after", cursor(1)}}));
+
+    EXPECT_THROW(resolveNames(selection, {{"first", -1}}), GqlInvalidArgument);
+    EXPECT_THROW(resolveNames(selection, {{"first", 1.5}}),
+                 GqlInvalidArgument);
+    EXPECT_THROW(resolveNames(selection, {{"first", "2"}}),
+                 GqlInvalidArgument);
+}
+
+TEST(graphqlPlan, testInvalidCursor)
+{
+    const auto selection = makeSensorsSelection({"s1", "s2"});
+    for (const auto& after : {nlohmann::json(""), nlohmann::json("xyz"),
+                              nlohmann::json("12g"), nlohmann::json("-1"),
+                              nlohmann::json(" 1"), nlohmann::json(1),
+                              nlohmann::json("1ffffffffffffffff")})
+    {
+        EXPECT_THROW(resolveNames(selection, {{"after", after}}),
+                     GqlInvalidArgument)
+            << after.dump();
+    }
+    EXPECT_EQ(std::vector<std::string>{"s2"},
+              resolveNames(selection, {{"after", "1"}}));
+    EXPECT_EQ(std::vector<std::string>{"s2"},
+              resolveNames(selection, {{"after", "01"}}));
+}
+
+TEST(graphqlPlan, testVariablesCoercion)
+{
+    using Names = std::vector<std::string>;
+    auto selection = makeSensorsSelection({"cpu0", "cpu1", "psu0"});
+    selection.arguments.values.emplace(
+        "first",
+        GqlArgumentValue{nullptr, {{nlohmann::json::json_pointer(), "limit"}}});
+    selection.arguments.values.emplace(
+        "filter", GqlArgumentValue{{{fieldName, nullptr}},
+                                   {{nlohmann::json::json_pointer("/Name"),
+                                     "pattern"}}});
+
+    auto plan = std::make_shared<GqlQueryPlan>(0);
+    auto& operation = plan->addOperation("query", "");
+    operation.selections.push_back(selection);
+    operation.variables.emplace("limit", 2);
+    operation.variables.emplace("pattern", "*");
+
+    auto executeNames = [&plan](const nlohmann::json& variables) {
+        std::ostringstream output;
+        app::helpers::writer::JsonWriter writer(output);
+        plan->execute(variables, "")->write(writer);
+        // The single instance is written as the object
+        auto sensors =
+            nlohmann::json::parse(output.str())["query"][entitySensors];
+        if (!sensors.is_array())
+        {
+            sensors = nlohmann::json::array({sensors});
+        }
+        Names names;
+        for (const auto& sensor : sensors)
+        {
+            if (sensor.contains(fieldName))
+            {
+                names.push_back(sensor[fieldName]);
+            }
+        }
+        return names;
+    };
+
+    // The missed variables take the default values, the undefined ones are
+    // ignored.
+    EXPECT_EQ((Names{"cpu0", "cpu1"}),
+              executeNames(nlohmann::json::object()));
+    EXPECT_EQ((Names{"cpu0", "cpu1"}), executeNames({{"other", 1}}));
+    EXPECT_EQ((Names{"psu0"}),
+              executeNames({{"limit", 5}, {"pattern", "psu*"}}));
+    EXPECT_EQ((Names{"cpu0"}), executeNames({{"limit", 1}}));
+
+    // The null variable value isn't replaced by the default one
+    EXPECT_EQ(3U, executeNames({{"limit", nullptr}}).size());
+    EXPECT_THROW(executeNames({{"pattern", nullptr}}), GqlInvalidArgument);
+    EXPECT_THROW(executeNames({{"limit", "2"}}), GqlInvalidArgument);
+    EXPECT_THROW(executeNames({{"limit", -2}}), GqlInvalidArgument);
+}
+
+TEST(graphqlPlan, testChangedInstances)
+{
+    using Hashes = std::set<std::size_t>;
+    auto selection = makeSensorsSelection({"s1", "s2", "s3"});
+    const auto& sensors = selection.entity;
+    const auto versionsHash = GqlQueryPlan::getVersionsHash(selection);
+    const auto structureHash = GqlQueryPlan::getStructureHash(selection);
+    uint64_t position = 0;
+    EXPECT_EQ(Hashes{}, sensors->getChangedInstances(position));
+
+    // The instances changed in place don't change the structure
+    sensors->bumpVersion(2);
+    sensors->bumpVersion(3);
+    sensors->bumpVersion(2);
+    EXPECT_NE(versionsHash, GqlQueryPlan::getVersionsHash(selection));
+    EXPECT_EQ(structureHash, GqlQueryPlan::getStructureHash(selection));
+    const auto seenPosition = position;
+    EXPECT_EQ((Hashes{2, 3}), sensors->getChangedInstances(position));
+    EXPECT_EQ(Hashes{}, sensors->getChangedInstances(position));
+
+    // Only the changed instances are resolved, the filter is still applied
+    auto resolveChanged = [&selection](const Hashes& hashes) {
+        std::vector<std::string> names;
+        const auto resolved = GqlResolvedSelection::resolve(
+            selection, nlohmann::json::object(), hashes);
+        for (const auto& instance : resolved.instances)
+        {
+            names.push_back(instance->getField(fieldName)->getStringValue());
+        }
+        return names;
+    };
+    EXPECT_EQ((std::vector<std::string>{"s2", "s3"}),
+              resolveChanged({2, 3, 10}));
+    selection.arguments.values.emplace(
+        "filter", GqlArgumentValue{{{fieldName, "s3"}}, {}});
+    EXPECT_EQ(std::vector<std::string>{"s3"}, resolveChanged({2, 3}));
+
+    // The changes are unknown once the log is overflowed
+    for (std::size_t index = 0; index < Entity::maxChangesLog; index++)
+    {
+        sensors->bumpVersion(1);
+    }
+    auto stalePosition = seenPosition;
+    EXPECT_FALSE(sensors->getChangedInstances(stalePosition));
+    EXPECT_EQ(position + Entity::maxChangesLog, stalePosition);
+    EXPECT_EQ(Hashes{1}, sensors->getChangedInstances(position));
+
+    sensors->setInstances({});
+    EXPECT_NE(structureHash, GqlQueryPlan::getStructureHash(selection));
+}
+
+/**
+ * @brief Get the cost limit exceeded by the single operation plan of the
+ *        selection, empty if the cost is in the limits.
+ */
+static const std::string exceededLimit(const GqlSelection& selection)
+{
+    auto plan = std::make_shared<GqlQueryPlan>(0);
+    plan->addOperation("query", "").selections.push_back(selection);
+    try
+    {
+        plan->checkCost(nlohmann::json::object(), "");
+    }
+    catch (app::core::route::handlers::exceptions::GqlCostExceeded& ex)
+    {
+        return ex.whatJson()["Limit"];
+    }
+    return std::string();
+}
+
+static const GqlQueryCost estimateCost(const GqlSelection& selection)
+{
+    auto plan = std::make_shared<GqlQueryPlan>(0);
+    plan->addOperation("query", "").selections.push_back(selection);
+    return plan->estimateCost(nlohmann::json::object(), "");
+}
+
+/**
+ * @brief Nest the unrelated object selections, the root one is the level 1
+ */
+static const GqlSelection makeNestedSelection(const GqlSelection& leaf,
+                                              std::size_t levels)
+{
+    auto selection = leaf;
+    for (std::size_t level = 1; level < levels; level++)
+    {
+        auto parent = leaf;
+        parent.selections.push_back(selection);
+        selection = std::move(parent);
+    }
+    return selection;
+}
+
+TEST(graphqlPlan, testCostDepth)
+{
+    const auto leaf = makeSensorsSelection({"s1"});
+
+    const auto underLimit = makeNestedSelection(leaf, GqlQueryCost::maxDepth);
+    EXPECT_EQ(GqlQueryCost::maxDepth, estimateCost(underLimit).depth);
+    EXPECT_EQ("", exceededLimit(underLimit));
+
+    const auto overLimit =
+        makeNestedSelection(leaf, GqlQueryCost::maxDepth + 1);
+    EXPECT_EQ(GqlQueryCost::maxDepth + 1, estimateCost(overLimit).depth);
+    EXPECT_EQ("depth", exceededLimit(overLimit));
+}
+
+TEST(graphqlPlan, testCostNodes)
+{
+    // The root selection and each of the nested ones are the nodes
+    auto selection = makeSensorsSelection({"s1"});
+    const auto scalar = selection.selections.front();
+    while (selection.selections.size() + 1 < GqlQueryCost::maxNodes)
+    {
+        selection.selections.push_back(scalar);
+    }
+    EXPECT_EQ(GqlQueryCost::maxNodes, estimateCost(selection).nodes);
+    EXPECT_EQ("", exceededLimit(selection));
+
+    selection.selections.push_back(scalar);
+    EXPECT_EQ(GqlQueryCost::maxNodes + 1, estimateCost(selection).nodes);
+    EXPECT_EQ("nodes", exceededLimit(selection));
+}
+
+TEST(graphqlPlan, testCostOutputBytes)
+{
+    // Each symbol of the response name is written once per instance
+    static constexpr std::size_t instancesCount = 256;
+    auto selection = makeSensorsSelection(
+        std::vector<std::string>(instancesCount, "sensor"));
+    auto& scalar = selection.selections.front();
+    scalar.responseName = "n";
+    const auto probeBytes = estimateCost(selection).outputBytes;
+    ASSERT_LT(probeBytes, GqlQueryCost::maxOutputBytes);
+
+    const auto extraSymbols =
+        (GqlQueryCost::maxOutputBytes - probeBytes) / instancesCount;
+    scalar.responseName.append(extraSymbols, 'n');
+    const auto underLimitBytes = estimateCost(selection).outputBytes;
+    EXPECT_EQ(probeBytes + extraSymbols * instancesCount, underLimitBytes);
+    EXPECT_LE(underLimitBytes, GqlQueryCost::maxOutputBytes);
+    EXPECT_EQ("", exceededLimit(selection));
+
+    scalar.responseName.push_back('n');
+    EXPECT_GT(estimateCost(selection).outputBytes,
+              GqlQueryCost::maxOutputBytes);
+    EXPECT_EQ("outputBytes", exceededLimit(selection));
+
+    // The 'first' argument bounds the estimated instances
+    selection.arguments.values.emplace("first", GqlArgumentValue{1, {}});
+    EXPECT_EQ("", exceededLimit(selection));
+}
+
+TEST(graphqlPlan, testCostSaturation)
+{
+    // Each unrelated nested level is written into each parent instance, so
+    // the estimation is the power of the instances count.
+    const auto leaf =
+        makeSensorsSelection(std::vector<std::string>(1000, "sensor"));
+    const auto selection = makeNestedSelection(leaf, GqlQueryCost::maxDepth);
+
+    const auto cost = estimateCost(selection);
+    EXPECT_EQ(std::numeric_limits<std::size_t>::max(), cost.outputBytes);
+    EXPECT_EQ("outputBytes", exceededLimit(selection));
+
+    // The deeper nesting keeps the estimation saturated
+    EXPECT_EQ(std::numeric_limits<std::size_t>::max(),
+              estimateCost(makeNestedSelection(leaf, 64)).outputBytes);
+}
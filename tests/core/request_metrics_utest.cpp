@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+
+#include <core/request_metrics.hpp>
+
+using namespace app::core;
+
+TEST(requestMetrics, testLinearBuckets)
+{
+    for (uint64_t microseconds = 0; microseconds < LatencyHistogram::subBuckets;
+         microseconds++)
+    {
+        EXPECT_EQ(microseconds, LatencyHistogram::getBucketIndex(microseconds));
+        EXPECT_EQ(microseconds + 1,
+                  LatencyHistogram::getBucketUpperBound(microseconds));
+    }
+}
+
+TEST(requestMetrics, testBucketBoundaries)
+{
+    EXPECT_EQ(8U, LatencyHistogram::getBucketIndex(8));
+    EXPECT_EQ(9U, LatencyHistogram::getBucketUpperBound(8));
+    EXPECT_EQ(15U, LatencyHistogram::getBucketIndex(15));
+    EXPECT_EQ(16U, LatencyHistogram::getBucketUpperBound(15));
+    EXPECT_EQ(16U, LatencyHistogram::getBucketIndex(16));
+    EXPECT_EQ(16U, LatencyHistogram::getBucketIndex(17));
+    EXPECT_EQ(18U, LatencyHistogram::getBucketUpperBound(16));
+    EXPECT_EQ(17U, LatencyHistogram::getBucketIndex(18));
+    EXPECT_EQ(24U, LatencyHistogram::getBucketIndex(32));
+    EXPECT_EQ(36U, LatencyHistogram::getBucketUpperBound(24));
+
+    // Each value is below the upper bound of its bucket and not below the
+    // upper bound of the previous one.
+    for (uint64_t microseconds = 1; microseconds < (1U << 20U);
+         microseconds += microseconds / 64 + 1)
+    {
+        const auto bucketIndex = LatencyHistogram::getBucketIndex(microseconds);
+        ASSERT_LT(microseconds,
+                  LatencyHistogram::getBucketUpperBound(bucketIndex));
+        ASSERT_LE(LatencyHistogram::getBucketUpperBound(bucketIndex - 1),
+                  microseconds);
+    }
+}
+
+TEST(requestMetrics, testBucketsClamping)
+{
+    constexpr auto lastBucket = LatencyHistogram::bucketsCount - 1;
+    constexpr uint64_t maxCovered = uint64_t(1) << 40U;
+
+    EXPECT_EQ(maxCovered, LatencyHistogram::getBucketUpperBound(lastBucket));
+    EXPECT_EQ(lastBucket, LatencyHistogram::getBucketIndex(maxCovered - 1));
+    EXPECT_EQ(lastBucket, LatencyHistogram::getBucketIndex(maxCovered));
+    EXPECT_EQ(lastBucket, LatencyHistogram::getBucketIndex(
+                              std::numeric_limits<uint64_t>::max()));
+}
+
+TEST(requestMetrics, testQuantile)
+{
+    LatencyHistogram::Snapshot snapshot;
+    EXPECT_EQ(0U, snapshot.getQuantile(0.5));
+
+    LatencyHistogram histogram;
+    for (uint64_t microseconds = 1; microseconds <= 100; microseconds++)
+    {
+        histogram.record(microseconds);
+    }
+    histogram.collect(snapshot);
+    EXPECT_EQ(100U, snapshot.count);
+    EXPECT_EQ(5050U, snapshot.sumMicroseconds);
+
+    // The median is the 50th value, the bucket [48, 52) holds it
+    EXPECT_EQ(52U, snapshot.getQuantile(0.5));
+    EXPECT_EQ(2U, snapshot.getQuantile(0.0));
+    EXPECT_EQ(104U, snapshot.getQuantile(1.0));
+    EXPECT_EQ(LatencyHistogram::getBucketUpperBound(
+                  LatencyHistogram::getBucketIndex(99)),
+              snapshot.getQuantile(0.99));
+
+    // The quantile out of the range is clamped
+    EXPECT_EQ(snapshot.getQuantile(0.0), snapshot.getQuantile(-1.0));
+    EXPECT_EQ(snapshot.getQuantile(1.0), snapshot.getQuantile(2.0));
+}
@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <core/request.hpp>
+#include <core/route/route_table.hpp>
+#include <core/router.hpp>
+
+using namespace app::core;
+using namespace app::core::route;
+
+static void addRoute(RouteTable& routeTable, const std::string& pattern)
+{
+    routeTable.add(pattern, []() { return RouteHandlerUni(); });
+}
+
+static const std::string matchPattern(const RouteTable& routeTable,
+                                      std::string_view path)
+{
+    auto match = routeTable.match(path);
+    return match ? routeTable.getRoute(*match.routeIndex).pattern
+                 : std::string();
+}
+
+static const std::vector<std::string_view>
+    matchParameters(const RouteTable& routeTable, std::string_view path)
+{
+    auto match = routeTable.match(path);
+    return std::vector<std::string_view>(
+        match.parameters.begin(),
+        match.parameters.begin() +
+            static_cast<std::ptrdiff_t>(match.parametersCount));
+}
+
+TEST(routeTable, testLiteralOverParameter)
+{
+    RouteTable routeTable;
+    addRoute(routeTable, "/api/{name}");
+    addRoute(routeTable, "/api/graphql");
+
+    EXPECT_EQ("/api/graphql", matchPattern(routeTable, "/api/graphql"));
+    EXPECT_TRUE(matchParameters(routeTable, "/api/graphql").empty());
+    EXPECT_EQ("/api/{name}", matchPattern(routeTable, "/api/metrics"));
+    EXPECT_EQ(std::vector<std::string_view>{"metrics"},
+              matchParameters(routeTable, "/api/metrics"));
+    EXPECT_EQ("", matchPattern(routeTable, "/api"));
+    EXPECT_EQ("", matchPattern(routeTable, "/api/graphql/extra"));
+    EXPECT_EQ("", matchPattern(routeTable, "/other"));
+}
+
+TEST(routeTable, testBacktracking)
+{
+    RouteTable routeTable;
+    addRoute(routeTable, "/a/b/d");
+    addRoute(routeTable, "/a/{first}/c");
+    addRoute(routeTable, "/a/{first}/{second}/e");
+
+    // The literal 'b' branch fails on 'c', the parameter branch matches
+    EXPECT_EQ("/a/{first}/c", matchPattern(routeTable, "/a/b/c"));
+    EXPECT_EQ(std::vector<std::string_view>{"b"},
+              matchParameters(routeTable, "/a/b/c"));
+    EXPECT_EQ("/a/b/d", matchPattern(routeTable, "/a/b/d"));
+
+    // The parameters of the failed branch are dropped
+    EXPECT_EQ("/a/{first}/{second}/e", matchPattern(routeTable, "/a/b/c/e"));
+    EXPECT_EQ((std::vector<std::string_view>{"b", "c"}),
+              matchParameters(routeTable, "/a/b/c/e"));
+    EXPECT_EQ("", matchPattern(routeTable, "/a/b/c/f"));
+    EXPECT_TRUE(matchParameters(routeTable, "/a/b/c/f").empty());
+}
+
+TEST(routeTable, testPrefix)
+{
+    RouteTable routeTable;
+    addRoute(routeTable, "/static/*");
+    addRoute(routeTable, "/static/{file}");
+    addRoute(routeTable, "/static/css/main");
+
+    EXPECT_EQ("/static/*", matchPattern(routeTable, "/static"));
+    EXPECT_EQ("/static/{file}", matchPattern(routeTable, "/static/index"));
+    EXPECT_EQ("/static/css/main", matchPattern(routeTable, "/static/css/main"));
+    EXPECT_EQ("/static/*", matchPattern(routeTable, "/static/css/other"));
+    EXPECT_EQ("/static/*", matchPattern(routeTable, "/static/a/b/c"));
+    EXPECT_TRUE(matchParameters(routeTable, "/static/a/b/c").empty());
+    EXPECT_EQ("", matchPattern(routeTable, "/other/a"));
+}
+
+TEST(routeTable, testEmptySegments)
+{
+    RouteTable routeTable;
+    addRoute(routeTable, "//api///graphql/");
+
+    EXPECT_EQ("//api///graphql/", matchPattern(routeTable, "/api/graphql"));
+    EXPECT_EQ("//api///graphql/", matchPattern(routeTable, "api/graphql//"));
+    EXPECT_EQ("", matchPattern(routeTable, "/api"));
+    EXPECT_THROW(addRoute(routeTable, "/api/graphql"), std::invalid_argument);
+}
+
+TEST(routeTable, testInvalidPatterns)
+{
+    RouteTable routeTable;
+    addRoute(routeTable, "/api/graphql");
+    addRoute(routeTable, "/files/*");
+    addRoute(routeTable, "/{a}/{b}/{c}/{d}");
+
+    EXPECT_THROW(addRoute(routeTable, "/api/graphql"), std::invalid_argument);
+    EXPECT_THROW(addRoute(routeTable, "/files/*"), std::invalid_argument);
+    EXPECT_THROW(addRoute(routeTable, "/files/*/name"),
+                 std::invalid_argument);
+    EXPECT_THROW(addRoute(routeTable, "/{a}/{b}/{c}/{d}/{e}"),
+                 std::invalid_argument);
+    EXPECT_EQ(3U, routeTable.size());
+}
+
+namespace
+{
+
+class PoolHandler final : public IRouteHandler
+{
+  public:
+    static inline size_t created = 0;
+    static inline size_t resets = 0;
+
+    explicit PoolHandler(const std::string&)
+    {
+        created++;
+    }
+    ~PoolHandler() override = default;
+
+    void run(const RequestPtr&, ResponseUni&) override
+    {}
+    bool preHandlers(const RequestPtr&) override
+    {
+        return true;
+    }
+    void reset() override
+    {
+        resets++;
+    }
+};
+
+class PoolRouter final : public Router
+{
+  public:
+    using Router::acquireHandler;
+    using Router::releaseHandler;
+    using Router::Router;
+};
+
+} // namespace
+
+TEST(routeTable, testHandlersPoolReuse)
+{
+    // The idle handlers kept by the router per route and thread
+    static constexpr size_t handlersPoolSize = 4;
+    Router::registerUri<PoolHandler>("/pool");
+
+    Environment<char> environment;
+    environment.requestUri = "/pool?query=1";
+    auto request = std::make_shared<Request>(environment);
+
+    {
+        PoolRouter router(request);
+        ASSERT_TRUE(router.acquireHandler());
+        EXPECT_EQ(1U, PoolHandler::created);
+        router.releaseHandler();
+        EXPECT_EQ(1U, PoolHandler::resets);
+    }
+    {
+        // The idle handler is reused once it has been reset
+        PoolRouter router(request);
+        ASSERT_TRUE(router.acquireHandler());
+        EXPECT_EQ(1U, PoolHandler::created);
+    }
+    EXPECT_EQ(2U, PoolHandler::resets);
+
+    // The pool keeps the bounded count of the idle handlers
+    std::vector<std::unique_ptr<PoolRouter>> routers;
+    for (size_t index = 0; index <= handlersPoolSize; index++)
+    {
+        routers.push_back(std::make_unique<PoolRouter>(request));
+        ASSERT_TRUE(routers.back()->acquireHandler());
+    }
+    EXPECT_EQ(handlersPoolSize + 1, PoolHandler::created);
+    routers.clear();
+    EXPECT_EQ(2 + handlersPoolSize, PoolHandler::resets);
+
+    for (size_t index = 0; index <= handlersPoolSize; index++)
+    {
+        routers.push_back(std::make_unique<PoolRouter>(request));
+        ASSERT_TRUE(routers.back()->acquireHandler());
+    }
+    EXPECT_EQ(handlersPoolSize + 2, PoolHandler::created);
+
+    environment.requestUri = "/unknown";
+    PoolRouter router(request);
+    EXPECT_FALSE(router.acquireHandler());
+}
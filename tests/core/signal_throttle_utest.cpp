@@ -0,0 +1,42 @@
+#include <gtest/gtest.h>
+
+#include <core/broker/signal_throttle.hpp>
+
+using namespace app::broker;
+
+TEST(signalThrottle, testNoTokenSpentOnReject)
+{
+    // The buckets are refilled slowly enough to not affect the test
+    TokenBucket first(0.001, 1);
+    TokenBucket second(0.001, 2);
+
+    EXPECT_EQ(std::make_pair(true, true),
+              TokenBucket::tryConsumeBoth(first, second));
+    // The second token of the second bucket is kept
+    EXPECT_EQ(std::make_pair(false, true),
+              TokenBucket::tryConsumeBoth(first, second));
+    EXPECT_TRUE(second.tryConsume());
+    EXPECT_FALSE(second.tryConsume());
+}
+
+TEST(signalThrottle, testObjectDropsDontThrottleService)
+{
+    // The service bucket holds two tokens, it isn't refilled by the test
+    ServiceSignalLimiter limiter("xyz.openbmc_project.Test", 2);
+    TokenBucket objectBucket(0.001, 1);
+    TokenBucket otherObjectBucket(0.001, 1);
+
+    EXPECT_TRUE(limiter.tryAccept(objectBucket));
+    EXPECT_FALSE(limiter.tryAccept(objectBucket));
+    EXPECT_FALSE(limiter.isThrottled());
+    EXPECT_TRUE(limiter.tryAccept(otherObjectBucket));
+
+    // The service bucket is empty, the object token isn't spent
+    TokenBucket idleObjectBucket(0.001, 1);
+    EXPECT_FALSE(limiter.tryAccept(idleObjectBucket));
+    EXPECT_TRUE(limiter.isThrottled());
+    EXPECT_TRUE(idleObjectBucket.tryConsume());
+
+    EXPECT_EQ(2U, limiter.getAccepted());
+    EXPECT_EQ(2U, limiter.getDropped());
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <core/entity/entity.hpp>
+#include <core/entity/snapshot.hpp>
+
+using namespace app::entity;
+
+using FieldType = IEntity::IEntityMember::IInstance::FieldType;
+
+static const std::string snapshotPath =
+    testing::TempDir() + "entity_snapshot/entities.snapshot";
+
+static void buildSensors(EntityManager& entityManager,
+                         const std::vector<std::string>& members)
+{
+    entityManager.buildEntity("Sensors")->addMembers(members);
+}
+
+static const IEntity::InstancePtr
+    makeInstance(std::size_t hash,
+                 const std::vector<std::pair<std::string, FieldType>>& fields)
+{
+    auto instance = std::make_shared<SnapshotInstance>(hash);
+    for (const auto& [memberName, value] : fields)
+    {
+        instance->supplement(memberName, value);
+    }
+    return instance;
+}
+
+static void saveSensors()
+{
+    EntityManager entityManager;
+    buildSensors(entityManager, {"Name", "Value", "Enabled"});
+    entityManager.getEntity("Sensors")->setInstances({
+        makeInstance(1, {{"Name", std::string("cpu0")},
+                         {"Value", 42.5},
+                         {"Enabled", true}}),
+        makeInstance(2, {{"Name", std::string("fan0")},
+                         {"Value", int64_t(-3)},
+                         {"Enabled", false}}),
+    });
+    EntitySnapshot(entityManager, snapshotPath, std::chrono::seconds(60))
+        .save();
+}
+
+TEST(entitySnapshot, testRoundTrip)
+{
+    saveSensors();
+    EXPECT_FALSE(std::filesystem::exists(snapshotPath + ".tmp"));
+
+    EntityManager entityManager;
+    buildSensors(entityManager, {"Name", "Value", "Enabled"});
+    EntitySnapshot snapshot(entityManager, snapshotPath,
+                            std::chrono::seconds(60));
+    ASSERT_TRUE(snapshot.load());
+    EXPECT_TRUE(snapshot.isLoaded());
+
+    auto sensors = entityManager.getEntity("Sensors");
+    ASSERT_EQ(2U, sensors->getInstancesCount());
+
+    auto cpu = sensors->getInstance(1);
+    ASSERT_TRUE(cpu);
+    EXPECT_EQ(FieldType(std::string("cpu0")),
+              cpu->getField("Name")->getValue());
+    EXPECT_EQ(FieldType(42.5), cpu->getField("Value")->getValue());
+    EXPECT_EQ(FieldType(true), cpu->getField("Enabled")->getValue());
+
+    auto fan = sensors->getInstance(2);
+    ASSERT_TRUE(fan);
+    EXPECT_EQ(FieldType(std::string("fan0")),
+              fan->getField("Name")->getValue());
+    EXPECT_EQ(FieldType(int64_t(-3)), fan->getField("Value")->getValue());
+    EXPECT_EQ(FieldType(false), fan->getField("Enabled")->getValue());
+}
+
+TEST(entitySnapshot, testSchemaMismatch)
+{
+    saveSensors();
+
+    EntityManager entityManager;
+    buildSensors(entityManager, {"Name", "Value", "Unit"});
+    EntitySnapshot snapshot(entityManager, snapshotPath,
+                            std::chrono::seconds(60));
+    EXPECT_FALSE(snapshot.load());
+    EXPECT_FALSE(snapshot.isLoaded());
+    EXPECT_EQ(0U, entityManager.getEntity("Sensors")->getInstancesCount());
+}
+
+TEST(entitySnapshot, testVersionMismatch)
+{
+    saveSensors();
+
+    std::string content;
+    {
+        std::ifstream snapshotFile(snapshotPath, std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(snapshotFile),
+                       std::istreambuf_iterator<char>());
+    }
+    const uint32_t nextVersion = EntitySnapshot::formatVersion + 1;
+    ASSERT_GT(content.size(),
+              EntitySnapshot::magic.size() + sizeof(nextVersion));
+    std::memcpy(content.data() + EntitySnapshot::magic.size(), &nextVersion,
+                sizeof(nextVersion));
+    std::ofstream(snapshotPath, std::ios::binary | std::ios::trunc)
+        << content;
+
+    EntityManager entityManager;
+    buildSensors(entityManager, {"Name", "Value", "Enabled"});
+    EntitySnapshot snapshot(entityManager, snapshotPath,
+                            std::chrono::seconds(60));
+    EXPECT_FALSE(snapshot.load());
+    EXPECT_EQ(0U, entityManager.getEntity("Sensors")->getInstancesCount());
+}
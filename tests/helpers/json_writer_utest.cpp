@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <variant>
+
+#include <core/helpers/json_writer.hpp>
+
+using namespace app::helpers::writer;
+
+static const nlohmann::json writeSample(JsonWriter& writer)
+{
+    using FieldType = std::variant<std::string, int64_t, uint8_t, double, bool>;
+
+    writer.beginObject();
+    writer.key("Sensors");
+    writer.beginArray();
+    writer.beginObject();
+    writer.key("Name");
+    writer.value(FieldType(std::string("P12V \"AUX\"\n\x01")));
+    writer.key("Reading");
+    writer.value(FieldType(11.5391));
+    writer.key("HighCritical");
+    writer.value(FieldType(83.0));
+    writer.key("Count");
+    writer.value(FieldType(static_cast<uint8_t>(7)));
+    writer.key("Offset");
+    writer.value(FieldType(static_cast<int64_t>(-42)));
+    writer.key("Enabled");
+    writer.value(FieldType(true));
+    writer.endObject();
+    writer.endArray();
+    writer.key("Empty");
+    writer.beginObject();
+    writer.endObject();
+    writer.key("EmptyList");
+    writer.beginArray();
+    writer.endArray();
+    writer.endObject();
+
+    nlohmann::json expected = nlohmann::json::object();
+    expected["Sensors"] = nlohmann::json::array({{
+        {"Name", "P12V \"AUX\"\n\x01"},
+        {"Reading", 11.5391},
+        {"HighCritical", 83.0},
+        {"Count", static_cast<uint8_t>(7)},
+        {"Offset", -42},
+        {"Enabled", true},
+    }});
+    expected["Empty"] = nlohmann::json::object();
+    expected["EmptyList"] = nlohmann::json::array();
+    return expected;
+}
+
+TEST(jsonWriter, testCompactOutput)
+{
+    std::ostringstream output;
+    JsonWriter writer(output);
+    auto expected = writeSample(writer);
+
+    EXPECT_EQ(nlohmann::json::parse(output.str()), expected);
+    EXPECT_EQ(output.str().find("\n"), std::string::npos);
+}
+
+TEST(jsonWriter, testIndentedOutput)
+{
+    std::ostringstream output;
+    JsonWriter writer(output, 2);
+    writer.beginObject();
+    writer.key("a");
+    writer.beginArray();
+    writer.value(1);
+    writer.value(2.5);
+    writer.endArray();
+    writer.key("b");
+    writer.beginObject();
+    writer.endObject();
+    writer.endObject();
+
+    nlohmann::json expected = {{"a", {1, 2.5}}, {"b", nlohmann::json::object()}};
+    EXPECT_EQ(output.str(), expected.dump(2));
+}
+
+TEST(jsonWriter, testNumbersFormatting)
+{
+    std::ostringstream output;
+    JsonWriter writer(output);
+    writer.beginArray();
+    writer.value(83.0);
+    writer.value(0.1);
+    writer.value(-1e-05);
+    writer.value(std::numeric_limits<double>::quiet_NaN());
+    writer.value(std::numeric_limits<uint64_t>::max());
+    writer.endArray();
+
+    EXPECT_EQ(output.str(), "[83.0,0.1,-1e-05,null,18446744073709551615]");
+}
+
+TEST(jsonWriter, testRawValueAtDepth)
+{
+    nlohmann::json nested = {{"x", {1, 2}}};
+
+    std::ostringstream output;
+    JsonWriter writer(output, 2);
+    writer.beginObject();
+    for (const auto* key : {"a", "b"})
+    {
+        std::ostringstream rendering;
+        JsonWriter renderingWriter(rendering, writer.getIndent(),
+                                   writer.getDepth());
+        renderingWriter.beginObject();
+        renderingWriter.key("x");
+        renderingWriter.beginArray();
+        renderingWriter.value(1);
+        renderingWriter.value(2);
+        renderingWriter.endArray();
+        renderingWriter.endObject();
+
+        writer.key(key);
+        writer.rawValue(rendering.str());
+    }
+    writer.endObject();
+
+    nlohmann::json expected = {{"a", nested}, {"b", nested}};
+    EXPECT_EQ(output.str(), expected.dump(2));
+}
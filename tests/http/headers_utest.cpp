@@ -36,3 +36,51 @@ TEST(header, testHeaderContentDate)
     EXPECT_TRUE(header(headers::date, "Wed, 14 Apr 2021 11:28:34 GMT")
                     .starts_with(testHeadesSamples["contentTypeDateTest"]));
 }
+
+TEST(header, testNegotiateContentEncoding)
+{
+    EXPECT_STREQ(content_encodings::gzip,
+                 content_encodings::negotiate("gzip, deflate, br"));
+    EXPECT_STREQ(content_encodings::deflate,
+                 content_encodings::negotiate("gzip;q=0, deflate;q=0.5"));
+    EXPECT_STREQ(content_encodings::deflate,
+                 content_encodings::negotiate("*, gzip; q=0.000"));
+    EXPECT_STREQ(content_encodings::gzip,
+                 content_encodings::negotiate(" * ;q=0.1"));
+    EXPECT_STREQ(content_encodings::identity,
+                 content_encodings::negotiate("br, *;q=0"));
+    EXPECT_STREQ(content_encodings::identity, content_encodings::negotiate(""));
+}
+
+TEST(header, testFormatEntityTag)
+{
+    EXPECT_EQ("\"12345\"", entity_tags::format("12345"));
+    EXPECT_EQ("\"12345\"",
+              entity_tags::format("12345", content_encodings::identity));
+    EXPECT_EQ("\"12345-gzip\"",
+              entity_tags::format("12345", content_encodings::gzip));
+    EXPECT_EQ("\"12345-deflate\"",
+              entity_tags::format("12345", content_encodings::deflate));
+}
+
+TEST(header, testMatchEntityTag)
+{
+    const auto entityTag = entity_tags::format("12345");
+    EXPECT_TRUE(entity_tags::match("\"12345\"", entityTag));
+    EXPECT_TRUE(entity_tags::match("W/\"12345\"", entityTag));
+    EXPECT_TRUE(entity_tags::match("\"1\", \"12345\"", entityTag));
+    EXPECT_TRUE(entity_tags::match("\"1\",W/\"12345\" ,\"2\"", entityTag));
+    EXPECT_TRUE(entity_tags::match("*", entityTag));
+    EXPECT_TRUE(entity_tags::match("12345, \"12345\"", entityTag));
+    EXPECT_TRUE(entity_tags::match("\"12345\"", "W/\"12345\""));
+
+    EXPECT_FALSE(entity_tags::match("", entityTag));
+    EXPECT_FALSE(entity_tags::match("12345", entityTag));
+    EXPECT_FALSE(entity_tags::match("\"1234\"", entityTag));
+    EXPECT_FALSE(entity_tags::match("\"123456\"", entityTag));
+    EXPECT_FALSE(entity_tags::match("\"1\", \"2\"", entityTag));
+    EXPECT_FALSE(entity_tags::match("\"12345", entityTag));
+    EXPECT_FALSE(entity_tags::match("\"a,12345\"", entityTag));
+    EXPECT_FALSE(entity_tags::match(
+        entity_tags::format("12345", content_encodings::gzip), entityTag));
+}